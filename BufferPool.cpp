@@ -0,0 +1,120 @@
+#include "BufferPool.h"
+
+#include <malloc.h>
+
+#define BUFFER_ALIGNMENT 32
+#define MIN_SIZE_CLASS (64 * 1024)
+
+static size_t class_index(size_t capacity)
+{
+	size_t index = 0;
+	while ((static_cast<size_t>(1) << index) < capacity)
+		++index;
+	return index;
+}
+
+BufferPool::BufferPool(size_t maxIdleBytes /*= 64 * 1024 * 1024*/) :
+	mMaxIdleBytes(maxIdleBytes), mIdleBytes(0), mUsedBytes(0), mHits(0), mMisses(0), mEvictions(0)
+{
+	mFree.resize(sizeof(size_t) * 8);
+}
+
+BufferPool::~BufferPool()
+{
+	Clear();
+}
+
+void BufferPool::SetMaxIdleBytes(size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	mMaxIdleBytes = bytes;
+	_Evict();
+}
+
+uint8_t *BufferPool::Acquire(size_t size, size_t &capacity)
+{
+	capacity = GetSizeClass(size);
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		std::vector<uint8_t*> &idle = mFree[class_index(capacity)];
+		mUsedBytes += capacity;
+		if (!idle.empty())
+		{
+			uint8_t *data = idle.back();
+			idle.pop_back();
+			mIdleBytes -= capacity;
+			mHits++;
+			return data;
+		}
+		mMisses++;
+	}
+
+	uint8_t *data = static_cast<uint8_t*>(_aligned_malloc(capacity, BUFFER_ALIGNMENT));
+	if (!data)
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mUsedBytes -= capacity;
+		capacity = 0;
+	}
+	return data;
+}
+
+void BufferPool::Release(uint8_t *data, size_t capacity)
+{
+	if (!data)
+		return;
+
+	std::lock_guard<std::mutex> guard(mLock);
+	mUsedBytes -= capacity;
+	mFree[class_index(capacity)].push_back(data);
+	mIdleBytes += capacity;
+	_Evict();
+}
+
+BufferPool::Stats BufferPool::GetStats()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	Stats stats;
+	stats.hits = mHits;
+	stats.misses = mMisses;
+	stats.evictions = mEvictions;
+	stats.idle_bytes = mIdleBytes;
+	stats.used_bytes = mUsedBytes;
+	return stats;
+}
+
+void BufferPool::Clear()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	for (std::vector<uint8_t*> &idle : mFree)
+	{
+		for (uint8_t *data : idle)
+			_aligned_free(data);
+		idle.clear();
+	}
+	mIdleBytes = 0;
+}
+
+size_t BufferPool::GetSizeClass(size_t size)
+{
+	size_t capacity = MIN_SIZE_CLASS;
+	while (capacity < size)
+		capacity <<= 1;
+	return capacity;
+}
+
+void BufferPool::_Evict()
+{
+	// 큰 등급부터 버린다. 큰 버퍼일수록 다시 쓰일 일이 적고 한 번에 많이 줄어든다
+	for (size_t index = mFree.size(); index-- > 0 && mIdleBytes > mMaxIdleBytes;)
+	{
+		std::vector<uint8_t*> &idle = mFree[index];
+		while (!idle.empty() && mIdleBytes > mMaxIdleBytes)
+		{
+			_aligned_free(idle.back());
+			idle.pop_back();
+			mIdleBytes -= static_cast<size_t>(1) << index;
+			mEvictions++;
+		}
+	}
+}
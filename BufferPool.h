@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 크기 등급(2의 거듭제곱)별로 프레임 버퍼를 모아두고 다시 쓰는 풀.
+// 해상도가 바뀌는 스트림이나 해상도가 다른 클립을 오가도 프레임마다 할당하지 않는다.
+// 버퍼는 SIMD 변환 함수가 쓰기 좋게 32바이트로 정렬된다.
+class BufferPool
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t idle_bytes;
+		size_t used_bytes;
+	};
+
+public:
+	// 쉬고 있는 버퍼를 maxIdleBytes까지 남겨둔다
+	explicit BufferPool(size_t maxIdleBytes = 64 * 1024 * 1024);
+	~BufferPool();
+
+	static BufferPool *GetInstance()
+	{
+		static BufferPool instance;
+		return &instance;
+	}
+
+public:
+	void SetMaxIdleBytes(size_t bytes);
+	// size 이상을 담을 수 있는 버퍼를 꺼낸다. capacity에는 실제 크기(등급)가 들어간다
+	uint8_t *Acquire(size_t size, size_t &capacity);
+	// Acquire에서 받은 capacity를 그대로 넘긴다
+	void Release(uint8_t *data, size_t capacity);
+	Stats GetStats();
+	void Clear();
+
+	static size_t GetSizeClass(size_t size);
+
+private:
+	void _Evict();
+
+private:
+	std::mutex mLock;
+	std::vector<std::vector<uint8_t*>> mFree;	// 등급별 빈 버퍼. 인덱스는 log2(크기)
+	size_t mMaxIdleBytes;
+	size_t mIdleBytes;
+	size_t mUsedBytes;
+	uint64_t mHits;
+	uint64_t mMisses;
+	uint64_t mEvictions;
+};
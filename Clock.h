@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 디코더 재생 시간의 기준. 단위는 나노초이고 시작점은 구현마다 달라도 되지만 줄어들면 안 된다.
+// 엔진 시계나 vsync 시각에 맞추려면 상속해서 SetClock으로 넘긴다.
+class Clock
+{
+public:
+	virtual ~Clock() {}
+	virtual uint64_t Now() = 0;
+};
+
+// 기본 시계. 시스템 시간 조정에 영향받지 않는다
+class SteadyClock : public Clock
+{
+public:
+	virtual uint64_t Now() override
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static SteadyClock *GetInstance()
+	{
+		static SteadyClock instance;
+		return &instance;
+	}
+};
+
+// 호출한 쪽이 직접 시간을 넘기는 시계. 벤치마크처럼 실제 시간과 상관없이 재생을 돌릴 때 쓴다
+class ManualClock : public Clock
+{
+public:
+	explicit ManualClock(uint64_t now = 0) : mNow(now) {}
+
+	virtual uint64_t Now() override
+	{
+		return mNow;
+	}
+
+	void Set(uint64_t now)
+	{
+		mNow = now;
+	}
+
+	void Advance(uint64_t ns)
+	{
+		mNow += ns;
+	}
+
+private:
+	std::atomic<uint64_t> mNow;
+};
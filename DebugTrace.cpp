@@ -0,0 +1,21 @@
+#include "DebugTrace.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <windows.h>
+
+void OutputDebugTrace(char* lpszFormat, ...)
+{
+	va_list args;
+	va_start(args, lpszFormat);
+
+	int buf;
+	char szBuffer[512];
+
+	buf = _vsnprintf_s(szBuffer, sizeof(szBuffer) / sizeof(szBuffer[0]), lpszFormat, args);
+
+	assert(buf >= 0);
+	OutputDebugStringA(szBuffer);
+	va_end(args);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// printf 형식으로 디버거 출력 창에 남긴다. 512바이트를 넘으면 잘린다
+void OutputDebugTrace(char* lpszFormat, ...);
@@ -0,0 +1,171 @@
+#include "DecoderPool.h"
+
+#define INITIAL_BUFFER_SIZE (1024 * 256)
+
+DecoderPool::DecoderPool(uint32_t maxIdle /*= 4*/) :
+	mMaxIdle(maxIdle), mHits(0), mMisses(0), mEvictions(0)
+{
+}
+
+DecoderPool::~DecoderPool()
+{
+	Clear();
+}
+
+void DecoderPool::SetMaxIdle(uint32_t maxIdle)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	mMaxIdle = maxIdle;
+	_Evict();
+}
+
+std::shared_ptr<DecoderPool::Context> DecoderPool::Acquire(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha)
+{
+	Context *context = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		auto found = mIdle.end();
+		for (auto it = mIdle.begin(); it != mIdle.end(); ++it)
+		{
+			if ((*it)->iface != iface || (*it)->width != width || (*it)->height != height)
+				continue;
+
+			// 알파가 필요 없으면 알파 디코더가 없는 것을 먼저 주고, 필요하면 있는 것을 먼저 준다
+			const bool hasAlpha = (*it)->decoder_alpha.iface != nullptr;
+			if (found == mIdle.end() || hasAlpha == alpha)
+				found = it;
+			if (hasAlpha == alpha)
+				break;
+		}
+		if (found != mIdle.end())
+		{
+			context = *found;
+			mIdle.erase(found);
+			mHits++;
+		}
+		else
+		{
+			mMisses++;
+		}
+	}
+
+	// 디코더 초기화는 락 밖에서 한다
+	if (!context)
+		context = _Create(iface, width, height, alpha);
+	else if (alpha && !InitAlpha(context))
+	{
+		_Release(context);
+		return nullptr;
+	}
+	if (!context)
+		return nullptr;
+
+	return std::shared_ptr<Context>(context, [this](Context *released) { _Release(released); });
+}
+
+bool DecoderPool::Prepare(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha, uint32_t count)
+{
+	std::vector<Context*> contexts;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Context *context = _Create(iface, width, height, alpha);
+		if (!context)
+			break;
+		contexts.push_back(context);
+	}
+
+	for (Context *context : contexts)
+		_Release(context);
+	return contexts.size() == count;
+}
+
+DecoderPool::Stats DecoderPool::GetStats()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	Stats stats;
+	stats.hits = mHits;
+	stats.misses = mMisses;
+	stats.evictions = mEvictions;
+	stats.idle_count = mIdle.size();
+	return stats;
+}
+
+void DecoderPool::Clear()
+{
+	std::list<Context*> idle;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		idle.swap(mIdle);
+	}
+	for (Context *context : idle)
+		_Destroy(context);
+}
+
+bool DecoderPool::InitAlpha(Context *context)
+{
+	if (context->decoder_alpha.iface)
+		return true;
+
+	if (vpx_codec_dec_init(&context->decoder_alpha, context->iface, nullptr, 0))
+	{
+		context->decoder_alpha.iface = nullptr;
+		return false;
+	}
+	context->buffer_alpha.resize(INITIAL_BUFFER_SIZE);
+	return true;
+}
+
+DecoderPool::Context *DecoderPool::_Create(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha)
+{
+	Context *context = new Context();
+	context->iface = iface;
+	context->width = width;
+	context->height = height;
+	context->decoder.iface = nullptr;
+	context->decoder_alpha.iface = nullptr;
+
+	if (vpx_codec_dec_init(&context->decoder, iface, nullptr, 0) || (alpha && !InitAlpha(context)))
+	{
+		_Destroy(context);
+		return nullptr;
+	}
+
+	context->buffer.resize(INITIAL_BUFFER_SIZE);
+	return context;
+}
+
+void DecoderPool::_Destroy(Context *context)
+{
+	if (context->decoder.iface)
+		vpx_codec_destroy(&context->decoder);
+	if (context->decoder_alpha.iface)
+		vpx_codec_destroy(&context->decoder_alpha);
+	delete context;
+}
+
+void DecoderPool::_Release(Context *context)
+{
+	std::vector<Context*> evicted;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mIdle.push_front(context);
+		while (mIdle.size() > mMaxIdle)
+		{
+			evicted.push_back(mIdle.back());
+			mIdle.pop_back();
+			mEvictions++;
+		}
+	}
+	for (Context *old : evicted)
+		_Destroy(old);
+}
+
+void DecoderPool::_Evict()
+{
+	while (mIdle.size() > mMaxIdle)
+	{
+		_Destroy(mIdle.back());
+		mIdle.pop_back();
+		mEvictions++;
+	}
+}
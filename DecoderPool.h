@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vpx_decoder.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 초기화된 libvpx 컨텍스트(색상, 알파)와 비트스트림 버퍼를 (코덱, 해상도)별로 모아두고 다시 쓰는 풀.
+// 클립을 바꿀 때마다 디코더를 새로 만들고 내부 프레임 버퍼를 다시 할당하는 비용을 없앤다. RGBA 출력 버퍼는 BufferPool이 맡는다.
+// 새 클립은 키 프레임부터 시작하므로 이전 클립의 참조 프레임은 남아 있어도 쓰이지 않는다.
+// 알파 디코더는 알파가 있는 클립이 처음 쓸 때 만든다.
+class DecoderPool
+{
+public:
+	struct Context
+	{
+		vpx_codec_iface_t *iface;
+		uint32_t width;
+		uint32_t height;
+		vpx_codec_ctx_t decoder;
+		vpx_codec_ctx_t decoder_alpha;	// 아직 만들지 않았으면 iface가 nullptr
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> buffer_alpha;
+	};
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t idle_count;
+	};
+
+public:
+	// 쉬고 있는 컨텍스트를 maxIdle개까지 남겨둔다
+	explicit DecoderPool(uint32_t maxIdle = 4);
+	~DecoderPool();
+
+public:
+	void SetMaxIdle(uint32_t maxIdle);
+	// 같은 코덱과 해상도의 컨텍스트가 있으면 꺼내고 없으면 새로 만든다. 핸들이 사라지면 풀로 돌아온다.
+	// alpha면 알파 디코더가 있는 컨텍스트를 먼저 찾고, 없으면 만들어서 준다. 풀은 핸들보다 오래 살아 있어야 한다.
+	std::shared_ptr<Context> Acquire(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha);
+	// 다음 클립을 알고 있으면 미리 만들어둔다
+	bool Prepare(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha, uint32_t count);
+	// 알파 디코더가 없는 컨텍스트로 알파 블록을 만났을 때 부른다
+	static bool InitAlpha(Context *context);
+	Stats GetStats();
+	void Clear();
+
+private:
+	Context *_Create(vpx_codec_iface_t *iface, uint32_t width, uint32_t height, bool alpha);
+	void _Destroy(Context *context);
+	void _Release(Context *context);
+	void _Evict();
+
+private:
+	std::mutex mLock;
+	std::list<Context*> mIdle;	// 앞쪽이 최근에 돌아온 것
+	uint32_t mMaxIdle;
+	uint64_t mHits;
+	uint64_t mMisses;
+	uint64_t mEvictions;
+};
@@ -0,0 +1,120 @@
+#include "DecoderScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+DecoderScheduler::DecoderScheduler(uint32_t threadCount /*= 0*/) : mPool(threadCount), mFrameBudgetUs(0)
+{
+}
+
+DecoderScheduler::~DecoderScheduler()
+{
+	mPool.Wait();
+}
+
+void DecoderScheduler::Add(WebmDecoder *decoder, int priority /*= 0*/)
+{
+	if (!decoder || _FindEntry(decoder))
+		return;
+
+	Entry entry;
+	entry.decoder = decoder;
+	entry.priority = priority;
+	entry.deferred_count = 0;
+	entry.cost_us = 0;
+	entry.last_cost_us = 0;
+	entry.state = WebmDecoder::WEBM_STATE::NONE;
+	mEntries.push_back(entry);
+}
+
+void DecoderScheduler::Remove(WebmDecoder *decoder)
+{
+	mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(),
+		[decoder](const Entry &entry) { return entry.decoder == decoder; }), mEntries.end());
+}
+
+void DecoderScheduler::SetPriority(WebmDecoder *decoder, int priority)
+{
+	Entry *entry = _FindEntry(decoder);
+	if (entry)
+		entry->priority = priority;
+}
+
+void DecoderScheduler::SetFrameBudget(uint64_t budgetUs)
+{
+	mFrameBudgetUs = budgetUs;
+}
+
+void DecoderScheduler::SetFrameCallback(FrameCallback callback)
+{
+	mFrameCallback = std::move(callback);
+}
+
+uint32_t DecoderScheduler::Update()
+{
+	mScheduled.clear();
+	for (Entry &entry : mEntries)
+	{
+		if (entry.decoder->IsFrameDue())
+			mScheduled.push_back(&entry);
+	}
+
+	if (mScheduled.empty())
+		return 0;
+
+	// 예산 초과로 밀린 횟수만큼 우선순위를 올려서 낮은 우선순위도 굶지 않게 한다
+	std::stable_sort(mScheduled.begin(), mScheduled.end(), [](const Entry *lhs, const Entry *rhs) {
+		return (lhs->priority + static_cast<int>(lhs->deferred_count)) >
+			(rhs->priority + static_cast<int>(rhs->deferred_count));
+	});
+
+	if (mFrameBudgetUs > 0)
+	{
+		uint64_t estimatedUs = 0;
+		size_t count = 0;
+		for (; count < mScheduled.size(); ++count)
+		{
+			const uint64_t cost = mScheduled[count]->cost_us;
+			if (count > 0 && estimatedUs + cost > mFrameBudgetUs)
+				break;
+			estimatedUs += cost;
+		}
+
+		for (size_t i = count; i < mScheduled.size(); ++i)
+			mScheduled[i]->deferred_count++;
+		mScheduled.resize(count);
+	}
+
+	std::vector<ThreadPool::Task> tasks;
+	tasks.reserve(mScheduled.size());
+	for (Entry *entry : mScheduled)
+	{
+		tasks.push_back([entry]() {
+			const auto begin = std::chrono::steady_clock::now();
+			entry->state = entry->decoder->DecodeFrame();
+			const auto end = std::chrono::steady_clock::now();
+			entry->last_cost_us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+		});
+	}
+	mPool.Submit(tasks);
+	mPool.Wait();
+
+	for (Entry *entry : mScheduled)
+	{
+		entry->deferred_count = 0;
+		entry->cost_us = (entry->cost_us == 0) ? entry->last_cost_us : (entry->cost_us * 7 + entry->last_cost_us) / 8;
+		if (mFrameCallback)
+			mFrameCallback(entry->decoder, entry->state);
+	}
+	return static_cast<uint32_t>(mScheduled.size());
+}
+
+DecoderScheduler::Entry *DecoderScheduler::_FindEntry(WebmDecoder *decoder)
+{
+	for (Entry &entry : mEntries)
+	{
+		if (entry.decoder == decoder)
+			return &entry;
+	}
+	return nullptr;
+}
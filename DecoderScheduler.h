@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "WebmDecoder.h"
+
+#include <functional>
+#include <vector>
+
+// 여러 WebmDecoder의 디코딩/변환을 스레드 풀에 나눠서 처리한다.
+// Add/Remove/Update는 한 스레드(보통 메인 스레드)에서만 호출해야 한다.
+class DecoderScheduler
+{
+public:
+	using FrameCallback = std::function<void(WebmDecoder*, WebmDecoder::WEBM_STATE)>;
+
+	explicit DecoderScheduler(uint32_t threadCount = 0);
+	~DecoderScheduler();
+
+public:
+	void Add(WebmDecoder *decoder, int priority = 0);
+	void Remove(WebmDecoder *decoder);
+	void SetPriority(WebmDecoder *decoder, int priority);
+	// 한 번의 Update에서 사용할 전체 CPU 시간(us), 0이면 제한 없음
+	void SetFrameBudget(uint64_t budgetUs);
+	void SetFrameCallback(FrameCallback callback);
+	// 프레임 시간이 된 디코더들을 병렬로 디코딩하고 완료된 프레임을 게시한다. 디코딩한 디코더 수를 반환
+	uint32_t Update();
+
+private:
+	struct Entry
+	{
+		WebmDecoder *decoder;
+		int priority;
+		uint32_t deferred_count;
+		uint64_t cost_us;
+		uint64_t last_cost_us;
+		WebmDecoder::WEBM_STATE state;
+	};
+
+	Entry *_FindEntry(WebmDecoder *decoder);
+
+private:
+	ThreadPool mPool;
+	std::vector<Entry> mEntries;
+	std::vector<Entry*> mScheduled;
+	FrameCallback mFrameCallback;
+	uint64_t mFrameBudgetUs;
+};
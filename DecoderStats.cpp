@@ -0,0 +1,137 @@
+#include "DecoderStats.h"
+
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Record(uint64_t value_ns)
+{
+	mCounts[_GetIndex(value_ns)]++;
+	mCount++;
+	if (value_ns > mMax)
+		mMax = value_ns;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const
+{
+	if (mCount == 0)
+		return 0;
+
+	uint64_t target = static_cast<uint64_t>(mCount * percentile / 100.0 + 0.5);
+	if (target == 0)
+		target = 1;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += mCounts[i];
+		if (seen >= target)
+			return (_GetValue(i) < mMax) ? _GetValue(i) : mMax;
+	}
+	return mMax;
+}
+
+void LatencyHistogram::Reset()
+{
+	memset(mCounts, 0, sizeof(mCounts));
+	mCount = 0;
+	mMax = 0;
+}
+
+uint32_t LatencyHistogram::_GetIndex(uint64_t value)
+{
+	// 16보다 작은 값은 그대로 칸 번호가 되고, 그 위로는 최상위 비트 위치마다 16칸씩 쓴다
+	if (value < SUB_BUCKET_COUNT)
+		return static_cast<uint32_t>(value);
+
+	uint32_t msb = 0;
+	for (uint64_t v = value; v >>= 1;)
+		++msb;
+	const uint32_t shift = msb - SUB_BUCKET_BITS;
+	const uint32_t sub = static_cast<uint32_t>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+	return (shift + 1) * SUB_BUCKET_COUNT + sub;
+}
+
+uint64_t LatencyHistogram::_GetValue(uint32_t index)
+{
+	// 칸에 들어가는 가장 큰 값
+	if (index < SUB_BUCKET_COUNT)
+		return index;
+
+	const uint32_t shift = index / SUB_BUCKET_COUNT - 1;
+	const uint64_t sub = index % SUB_BUCKET_COUNT;
+	return ((SUB_BUCKET_COUNT + sub + 1) << shift) - 1;
+}
+
+DecoderStats::DecoderStats() : mFramesDecoded(0), mBytesRead(0), mCoverageFrames(0), mFramePixels(0), mBBoxPixels(0),
+	mOpaqueTiles(0), mTransparentTiles(0), mMixedTiles(0), mOpaqueFrames(0), mTransparentFrames(0),
+	mTrackedFrames(0), mTrackedPixels(0), mDirtyPixels(0)
+{
+}
+
+void DecoderStats::AddAlphaCoverage(uint64_t framePixels, uint64_t bboxPixels, uint32_t opaqueTiles, uint32_t transparentTiles, uint32_t mixedTiles)
+{
+	mCoverageFrames++;
+	mFramePixels += framePixels;
+	mBBoxPixels += bboxPixels;
+	mOpaqueTiles += opaqueTiles;
+	mTransparentTiles += transparentTiles;
+	mMixedTiles += mixedTiles;
+}
+
+void DecoderStats::AddDirtyRegion(uint64_t framePixels, uint64_t dirtyPixels)
+{
+	mTrackedFrames++;
+	mTrackedPixels += framePixels;
+	mDirtyPixels += dirtyPixels;
+}
+
+DecoderStats::Snapshot DecoderStats::GetSnapshot(uint64_t droppedFrames, uint64_t lateFrames) const
+{
+	Snapshot snapshot;
+	for (int i = 0; i < STAGE_COUNT; ++i)
+	{
+		snapshot.stages[i].count = mStages[i].GetCount();
+		snapshot.stages[i].p50_ns = mStages[i].GetPercentile(50.0);
+		snapshot.stages[i].p99_ns = mStages[i].GetPercentile(99.0);
+		snapshot.stages[i].max_ns = mStages[i].GetMax();
+	}
+	snapshot.frames_decoded = mFramesDecoded;
+	snapshot.dropped_frames = droppedFrames;
+	snapshot.late_frames = lateFrames;
+	snapshot.bytes_read = mBytesRead;
+	snapshot.coverage_frames = mCoverageFrames;
+	snapshot.frame_pixels = mFramePixels;
+	snapshot.bbox_pixels = mBBoxPixels;
+	snapshot.opaque_tiles = mOpaqueTiles;
+	snapshot.transparent_tiles = mTransparentTiles;
+	snapshot.mixed_tiles = mMixedTiles;
+	snapshot.opaque_frames = mOpaqueFrames;
+	snapshot.transparent_frames = mTransparentFrames;
+	snapshot.tracked_frames = mTrackedFrames;
+	snapshot.tracked_pixels = mTrackedPixels;
+	snapshot.dirty_pixels = mDirtyPixels;
+	return snapshot;
+}
+
+void DecoderStats::Reset()
+{
+	for (LatencyHistogram &stage : mStages)
+		stage.Reset();
+	mFramesDecoded = 0;
+	mBytesRead = 0;
+	mCoverageFrames = 0;
+	mFramePixels = 0;
+	mBBoxPixels = 0;
+	mOpaqueTiles = 0;
+	mTransparentTiles = 0;
+	mMixedTiles = 0;
+	mOpaqueFrames = 0;
+	mTransparentFrames = 0;
+	mTrackedFrames = 0;
+	mTrackedPixels = 0;
+	mDirtyPixels = 0;
+}
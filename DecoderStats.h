@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// 0으로 정의하면 단계별 타이머 코드가 빠진다. 프레임, 바이트 카운터는 그대로 남는다
+#ifndef WEBM_ENABLE_STATS
+#define WEBM_ENABLE_STATS 1
+#endif
+
+// ns 단위 지연 히스토그램. 2의 거듭제곱 구간마다 16칸으로 나눠 상대 오차 6% 안에서 백분위를 구한다.
+// 기록은 배열 증가 하나라서 프레임마다 불러도 부담이 없다.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+public:
+	void Record(uint64_t value_ns);
+	// percentile은 0~100
+	uint64_t GetPercentile(double percentile) const;
+	uint64_t GetMax() const { return mMax; }
+	uint64_t GetCount() const { return mCount; }
+	void Reset();
+
+private:
+	enum
+	{
+		SUB_BUCKET_BITS = 4,
+		SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+		BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT,
+	};
+
+	static uint32_t _GetIndex(uint64_t value);
+	static uint64_t _GetValue(uint32_t index);
+
+private:
+	uint64_t mCounts[BUCKET_COUNT];
+	uint64_t mCount;
+	uint64_t mMax;
+};
+
+// WebmDecoder의 단계별 지연과 카운터
+class DecoderStats
+{
+public:
+	enum STAGE
+	{
+		STAGE_READ,			// _ReadFrame: 클러스터 파싱과 블록 읽기
+		STAGE_DECODE,		// 색상 vpx_codec_decode
+		STAGE_DECODE_ALPHA,	// 알파 vpx_codec_decode
+		STAGE_CONVERT,		// YUV -> RGBA
+		STAGE_COUNT,
+	};
+
+	struct StageStats
+	{
+		uint64_t count;
+		uint64_t p50_ns;
+		uint64_t p99_ns;
+		uint64_t max_ns;
+	};
+
+	struct Snapshot
+	{
+		StageStats stages[STAGE_COUNT];
+		uint64_t frames_decoded;
+		uint64_t dropped_frames;
+		uint64_t late_frames;
+		uint64_t bytes_read;
+		// 변환하면서 알파 분포를 구한 프레임들의 합. 업로드를 알파 사각형으로 자르면 bbox_pixels / frame_pixels만 올리고,
+		// 투명 타일은 그리지 않고 불투명 타일은 블렌딩 없이 그려서 섞인 타일만 블렌딩한다
+		uint64_t coverage_frames;
+		uint64_t frame_pixels;
+		uint64_t bbox_pixels;
+		uint64_t opaque_tiles;
+		uint64_t transparent_tiles;
+		uint64_t mixed_tiles;
+		// 알파 평면이 한 값이라 알파를 섞지 않은 프레임. 불투명은 알파 없는 커널로, 투명은 색상 변환 없이 0으로 채운다
+		uint64_t opaque_frames;
+		uint64_t transparent_frames;
+		// 바뀐 영역을 추적하면서 변환한 프레임들의 합. 변환과 업로드가 dirty_pixels / tracked_pixels로 줄어든다
+		uint64_t tracked_frames;
+		uint64_t tracked_pixels;
+		uint64_t dirty_pixels;
+	};
+
+	// 범위를 벗어날 때 걸린 시간을 stage에 기록한다
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(DecoderStats &stats, STAGE stage) :
+			mStats(stats), mStage(stage), mBegin(std::chrono::steady_clock::now())
+		{
+		}
+
+		~ScopedTimer()
+		{
+			const auto elapsed = std::chrono::steady_clock::now() - mBegin;
+			mStats.Record(mStage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		}
+
+	private:
+		DecoderStats &mStats;
+		STAGE mStage;
+		std::chrono::steady_clock::time_point mBegin;
+	};
+
+public:
+	DecoderStats();
+
+public:
+	void Record(STAGE stage, uint64_t elapsed_ns) { mStages[stage].Record(elapsed_ns); }
+	void AddDecodedFrame() { mFramesDecoded++; }
+	void AddBytesRead(uint64_t bytes) { mBytesRead += bytes; }
+	void AddAlphaCoverage(uint64_t framePixels, uint64_t bboxPixels, uint32_t opaqueTiles, uint32_t transparentTiles, uint32_t mixedTiles);
+	void AddConstantAlphaFrame(bool transparent) { if (transparent) mTransparentFrames++; else mOpaqueFrames++; }
+	void AddDirtyRegion(uint64_t framePixels, uint64_t dirtyPixels);
+	// 드롭, 지연 프레임은 디코더가 따로 세므로 스냅샷을 만들 때 받는다
+	Snapshot GetSnapshot(uint64_t droppedFrames, uint64_t lateFrames) const;
+	void Reset();
+
+private:
+	LatencyHistogram mStages[STAGE_COUNT];
+	uint64_t mFramesDecoded;
+	uint64_t mBytesRead;
+	uint64_t mCoverageFrames;
+	uint64_t mFramePixels;
+	uint64_t mBBoxPixels;
+	uint64_t mOpaqueTiles;
+	uint64_t mTransparentTiles;
+	uint64_t mMixedTiles;
+	uint64_t mOpaqueFrames;
+	uint64_t mTransparentFrames;
+	uint64_t mTrackedFrames;
+	uint64_t mTrackedPixels;
+	uint64_t mDirtyPixels;
+};
+
+#if WEBM_ENABLE_STATS
+#define WEBM_STAGE_TIMER(stats, stage) DecoderStats::ScopedTimer stage_timer_##stage(stats, DecoderStats::stage)
+#else
+#define WEBM_STAGE_TIMER(stats, stage)
+#endif
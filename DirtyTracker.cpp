@@ -0,0 +1,170 @@
+#include "DirtyTracker.h"
+#include "YUVtoRGB.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define DIRTY_BLOCK_SIZE 16
+// 변환 커널이 Y를 32바이트, U/V를 16바이트 정렬로 읽으므로 사각형은 32픽셀 경계에서 시작한다
+#define DIRTY_RECT_ALIGNMENT 32
+// 사각형마다 커널 호출과 glTexSubImage2D가 하나씩 늘어나므로 이보다 많으면 전체를 한 번에 처리한다
+#define DIRTY_MAX_RECTS 64
+
+static uint32_t align_up(uint32_t value)
+{
+	return (value + DIRTY_RECT_ALIGNMENT - 1) & ~(DIRTY_RECT_ALIGNMENT - 1);
+}
+
+static void copy_plane(std::vector<uint8_t> &plane, uint32_t stride, const uint8_t *src, uint32_t srcStride, uint32_t width, uint32_t height)
+{
+	plane.resize(static_cast<size_t>(stride) * height);
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(&plane[y * stride], src + y * srcStride, width);
+}
+
+DirtyTracker::DirtyTracker() : mDiffFunc(plane_diff_blocks_std), mWidth(0), mHeight(0), mBlocksWide(0), mBlocksHigh(0),
+	mHasAlpha(false), mValid(false), mDirtyBlocks(0)
+{
+	memset(mStrides, 0, sizeof(mStrides));
+}
+
+void DirtyTracker::SetDiffFunc(DiffFunc_t func)
+{
+	mDiffFunc = func;
+}
+
+bool DirtyTracker::Update(uint32_t width, uint32_t height, const uint8_t *Y, const uint8_t *U, const uint8_t *V, const uint8_t *A,
+	uint32_t strideY, uint32_t strideU, uint32_t strideV, uint32_t strideA)
+{
+	const uint32_t uvWidth = (width + 1) / 2;
+	const uint32_t uvHeight = (height + 1) / 2;
+	const uint8_t *planes[PLANE_COUNT] = { Y, U, V, A };
+	const uint32_t strides[PLANE_COUNT] = { strideY, strideU, strideV, strideA };
+	const bool compared = mValid && width == mWidth && height == mHeight && (A != nullptr) == mHasAlpha;
+
+	if (!compared)
+	{
+		mWidth = width;
+		mHeight = height;
+		mHasAlpha = A != nullptr;
+		mBlocksWide = (width + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE;
+		mBlocksHigh = (height + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE;
+		mStrides[PLANE_Y] = align_up(width);
+		mStrides[PLANE_U] = align_up(uvWidth);
+		mStrides[PLANE_V] = align_up(uvWidth);
+		mStrides[PLANE_A] = (mHasAlpha) ? align_up(width) : 0;
+		for (int i = 0; i < PLANE_COUNT; ++i)
+		{
+			if (!planes[i])
+			{
+				mPlanes[i].clear();
+				continue;
+			}
+			const bool chroma = i == PLANE_U || i == PLANE_V;
+			copy_plane(mPlanes[i], mStrides[i], planes[i], strides[i], (chroma) ? uvWidth : width, (chroma) ? uvHeight : height);
+		}
+		mDirty.assign(static_cast<size_t>(mBlocksWide) * mBlocksHigh, 1);
+		mDirtyBlocks = static_cast<uint32_t>(mDirty.size());
+		mValid = true;
+		_BuildRects();
+		return false;
+	}
+
+	// 16x16 블록은 4:2:0 색차 평면에서 8x8이라서 블록 번호가 그대로 맞는다
+	std::fill(mDirty.begin(), mDirty.end(), 0);
+	mDiffFunc(width, height, DIRTY_BLOCK_SIZE, Y, strideY, &mPlanes[PLANE_Y][0], mStrides[PLANE_Y], &mDirty[0], mBlocksWide);
+	mDiffFunc(uvWidth, uvHeight, DIRTY_BLOCK_SIZE / 2, U, strideU, &mPlanes[PLANE_U][0], mStrides[PLANE_U], &mDirty[0], mBlocksWide);
+	mDiffFunc(uvWidth, uvHeight, DIRTY_BLOCK_SIZE / 2, V, strideV, &mPlanes[PLANE_V][0], mStrides[PLANE_V], &mDirty[0], mBlocksWide);
+	if (A)
+		mDiffFunc(width, height, DIRTY_BLOCK_SIZE, A, strideA, &mPlanes[PLANE_A][0], mStrides[PLANE_A], &mDirty[0], mBlocksWide);
+	mDirtyBlocks = static_cast<uint32_t>(std::count(mDirty.begin(), mDirty.end(), 1));
+	_BuildRects();
+	return true;
+}
+
+uint64_t DirtyTracker::GetDirtyPixels() const
+{
+	uint64_t pixels = 0;
+	for (const Rect &rect : mRects)
+		pixels += static_cast<uint64_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+	return pixels;
+}
+
+void DirtyTracker::Reset()
+{
+	mValid = false;
+	mDirtyBlocks = 0;
+	mRects.clear();
+}
+
+void DirtyTracker::_BuildRects()
+{
+	mRects.clear();
+	if (mDirtyBlocks == 0)
+		return;
+
+	// 거의 다 바뀌었으면 나눠서 변환하고 올리는 것보다 한 번에 하는 편이 빠르다
+	const uint32_t totalBlocks = mBlocksWide * mBlocksHigh;
+	if (mDirtyBlocks * 4 >= totalBlocks * 3)
+	{
+		mRects.push_back({ 0, 0, mWidth, mHeight });
+		return;
+	}
+
+	for (uint32_t by = 0; by < mBlocksHigh; ++by)
+	{
+		const uint8_t *dirtyRow = &mDirty[by * mBlocksWide];
+		const uint32_t top = by * DIRTY_BLOCK_SIZE;
+		const uint32_t bottom = std::min(top + DIRTY_BLOCK_SIZE, mHeight);
+
+		// 이어진 블록을 정렬 경계까지 넓히고, 넓힌 범위가 닿으면 하나로 합친다
+		uint32_t runLeft = 0;
+		uint32_t runRight = 0;
+		uint32_t bx = 0;
+		while (bx < mBlocksWide)
+		{
+			if (!dirtyRow[bx])
+			{
+				bx++;
+				continue;
+			}
+
+			const uint32_t first = bx;
+			while (bx < mBlocksWide && dirtyRow[bx])
+				bx++;
+			const uint32_t left = (first * DIRTY_BLOCK_SIZE) & ~(DIRTY_RECT_ALIGNMENT - 1);
+			const uint32_t right = std::min(align_up(bx * DIRTY_BLOCK_SIZE), mWidth);
+			if (runRight != 0 && left <= runRight)
+			{
+				runRight = right;
+				continue;
+			}
+			if (runRight != 0)
+				_AddRect(runLeft, top, runRight, bottom);
+			runLeft = left;
+			runRight = right;
+		}
+		if (runRight != 0)
+			_AddRect(runLeft, top, runRight, bottom);
+
+		if (mRects.size() > DIRTY_MAX_RECTS)
+		{
+			mRects.assign(1, { 0, 0, mWidth, mHeight });
+			return;
+		}
+	}
+}
+
+void DirtyTracker::_AddRect(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+{
+	// 바로 위 블록 줄에서 가로 범위가 같은 사각형은 아래로 늘린다
+	for (Rect &rect : mRects)
+	{
+		if (rect.bottom == top && rect.left == left && rect.right == right)
+		{
+			rect.bottom = bottom;
+			return;
+		}
+	}
+	mRects.push_back({ left, top, right, bottom });
+}
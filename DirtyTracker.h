@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 연속해서 변환한 두 프레임의 YUV(A) 평면을 16x16 블록으로 비교해서 바뀐 영역을 사각형 목록으로 만든다.
+// 직전 프레임의 평면을 복사해두고, 비교하면서 바뀐 블록만 새 값으로 바꾼다
+class DirtyTracker
+{
+public:
+	// [left, right) x [top, bottom)
+	struct Rect
+	{
+		uint32_t left;
+		uint32_t top;
+		uint32_t right;
+		uint32_t bottom;
+	};
+
+	// plane_diff_blocks_std/sse/avx
+	using DiffFunc_t = uint32_t(*)(uint32_t, uint32_t, uint32_t, const uint8_t*, uint32_t, uint8_t*, uint32_t, uint8_t*, uint32_t);
+
+public:
+	DirtyTracker();
+
+public:
+	void SetDiffFunc(DiffFunc_t func);
+	// 저장해둔 평면과 비교하고 평면을 새 프레임으로 바꾼다. 처음이거나 크기, 알파 유무가 바뀌었으면 전체를 바뀐 것으로 보고 false.
+	// 사각형의 가로는 변환 커널의 정렬 로드에 맞춰 32픽셀 단위로 넓히고, 바뀐 블록이 많으면 프레임 전체 하나로 합친다
+	bool Update(uint32_t width, uint32_t height, const uint8_t *Y, const uint8_t *U, const uint8_t *V, const uint8_t *A,
+		uint32_t strideY, uint32_t strideU, uint32_t strideV, uint32_t strideA);
+	const std::vector<Rect> &GetRects() const { return mRects; }
+	// 사각형 넓이의 합
+	uint64_t GetDirtyPixels() const;
+	// 저장해둔 평면을 잊는다. 메모리는 다음 Update에서 다시 쓴다
+	void Reset();
+
+private:
+	void _BuildRects();
+	void _AddRect(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom);
+
+private:
+	enum
+	{
+		PLANE_Y,
+		PLANE_U,
+		PLANE_V,
+		PLANE_A,
+		PLANE_COUNT,
+	};
+
+	DiffFunc_t mDiffFunc;
+	uint32_t mWidth;
+	uint32_t mHeight;
+	uint32_t mBlocksWide;
+	uint32_t mBlocksHigh;
+	bool mHasAlpha;
+	bool mValid;
+	std::vector<uint8_t> mPlanes[PLANE_COUNT];
+	uint32_t mStrides[PLANE_COUNT];
+	std::vector<uint8_t> mDirty;	// 줄 순서로 블록마다 1바이트
+	uint32_t mDirtyBlocks;
+	std::vector<Rect> mRects;
+};
@@ -0,0 +1,85 @@
+#include "Frame.h"
+
+#include <utility>
+
+Frame::Frame() :
+	mPool(nullptr), mData(nullptr), mCapacity(0), mWidth(0), mHeight(0), mStride(0),
+	mFormat(FORMAT_RGBA), mFrameIndex(-1), mTimestamp(0)
+{
+}
+
+Frame::Frame(Frame &&other) : Frame()
+{
+	*this = std::move(other);
+}
+
+Frame::~Frame()
+{
+	Reset();
+}
+
+Frame &Frame::operator=(Frame &&other)
+{
+	if (this == &other)
+		return *this;
+
+	Reset();
+	mPool = other.mPool;
+	mData = other.mData;
+	mCapacity = other.mCapacity;
+	mWidth = other.mWidth;
+	mHeight = other.mHeight;
+	mStride = other.mStride;
+	mFormat = other.mFormat;
+	mFrameIndex = other.mFrameIndex;
+	mTimestamp = other.mTimestamp;
+
+	other.mPool = nullptr;
+	other.mData = nullptr;
+	other.mCapacity = 0;
+	other.Reset();
+	return *this;
+}
+
+bool Frame::Allocate(BufferPool *pool, uint32_t width, uint32_t height, uint32_t stride, FORMAT format)
+{
+	const size_t size = static_cast<size_t>(stride) * height;
+	if (!mData || mPool != pool || mCapacity < size)
+	{
+		Reset();
+		mPool = pool;
+		mData = pool->Acquire(size, mCapacity);
+		if (!mData)
+		{
+			mPool = nullptr;
+			return false;
+		}
+	}
+
+	mWidth = width;
+	mHeight = height;
+	mStride = stride;
+	mFormat = format;
+	return true;
+}
+
+void Frame::Reset()
+{
+	if (mPool)
+		mPool->Release(mData, mCapacity);
+	mPool = nullptr;
+	mData = nullptr;
+	mCapacity = 0;
+	mWidth = 0;
+	mHeight = 0;
+	mStride = 0;
+	mFormat = FORMAT_RGBA;
+	mFrameIndex = -1;
+	mTimestamp = 0;
+}
+
+void Frame::SetTimestamp(int64_t frameIndex, uint64_t timestamp_ns)
+{
+	mFrameIndex = frameIndex;
+	mTimestamp = timestamp_ns;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include "BufferPool.h"
+
+// BufferPool 버퍼를 가진 이동 전용 프레임. 소멸되거나 Reset되면 버퍼가 풀로 돌아간다.
+// 디코더의 다음 Update와 상관없이 유지되므로 다른 스레드로 복사 없이 넘길 수 있다.
+class Frame
+{
+public:
+	enum FORMAT
+	{
+		FORMAT_RGBA,
+	};
+
+public:
+	Frame();
+	Frame(Frame &&other);
+	~Frame();
+
+	Frame &operator=(Frame &&other);
+	Frame(const Frame&) = delete;
+	Frame &operator=(const Frame&) = delete;
+
+public:
+	// 지금 버퍼가 충분히 크면 그대로 쓰고, 아니면 pool에서 새로 받는다
+	bool Allocate(BufferPool *pool, uint32_t width, uint32_t height, uint32_t stride, FORMAT format);
+	void Reset();
+	void SetTimestamp(int64_t frameIndex, uint64_t timestamp_ns);
+
+	bool IsValid() const { return mData != nullptr; }
+	explicit operator bool() const { return IsValid(); }
+	uint8_t *GetData() { return mData; }
+	const uint8_t *GetData() const { return mData; }
+	size_t GetCapacity() const { return mCapacity; }
+	uint32_t GetWidth() const { return mWidth; }
+	uint32_t GetHeight() const { return mHeight; }
+	uint32_t GetStride() const { return mStride; }
+	FORMAT GetFormat() const { return mFormat; }
+	int64_t GetFrameIndex() const { return mFrameIndex; }
+	// 재생 시작 기준 표시 시간
+	uint64_t GetTimestamp() const { return mTimestamp; }
+
+private:
+	BufferPool *mPool;
+	uint8_t *mData;
+	size_t mCapacity;
+	uint32_t mWidth;
+	uint32_t mHeight;
+	uint32_t mStride;
+	FORMAT mFormat;
+	int64_t mFrameIndex;
+	uint64_t mTimestamp;
+};
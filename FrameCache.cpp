@@ -0,0 +1,151 @@
+#include "FrameCache.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+FrameCache::FrameCache(size_t budgetBytes /*= 256 * 1024 * 1024*/) :
+	mBudget(budgetBytes), mBytes(0), mHits(0), mMisses(0), mEvictions(0)
+{
+}
+
+FrameCache::~FrameCache()
+{
+}
+
+void FrameCache::SetBudget(size_t budgetBytes)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	mBudget = budgetBytes;
+	_Evict();
+}
+
+std::shared_ptr<const FrameCache::Frame> FrameCache::Acquire(const Key &key, bool &owner)
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	while (true)
+	{
+		auto it = mEntries.find(key);
+		if (it == mEntries.end())
+		{
+			Entry &entry = mEntries[key];
+			entry.pending = true;
+			entry.lru = mLRU.end();
+			mMisses++;
+			owner = true;
+			return nullptr;
+		}
+
+		if (!it->second.pending)
+		{
+			mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+			mHits++;
+			owner = false;
+			return it->second.frame;
+		}
+
+		// 디코딩 중인 디코더는 항상 실행 중이므로 기다려도 교착되지 않는다
+		mPublishCV.wait(lock);
+	}
+}
+
+void FrameCache::Publish(const Key &key, std::shared_ptr<const Frame> frame)
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		auto it = mEntries.find(key);
+		if (it == mEntries.end() || !it->second.pending)
+			return;
+
+		if (!frame)
+		{
+			mEntries.erase(it);
+		}
+		else
+		{
+			Entry &entry = it->second;
+			entry.frame = std::move(frame);
+			entry.pending = false;
+			mLRU.push_front(key);
+			entry.lru = mLRU.begin();
+			mBytes += entry.frame->pixels.size();
+			_Evict();
+		}
+	}
+	mPublishCV.notify_all();
+}
+
+FrameCache::Stats FrameCache::GetStats()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	Stats stats;
+	stats.hits = mHits;
+	stats.misses = mMisses;
+	stats.evictions = mEvictions;
+	stats.frame_count = mLRU.size();
+	stats.bytes = mBytes;
+	return stats;
+}
+
+void FrameCache::Clear()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	for (const Key &key : mLRU)
+		mEntries.erase(key);
+	mLRU.clear();
+	mBytes = 0;
+}
+
+uint64_t FrameCache::HashFileIdentity(const std::string &fileName)
+{
+	uint64_t hash = fnv1a(FNV_OFFSET_BASIS, reinterpret_cast<const uint8_t*>(fileName.data()), fileName.size());
+
+	// 같은 경로에 다시 쓴 파일은 크기나 수정 시각이 달라진다
+	struct _stat64 info;
+	if (_stat64(fileName.c_str(), &info) == 0)
+	{
+		const int64_t size = info.st_size;
+		const int64_t modified = info.st_mtime;
+		hash = fnv1a(hash, reinterpret_cast<const uint8_t*>(&size), sizeof(size));
+		hash = fnv1a(hash, reinterpret_cast<const uint8_t*>(&modified), sizeof(modified));
+	}
+	return hash;
+}
+
+uint64_t FrameCache::Hash(uint64_t hash, const void *data, size_t size)
+{
+	return fnv1a(hash, static_cast<const uint8_t*>(data), size);
+}
+
+size_t FrameCache::KeyHash::operator()(const Key &key) const
+{
+	uint64_t hash = fnv1a(FNV_OFFSET_BASIS, reinterpret_cast<const uint8_t*>(&key.asset_hash), sizeof(key.asset_hash));
+	hash = fnv1a(hash, reinterpret_cast<const uint8_t*>(&key.frame_index), sizeof(key.frame_index));
+	hash = fnv1a(hash, reinterpret_cast<const uint8_t*>(&key.format), sizeof(key.format));
+	hash = fnv1a(hash, reinterpret_cast<const uint8_t*>(&key.scale), sizeof(key.scale));
+	return static_cast<size_t>(hash);
+}
+
+void FrameCache::_Evict()
+{
+	while (mBytes > mBudget && !mLRU.empty())
+	{
+		auto it = mEntries.find(mLRU.back());
+		mBytes -= it->second.frame->pixels.size();
+		mEntries.erase(it);
+		mLRU.pop_back();
+		mEvictions++;
+	}
+}
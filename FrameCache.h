@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// (에셋 해시, 프레임 번호, 출력 포맷, 스케일)로 찾는 프로세스 공용 프레임 캐시.
+// 같은 에셋을 같은 위치에서 재생하는 디코더들은 한 번만 디코딩하고 변환된 프레임을 나눠 쓴다.
+class FrameCache
+{
+public:
+	enum FORMAT
+	{
+		FORMAT_RGBA,
+	};
+
+	struct Key
+	{
+		uint64_t asset_hash;
+		uint64_t frame_index;
+		uint32_t format;
+		uint32_t scale;
+
+		bool operator==(const Key &rhs) const
+		{
+			return asset_hash == rhs.asset_hash && frame_index == rhs.frame_index &&
+				format == rhs.format && scale == rhs.scale;
+		}
+	};
+
+	// 캐시에 들어간 뒤로는 바뀌지 않는다
+	struct Frame
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t frame_count;
+		size_t bytes;
+	};
+
+public:
+	explicit FrameCache(size_t budgetBytes = 256 * 1024 * 1024);
+	~FrameCache();
+
+public:
+	void SetBudget(size_t budgetBytes);
+	// 캐시에 있으면 프레임을 돌려준다. 없으면 owner가 true가 되고 호출한 쪽이 디코딩 후 Publish 해야 한다.
+	// 다른 디코더가 같은 프레임을 디코딩 중이면 끝날 때까지 기다린다.
+	std::shared_ptr<const Frame> Acquire(const Key &key, bool &owner);
+	// frame이 nullptr이면 디코딩 실패로 보고 대기 중인 쪽에 소유권을 넘긴다
+	void Publish(const Key &key, std::shared_ptr<const Frame> frame);
+	Stats GetStats();
+	void Clear();
+
+	// 경로, 크기, 마지막 수정 시각의 해시. 파일 내용은 읽지 않는다
+	static uint64_t HashFileIdentity(const std::string &fileName);
+	// hash에 data를 이어서 해시한다. 헤더처럼 파일 앞쪽의 일부만 더할 때 쓴다
+	static uint64_t Hash(uint64_t hash, const void *data, size_t size);
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+
+	struct Entry
+	{
+		std::shared_ptr<const Frame> frame;
+		std::list<Key>::iterator lru;
+		bool pending;
+	};
+
+	void _Evict();
+
+private:
+	std::mutex mLock;
+	std::condition_variable mPublishCV;
+	std::unordered_map<Key, Entry, KeyHash> mEntries;
+	std::list<Key> mLRU;
+	size_t mBudget;
+	size_t mBytes;
+	uint64_t mHits;
+	uint64_t mMisses;
+	uint64_t mEvictions;
+};
@@ -0,0 +1,137 @@
+#include "LoopCache.h"
+#include "Lz4.h"
+
+#include <cstring>
+
+LoopCache::LoopCache(size_t memoryBudget /*= 256 * 1024 * 1024*/) : mMemoryBudget(memoryBudget), mMemoryUsage(0)
+{
+}
+
+LoopCache::~LoopCache()
+{
+}
+
+void LoopCache::SetMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	mMemoryBudget = bytes;
+}
+
+size_t LoopCache::GetMemoryUsage()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	return mMemoryUsage;
+}
+
+std::shared_ptr<LoopCache::Clip> LoopCache::Acquire(const std::string &key, STORAGE storage)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	std::shared_ptr<Clip> &clip = mClips[key];
+	if (!clip)
+		clip = std::make_shared<Clip>(storage);
+	return clip;
+}
+
+bool LoopCache::BeginBuild(Clip *clip)
+{
+	if (!clip || clip->complete || clip->rejected)
+		return false;
+
+	bool expected = false;
+	return clip->building.compare_exchange_strong(expected, true);
+}
+
+bool LoopCache::AddFrame(Clip *clip, uint64_t timestamp_ns, uint32_t width, uint32_t height, const uint8_t *rgba)
+{
+	if (!clip || !clip->building || clip->rejected)
+		return false;
+
+	const int rawSize = static_cast<int>(width * height * 4);
+	Frame frame;
+	frame.timestamp_ns = timestamp_ns;
+	frame.width = width;
+	frame.height = height;
+	if (clip->storage == STORAGE::LZ4)
+	{
+		// 압축은 락 밖에서 한다
+		frame.data.resize(lz4_compress_bound(rawSize));
+		const int size = lz4_compress(rgba, rawSize, &frame.data[0], static_cast<int>(frame.data.size()));
+		if (size < 0)
+			return false;
+		frame.data.resize(size);
+		frame.data.shrink_to_fit();
+	}
+	else
+	{
+		frame.data.assign(rgba, rgba + rawSize);
+	}
+
+	std::lock_guard<std::mutex> guard(mLock);
+	if (mMemoryUsage + frame.data.size() > mMemoryBudget)
+	{
+		// 예산을 넘는 클립은 다시 만들지 않도록 표시만 남긴다
+		clip->rejected = true;
+		_DiscardFrames(clip);
+		return false;
+	}
+	mMemoryUsage += frame.data.size();
+	clip->bytes += frame.data.size();
+	clip->frames.push_back(std::move(frame));
+	return true;
+}
+
+void LoopCache::EndBuild(Clip *clip, bool complete)
+{
+	if (!clip || !clip->building)
+		return;
+
+	std::lock_guard<std::mutex> guard(mLock);
+	if (complete && !clip->rejected && !clip->frames.empty())
+	{
+		clip->complete = true;
+	}
+	else
+	{
+		_DiscardFrames(clip);
+	}
+	clip->building = false;
+}
+
+bool LoopCache::ReadFrame(const Clip *clip, size_t index, uint8_t *rgba)
+{
+	if (!clip || !clip->complete || index >= clip->frames.size())
+		return false;
+
+	const Frame &frame = clip->frames[index];
+	const int rawSize = static_cast<int>(frame.width * frame.height * 4);
+	if (clip->storage == STORAGE::LZ4)
+		return lz4_decompress(&frame.data[0], static_cast<int>(frame.data.size()), rgba, rawSize) == rawSize;
+
+	memcpy(rgba, &frame.data[0], rawSize);
+	return true;
+}
+
+void LoopCache::Clear()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	for (auto it = mClips.begin(); it != mClips.end();)
+	{
+		if (it->second.use_count() == 1)
+		{
+			mMemoryUsage -= it->second->bytes;
+			it = mClips.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void LoopCache::_DiscardFrames(Clip *clip)
+{
+	mMemoryUsage -= clip->bytes;
+	clip->bytes = 0;
+	clip->frames.clear();
+	clip->frames.shrink_to_fit();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 루프 재생 클립의 변환된 프레임을 첫 루프 동안 모아두고, 이후 루프는 메모리에서 바로 꺼내준다.
+// 같은 에셋을 재생하는 디코더끼리 하나의 LoopCache를 공유하면 한 번만 디코딩한다.
+class LoopCache
+{
+public:
+	enum STORAGE
+	{
+		RAW,
+		LZ4,
+	};
+
+	struct Frame
+	{
+		uint64_t timestamp_ns;
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> data;
+	};
+
+	struct Clip
+	{
+		STORAGE storage;
+		std::vector<Frame> frames;
+		size_t bytes;
+		std::atomic<bool> building;
+		std::atomic<bool> complete;
+		std::atomic<bool> rejected;
+
+		Clip(STORAGE type) : storage(type), bytes(0), building(false), complete(false), rejected(false) {}
+	};
+
+public:
+	explicit LoopCache(size_t memoryBudget = 256 * 1024 * 1024);
+	~LoopCache();
+
+public:
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryUsage();
+	std::shared_ptr<Clip> Acquire(const std::string &key, STORAGE storage);
+	// 첫 루프를 채울 디코더 하나만 true를 받는다
+	bool BeginBuild(Clip *clip);
+	bool AddFrame(Clip *clip, uint64_t timestamp_ns, uint32_t width, uint32_t height, const uint8_t *rgba);
+	void EndBuild(Clip *clip, bool complete);
+	bool ReadFrame(const Clip *clip, size_t index, uint8_t *rgba);
+	// 사용 중이지 않은 클립을 모두 버린다
+	void Clear();
+
+private:
+	void _DiscardFrames(Clip *clip);
+
+private:
+	std::mutex mLock;
+	std::unordered_map<std::string, std::shared_ptr<Clip>> mClips;
+	size_t mMemoryBudget;
+	size_t mMemoryUsage;
+};
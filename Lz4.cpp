@@ -0,0 +1,220 @@
+#include "Lz4.h"
+#include <cstring>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+#define LZ4_HASH_LOG 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_SKIP_TRIGGER 6
+
+static inline uint32_t lz4_read32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint64_t lz4_read64(const uint8_t* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t lz4_hash(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline uint8_t* lz4_write_length(uint8_t* op, size_t length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+static inline uint8_t* lz4_write_literals(uint8_t* op, const uint8_t* anchor, size_t length, uint8_t* token)
+{
+	*token = (uint8_t)(((length >= 15) ? 15 : length) << 4);
+	if (length >= 15)
+		op = lz4_write_length(op, length - 15);
+	memcpy(op, anchor, length);
+	return op + length;
+}
+
+int lz4_compress_bound(int src_size)
+{
+	return (src_size < 0) ? -1 : src_size + src_size / 255 + 16;
+}
+
+int lz4_compress(const uint8_t* src, int src_size, uint8_t* dst, int dst_capacity)
+{
+	if (src_size < 0 || dst_capacity < lz4_compress_bound(src_size))
+		return -1;
+
+	const uint8_t* ip = src;
+	const uint8_t* anchor = src;
+	const uint8_t* const end = src + src_size;
+	uint8_t* op = dst;
+
+	if (src_size > LZ4_MF_LIMIT)
+	{
+		// 테이블에는 src 기준 위치를 저장한다. 0으로 초기화된 항목도 비교 후에만 사용되므로 안전하다
+		uint32_t table[1 << LZ4_HASH_LOG];
+		memset(table, 0, sizeof(table));
+
+		const uint8_t* const match_limit = end - LZ4_MF_LIMIT;
+		const uint8_t* const copy_limit = end - LZ4_LAST_LITERALS;
+		uint32_t search_count = 1 << LZ4_SKIP_TRIGGER;
+
+		ip++;
+		while (ip < match_limit)
+		{
+			const uint32_t h = lz4_hash(lz4_read32(ip));
+			const uint8_t* ref = src + table[h];
+			table[h] = (uint32_t)(ip - src);
+			if ((ip - ref) > LZ4_MAX_OFFSET || lz4_read32(ref) != lz4_read32(ip))
+			{
+				// 압축이 안 되는 구간은 점점 크게 건너뛴다
+				ip += search_count++ >> LZ4_SKIP_TRIGGER;
+				continue;
+			}
+			search_count = 1 << LZ4_SKIP_TRIGGER;
+
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			const uint8_t* match_end = ip + LZ4_MIN_MATCH;
+			const uint8_t* ref_end = ref + LZ4_MIN_MATCH;
+			while (match_end + 8 <= copy_limit && lz4_read64(match_end) == lz4_read64(ref_end))
+			{
+				match_end += 8;
+				ref_end += 8;
+			}
+			while (match_end < copy_limit && *match_end == *ref_end)
+			{
+				match_end++;
+				ref_end++;
+			}
+
+			uint8_t* token = op++;
+			op = lz4_write_literals(op, anchor, ip - anchor, token);
+
+			const size_t offset = ip - ref;
+			op[0] = (uint8_t)(offset & 0xFF);
+			op[1] = (uint8_t)(offset >> 8);
+			op += 2;
+
+			const size_t match_length = (match_end - ip) - LZ4_MIN_MATCH;
+			*token |= (uint8_t)((match_length >= 15) ? 15 : match_length);
+			if (match_length >= 15)
+				op = lz4_write_length(op, match_length - 15);
+
+			ip = match_end;
+			anchor = ip;
+			if (ip < match_limit)
+				table[lz4_hash(lz4_read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+		}
+	}
+
+	uint8_t* token = op++;
+	op = lz4_write_literals(op, anchor, end - anchor, token);
+	return (int)(op - dst);
+}
+
+int lz4_decompress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size)
+{
+	if (src_size <= 0 || dst_size < 0)
+		return -1;
+
+	const uint8_t* ip = src;
+	const uint8_t* const iend = src + src_size;
+	uint8_t* op = dst;
+	uint8_t* const oend = dst + dst_size;
+
+	while (ip < iend)
+	{
+		const uint8_t token = *ip++;
+
+		size_t literal_length = token >> 4;
+		if (literal_length == 15)
+		{
+			uint8_t s;
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				s = *ip++;
+				literal_length += s;
+			} while (s == 255);
+		}
+		if (literal_length > (size_t)(iend - ip) || literal_length > (size_t)(oend - op))
+			return -1;
+		memcpy(op, ip, literal_length);
+		op += literal_length;
+		ip += literal_length;
+
+		// 마지막 시퀀스는 리터럴만 가진다
+		if (ip >= iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		const size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return -1;
+
+		size_t match_length = token & 15;
+		if (match_length == 15)
+		{
+			uint8_t s;
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				s = *ip++;
+				match_length += s;
+			} while (s == 255);
+		}
+		match_length += LZ4_MIN_MATCH;
+		if (match_length > (size_t)(oend - op))
+			return -1;
+
+		const uint8_t* match = op - offset;
+		if (offset < 8)
+		{
+			// 짧은 주기의 반복은 8바이트 이상인 주기의 배수로 늘려서 8바이트씩 복사한다
+			size_t period = offset;
+			while (period < 8)
+				period += offset;
+
+			size_t head = period - offset;
+			if (head > match_length)
+				head = match_length;
+			for (size_t i = 0; i < head; ++i)
+				op[i] = match[i];
+			op += head;
+			match_length -= head;
+			match = op - period;
+		}
+		while (match_length >= 8)
+		{
+			memcpy(op, match, 8);
+			op += 8;
+			match += 8;
+			match_length -= 8;
+		}
+		while (match_length--)
+			*op++ = *match++;
+	}
+	return (int)(op - dst);
+}
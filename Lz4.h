@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdint>
+
+// LZ4 블록 포맷(프레임 헤더 없음) 압축/해제. 실패하면 -1을 반환한다.
+int lz4_compress_bound(int src_size);
+int lz4_compress(const uint8_t* src, int src_size, uint8_t* dst, int dst_capacity);
+int lz4_decompress(const uint8_t* src, int src_size, uint8_t* dst, int dst_size);
@@ -0,0 +1,219 @@
+#include "PrefetchReader.h"
+
+#include <chrono>
+#include <cstring>
+
+static uint64_t elapsed_us(const std::chrono::steady_clock::time_point &begin)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+PrefetchReader::PrefetchReader(FILE *file, const std::string &fileName, uint32_t bufferCount) :
+	mFile(file), mIoFile(nullptr), mLength(0), mQuit(false)
+{
+	memset(&mStats, 0, sizeof(mStats));
+
+	if (mFile)
+	{
+		_fseeki64(mFile, 0, SEEK_END);
+		mLength = _ftelli64(mFile);
+		_fseeki64(mFile, 0, SEEK_SET);
+	}
+
+	if (fopen_s(&mIoFile, fileName.c_str(), "rb"))
+		mIoFile = nullptr;
+
+	mBuffers.resize(bufferCount);
+	for (Buffer &buffer : mBuffers)
+	{
+		buffer.pos = 0;
+		buffer.size = 0;
+		buffer.state = BUFFER_STATE::EMPTY;
+	}
+
+	if (mIoFile)
+		mThread = std::thread(&PrefetchReader::_IoMain, this);
+}
+
+PrefetchReader::~PrefetchReader()
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mQuit = true;
+	}
+	mRequestCV.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+
+	if (mIoFile)
+		fclose(mIoFile);
+}
+
+bool PrefetchReader::IsOpen() const
+{
+	return mFile && mIoFile;
+}
+
+int PrefetchReader::Read(long long pos, long len, unsigned char *buf)
+{
+	if (!mFile || pos < 0 || len < 0)
+		return -1;
+	if (len == 0)
+		return 0;
+
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		Buffer *buffer = _FindBuffer(pos, len);
+		if (buffer && buffer->state == BUFFER_STATE::LOADING)
+		{
+			// 이미 읽고 있는 구간이면 파일을 다시 읽지 않고 끝날 때까지 기다린다
+			const auto begin = std::chrono::steady_clock::now();
+			mReadyCV.wait(lock, [buffer]() { return buffer->state != BUFFER_STATE::LOADING; });
+			mStats.stall_us += elapsed_us(begin);
+
+			// 읽기에 실패한 버퍼는 기다리는 동안 다른 구간을 읽는 데 다시 쓰일 수 있으므로 다시 찾는다
+			buffer = _FindBuffer(pos, len);
+		}
+
+		if (buffer && buffer->state == BUFFER_STATE::READY)
+		{
+			memcpy(buf, &buffer->data[static_cast<size_t>(pos - buffer->pos)], len);
+			mStats.hits++;
+			mStats.bytes_served += len;
+			return 0;
+		}
+		mStats.misses++;
+	}
+
+	const auto begin = std::chrono::steady_clock::now();
+	if (_fseeki64(mFile, pos, SEEK_SET))
+		return -1;
+	const size_t size = fread(buf, 1, len, mFile);
+
+	std::lock_guard<std::mutex> guard(mLock);
+	mStats.stall_us += elapsed_us(begin);
+	return (size < static_cast<size_t>(len)) ? -1 : 0;
+}
+
+int PrefetchReader::Length(long long *total, long long *available)
+{
+	if (!mFile)
+		return -1;
+	if (total)
+		*total = mLength;
+	if (available)
+		*available = mLength;
+	return 0;
+}
+
+void PrefetchReader::Prefetch(const std::vector<Range> &ranges)
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mRequests.clear();
+		for (const Range &range : ranges)
+		{
+			if (range.pos >= 0 && range.size > 0 && range.pos + range.size <= mLength)
+				mRequests.push_back(range);
+		}
+	}
+	mRequestCV.notify_one();
+}
+
+PrefetchReader::Stats PrefetchReader::GetStats()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	return mStats;
+}
+
+PrefetchReader::Buffer *PrefetchReader::_FindBuffer(long long pos, long long size)
+{
+	for (Buffer &buffer : mBuffers)
+	{
+		if (buffer.state != BUFFER_STATE::EMPTY && pos >= buffer.pos && pos + size <= buffer.pos + buffer.size)
+			return &buffer;
+	}
+	return nullptr;
+}
+
+bool PrefetchReader::_IsRequested(const Buffer &buffer) const
+{
+	for (const Range &range : mRequests)
+	{
+		if (range.pos == buffer.pos && range.size == buffer.size)
+			return true;
+	}
+	return false;
+}
+
+void PrefetchReader::_IoMain()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	while (!mQuit)
+	{
+		// 요청 순서대로 아직 버퍼에 없는 구간을 찾아, 요청 목록에서 빠진 버퍼에 읽어 넣는다
+		Range range = { 0, 0 };
+		Buffer *target = nullptr;
+		for (const Range &request : mRequests)
+		{
+			bool loaded = false;
+			for (const Buffer &buffer : mBuffers)
+			{
+				if (buffer.state != BUFFER_STATE::EMPTY && buffer.pos == request.pos && buffer.size == request.size)
+				{
+					loaded = true;
+					break;
+				}
+			}
+			if (loaded)
+				continue;
+
+			for (Buffer &buffer : mBuffers)
+			{
+				if (buffer.state == BUFFER_STATE::EMPTY ||
+					(buffer.state == BUFFER_STATE::READY && !_IsRequested(buffer)))
+				{
+					target = &buffer;
+					break;
+				}
+			}
+			range = request;
+			break;
+		}
+
+		if (!target)
+		{
+			mRequestCV.wait(lock);
+			continue;
+		}
+
+		target->state = BUFFER_STATE::LOADING;
+		target->pos = range.pos;
+		target->size = range.size;
+		lock.unlock();
+
+		target->data.resize(static_cast<size_t>(range.size));
+		bool ok = _fseeki64(mIoFile, range.pos, SEEK_SET) == 0 &&
+			fread(&target->data[0], 1, target->data.size(), mIoFile) == target->data.size();
+
+		lock.lock();
+		target->state = ok ? BUFFER_STATE::READY : BUFFER_STATE::EMPTY;
+		if (ok)
+		{
+			mStats.bytes_prefetched += range.size;
+		}
+		else
+		{
+			// 읽지 못한 구간은 다시 시도하지 않고 디코딩 스레드가 직접 읽게 둔다
+			for (auto it = mRequests.begin(); it != mRequests.end(); ++it)
+			{
+				if (it->pos == range.pos && it->size == range.size)
+				{
+					mRequests.erase(it);
+					break;
+				}
+			}
+		}
+		mReadyCV.notify_all();
+	}
+}
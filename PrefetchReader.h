@@ -0,0 +1,78 @@
+#pragma once
+
+#include <mkvparser.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 앞으로 읽을 클러스터 구간을 전용 I/O 스레드에서 미리 읽어두고, 파서의 Read를 메모리에서 처리하는 리더.
+// 버퍼에 없는 구간은 디코딩 스레드에서 바로 파일을 읽는다.
+class PrefetchReader : public mkvparser::IMkvReader
+{
+public:
+	struct Range
+	{
+		long long pos;
+		long long size;
+	};
+
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t bytes_prefetched;
+		uint64_t bytes_served;
+		uint64_t stall_us;
+	};
+
+public:
+	// file은 디코딩 스레드에서 쓰고, I/O 스레드는 fileName으로 파일을 따로 연다
+	PrefetchReader(FILE *file, const std::string &fileName, uint32_t bufferCount);
+	virtual ~PrefetchReader();
+
+public:
+	bool IsOpen() const;
+	virtual int Read(long long pos, long len, unsigned char *buf) override;
+	virtual int Length(long long *total, long long *available) override;
+	// 앞으로 읽을 순서대로 구간을 넘긴다. 목록에 없는 버퍼는 재사용된다
+	void Prefetch(const std::vector<Range> &ranges);
+	Stats GetStats();
+
+private:
+	enum BUFFER_STATE
+	{
+		EMPTY,
+		LOADING,
+		READY,
+	};
+
+	struct Buffer
+	{
+		long long pos;
+		long long size;
+		std::vector<uint8_t> data;
+		BUFFER_STATE state;
+	};
+
+	Buffer *_FindBuffer(long long pos, long long size);
+	bool _IsRequested(const Buffer &buffer) const;
+	void _IoMain();
+
+private:
+	FILE *mFile;
+	FILE *mIoFile;
+	long long mLength;
+	std::vector<Buffer> mBuffers;
+	std::vector<Range> mRequests;
+	std::mutex mLock;
+	std::condition_variable mRequestCV;
+	std::condition_variable mReadyCV;
+	std::thread mThread;
+	Stats mStats;
+	bool mQuit;
+};
@@ -0,0 +1,482 @@
+#include "ReverseDecoder.h"
+#include "DebugTrace.h"
+#include "Lz4.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+// Start 후 워커가 from을 실제 프레임 번호로 바꾸기 전
+#define UNRESOLVED_FRAME LLONG_MIN
+// LZ4가 I420을 이보다 작게 줄이는 경우는 드물다. 예산에 들어갈 수 없는 앞쪽 프레임은 압축하지 않는다
+#define CHECKPOINT_MAX_RATIO 8
+
+static void copy_plane(uint8_t *dst, const uint8_t *src, int srcStride, uint32_t width, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(dst + y * width, src + y * srcStride, width);
+}
+
+// 변환은 내보낼 때 하므로 디코딩한 평면을 빈틈 없이 옮겨 담는다
+static void copy_image(const vpx_image_t *img, const vpx_image_t *imgAlpha, ReverseDecoder::Frame &out)
+{
+	out.width = (img) ? img->d_w : 0;
+	out.height = (img) ? img->d_h : 0;
+	out.has_alpha = img && imgAlpha;
+	if (!img)
+	{
+		out.planes.clear();
+		return;
+	}
+
+	const size_t sizeY = static_cast<size_t>(out.width) * out.height;
+	const uint32_t widthUV = (out.width + 1) / 2;
+	const uint32_t heightUV = (out.height + 1) / 2;
+	const size_t sizeUV = static_cast<size_t>(widthUV) * heightUV;
+	out.planes.resize(sizeY + sizeUV * 2 + ((out.has_alpha) ? sizeY : 0));
+
+	uint8_t *dst = &out.planes[0];
+	copy_plane(dst, img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y], out.width, out.height);
+	copy_plane(dst + sizeY, img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U], widthUV, heightUV);
+	copy_plane(dst + sizeY + sizeUV, img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V], widthUV, heightUV);
+	if (out.has_alpha)
+		copy_plane(dst + sizeY + sizeUV * 2, imgAlpha->planes[VPX_PLANE_Y], imgAlpha->stride[VPX_PLANE_Y], out.width, out.height);
+}
+
+ReverseDecoder::ReverseDecoder() :
+	mFile(nullptr), mReader(nullptr), mSegment(nullptr), mCheckpointBytes(0), mCheckpointBudget(0), mCheckpointKey(-1),
+	mReportedKey(-1), mVideoTrack(0), mWidth(0), mHeight(0), mFrameBytes(1),
+	mMemoryBudget(64 * 1024 * 1024), mConvert(nullptr), mCursor(0), mFrom(0), mTo(0),
+	mNextLast(UNRESOLVED_FRAME), mGeneration(0), mStarted(false), mConsumed(false),
+	mIndexed(false), mFailed(false), mBusy(false), mQuit(false)
+{
+	mDecoder.iface = nullptr;
+	mDecoderAlpha.iface = nullptr;
+	mBuffer.resize(1024 * 256);
+	mBufferAlpha.resize(1024 * 256);
+}
+
+ReverseDecoder::~ReverseDecoder()
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mQuit = true;
+		mGeneration++;
+	}
+	mWorkCV.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+
+	if (mDecoder.iface)
+		vpx_codec_destroy(&mDecoder);
+	if (mDecoderAlpha.iface)
+		vpx_codec_destroy(&mDecoderAlpha);
+	delete mSegment;
+	delete mReader;
+	if (mFile)
+		fclose(mFile);
+}
+
+bool ReverseDecoder::Open(const std::string &fileName, vpx_codec_iface_t *iface, int videoTrack,
+	uint32_t width, uint32_t height, ConvertFunc_t convert)
+{
+	if (mFile)
+		return false;
+
+	if (fopen_s(&mFile, fileName.c_str(), "rb"))
+	{
+		mFile = nullptr;
+		return false;
+	}
+
+	if (vpx_codec_dec_init(&mDecoder, iface, nullptr, 0) ||
+		vpx_codec_dec_init(&mDecoderAlpha, iface, nullptr, 0))
+	{
+		return false;
+	}
+
+	mReader = new mkvparser::MkvReader(mFile);
+	mVideoTrack = videoTrack;
+	mWidth = width;
+	mHeight = height;
+	mConvert = convert;
+
+	// 세그먼트 파싱과 프레임 목록 작성도 워커에서 한다
+	mThread = std::thread(&ReverseDecoder::_WorkerMain, this);
+	return true;
+}
+
+bool ReverseDecoder::IsOpen()
+{
+	return mThread.joinable();
+}
+
+void ReverseDecoder::SetMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	mMemoryBudget = bytes;
+}
+
+void ReverseDecoder::Start(int64_t from, int64_t to)
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		// 미리 준비해둔 구간을 그대로 쓸 수 있으면 버리지 않는다
+		if (mStarted && !mConsumed && mFrom == from && mTo == to)
+			return;
+
+		mGeneration++;
+		if (mCurrent)
+			mSpare = std::move(mCurrent);
+		if (mReady)
+			mSpare = std::move(mReady);
+		mCursor = 0;
+		mFrom = from;
+		mTo = std::max<int64_t>(to, 0);
+		mNextLast = UNRESOLVED_FRAME;
+		mStarted = true;
+		mConsumed = false;
+		// 인덱스를 만들지 못한 경우가 아니면 이전 디코딩 실패는 새 구간에 이어지지 않는다
+		if (mIndexed && !mFrames.empty())
+			mFailed = false;
+	}
+	mWorkCV.notify_one();
+}
+
+const ReverseDecoder::Frame *ReverseDecoder::Next()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	if (!mStarted)
+		return nullptr;
+
+	while (true)
+	{
+		if (mCurrent && mCursor > 0)
+		{
+			mConsumed = true;
+			return &mCurrent->frames[--mCursor];
+		}
+
+		if (mReady)
+		{
+			// 다 보여준 구간은 워커가 다음 구간을 담는 데 다시 쓴다
+			if (mCurrent)
+				mSpare = std::move(mCurrent);
+			mCurrent = std::move(mReady);
+			mCursor = mCurrent->frames.size();
+			mWorkCV.notify_one();
+			continue;
+		}
+
+		const bool finished = mIndexed &&
+			(mFailed || (mNextLast != UNRESOLVED_FRAME && mNextLast < mTo && !mBusy));
+		if (finished)
+			return nullptr;
+
+		mReadyCV.wait(lock);
+	}
+}
+
+const ReverseDecoder::Frame *ReverseDecoder::Peek()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	if (mCurrent && mCursor > 0)
+		return &mCurrent->frames[mCursor - 1];
+	if (mReady && !mReady->frames.empty())
+		return &mReady->frames.back();
+	return nullptr;
+}
+
+void ReverseDecoder::Convert(const Frame *frame, uint8_t *RGBA, uint32_t stride)
+{
+	if (!frame || frame->planes.empty())
+		return;
+
+	const uint8_t *planes = &frame->planes[0];
+	const uint32_t widthUV = (frame->width + 1) / 2;
+	const size_t sizeY = static_cast<size_t>(frame->width) * frame->height;
+	const size_t sizeUV = static_cast<size_t>(widthUV) * ((frame->height + 1) / 2);
+	mConvert(frame->width, frame->height,
+		planes, planes + sizeY, planes + sizeY + sizeUV,
+		(frame->has_alpha) ? planes + sizeY + sizeUV * 2 : nullptr,
+		frame->width, widthUV, widthUV, (frame->has_alpha) ? frame->width : 0,
+		RGBA, stride, YCBCR_JPEG, nullptr);
+}
+
+bool ReverseDecoder::FindKeyFrame(int64_t frameIndex, int64_t &keyIndex, uint64_t &keyTimestamp)
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	if (!_WaitIndex(lock))
+		return false;
+
+	int64_t index = std::min<int64_t>(std::max<int64_t>(frameIndex, 0), mFrames.size() - 1);
+	while (index > 0 && !mFrames[index].is_key)
+		--index;
+
+	keyIndex = index;
+	keyTimestamp = mFrames[index].timestamp_ns;
+	return true;
+}
+
+bool ReverseDecoder::_WaitIndex(std::unique_lock<std::mutex> &lock)
+{
+	mReadyCV.wait(lock, [this]() { return mIndexed; });
+	return !mFrames.empty();
+}
+
+bool ReverseDecoder::_BuildIndex()
+{
+	mkvparser::EBMLHeader ebmlHeader;
+	long long pos = 0;
+	if (ebmlHeader.Parse(mReader, pos) < 0)
+		return false;
+
+	if (mkvparser::Segment::CreateInstance(mReader, pos, mSegment) || !mSegment)
+		return false;
+
+	// 거꾸로 디코딩하려면 모든 클러스터의 위치를 알아야 한다
+	if (mSegment->Load() < 0)
+		return false;
+
+	bool hasAlpha = false;
+	for (const mkvparser::Cluster *cluster = mSegment->GetFirst(); cluster && !cluster->EOS(); cluster = mSegment->GetNext(cluster))
+	{
+		const mkvparser::BlockEntry *entry = nullptr;
+		if (cluster->GetFirst(entry))
+			return false;
+
+		while (entry && !entry->EOS())
+		{
+			const mkvparser::Block *block = entry->GetBlock();
+			if (block->GetTrackNumber() == mVideoTrack)
+			{
+				for (int i = 0; i < block->GetFrameCount(); ++i)
+					mFrames.push_back({ entry, i, static_cast<uint64_t>(block->GetTime(cluster)), block->IsKey() });
+				hasAlpha = hasAlpha || block->GetFrameAdditionCount() > 0;
+			}
+			if (cluster->GetNext(entry, entry))
+				return false;
+		}
+	}
+
+	// 구간 크기를 정하는 I420 프레임 하나의 크기. 알파가 있으면 휘도 평면 하나가 더 붙는다
+	const size_t sizeY = static_cast<size_t>(mWidth) * mHeight;
+	const size_t sizeUV = static_cast<size_t>((mWidth + 1) / 2) * ((mHeight + 1) / 2);
+	mFrameBytes = std::max<size_t>(sizeY + sizeUV * 2 + ((hasAlpha) ? sizeY : 0), 1);
+	return !mFrames.empty();
+}
+
+bool ReverseDecoder::_DecodeChunk(Chunk *chunk, int64_t key, int64_t first, int64_t last, uint32_t generation)
+{
+	chunk->frames.resize(static_cast<size_t>(last - first + 1));
+
+	// 앞 구간을 디코딩하면서 남긴 체크포인트가 이 구간의 뒤쪽을 덮으면 그 앞까지만 디코딩한다
+	int64_t decodeLast = last;
+	if (!mCheckpoints.empty() && mCheckpointKey == key &&
+		mCheckpoints.front().frame_index <= last && mCheckpoints.back().frame_index >= last)
+	{
+		decodeLast = mCheckpoints.front().frame_index - 1;
+	}
+	for (int64_t i = std::max(first, decodeLast + 1); i <= last; ++i)
+	{
+		if (!_RestoreCheckpoint(i, chunk->frames[static_cast<size_t>(i - first)]))
+			return false;
+	}
+
+	// 이 구간에 들어간 체크포인트는 더 쓰지 않는다. 다시 디코딩하면 체크포인트도 처음부터 다시 남긴다
+	_DropCheckpoints(key, (decodeLast < first) ? first : key);
+	if (decodeLast < first)
+		return true;
+
+	const int64_t checkpointFirst = first - static_cast<int64_t>(mCheckpointBudget / std::max<size_t>(mFrameBytes / CHECKPOINT_MAX_RATIO, 1));
+	Frame checkpoint;
+	for (int64_t i = key; i <= decodeLast; ++i)
+	{
+		// 재생 방향이나 위치가 바뀌었으면 그만둔다
+		if (generation != mGeneration)
+			return false;
+
+		const FrameRef &ref = mFrames[i];
+		const mkvparser::Block *block = ref.block_entry->GetBlock();
+		const mkvparser::Block::Frame &frame = block->GetFrame(ref.block_frame_index);
+		if (frame.len > static_cast<long>(mBuffer.size()))
+			mBuffer.resize(frame.len * 2);
+		if (frame.Read(mReader, &mBuffer[0]) ||
+			vpx_codec_decode(&mDecoder, &mBuffer[0], frame.len, nullptr, 0))
+		{
+			return false;
+		}
+
+		vpx_codec_iter_t iter = nullptr;
+		vpx_image_t *img = vpx_codec_get_frame(&mDecoder, &iter);
+		vpx_image_t *imgAlpha = nullptr;
+		if (block->GetFrameAdditionCount() > 0)
+		{
+			const mkvparser::Block::Frame &frameAddition = block->GetFrameAddition(0);
+			if (frameAddition.len > static_cast<long>(mBufferAlpha.size()))
+				mBufferAlpha.resize(frameAddition.len * 2);
+			if (frameAddition.Read(mReader, &mBufferAlpha[0]) ||
+				vpx_codec_decode(&mDecoderAlpha, &mBufferAlpha[0], frameAddition.len, nullptr, 0))
+			{
+				return false;
+			}
+
+			vpx_codec_iter_t iterAlpha = nullptr;
+			imgAlpha = vpx_codec_get_frame(&mDecoderAlpha, &iterAlpha);
+		}
+
+		if (i < first)
+		{
+			// 다음 구간들이 될 프레임은 키 프레임부터 다시 디코딩하지 않도록 남겨둔다
+			if (i >= checkpointFirst)
+			{
+				checkpoint.frame_index = i;
+				checkpoint.timestamp_ns = ref.timestamp_ns;
+				copy_image(img, imgAlpha, checkpoint);
+				_AddCheckpoint(checkpoint);
+			}
+			continue;
+		}
+
+		// 화면에 나가지 않는 프레임은 크기를 0으로 남겨서 건너뛰게 한다
+		Frame &out = chunk->frames[static_cast<size_t>(i - first)];
+		out.frame_index = i;
+		out.timestamp_ns = ref.timestamp_ns;
+		copy_image(img, imgAlpha, out);
+	}
+	return true;
+}
+
+void ReverseDecoder::_AddCheckpoint(const Frame &frame)
+{
+	Checkpoint checkpoint;
+	checkpoint.frame_index = frame.frame_index;
+	checkpoint.timestamp_ns = frame.timestamp_ns;
+	checkpoint.width = frame.width;
+	checkpoint.height = frame.height;
+	checkpoint.has_alpha = frame.has_alpha;
+	checkpoint.planes_size = static_cast<int>(frame.planes.size());
+	if (!frame.planes.empty())
+	{
+		mCompressBuffer.resize(static_cast<size_t>(lz4_compress_bound(checkpoint.planes_size)));
+		const int compressed = lz4_compress(&frame.planes[0], checkpoint.planes_size,
+			&mCompressBuffer[0], static_cast<int>(mCompressBuffer.size()));
+		if (compressed > 0 && compressed < checkpoint.planes_size)
+			checkpoint.data.assign(mCompressBuffer.begin(), mCompressBuffer.begin() + compressed);
+		else
+			checkpoint.data = frame.planes;
+	}
+
+	mCheckpointBytes += checkpoint.data.size();
+	mCheckpoints.push_back(std::move(checkpoint));
+
+	// 프레임 번호 순서로 붙으므로 앞쪽을 버리면 다음 구간에 가까운 프레임이 남는다
+	while (mCheckpointBytes > mCheckpointBudget && !mCheckpoints.empty())
+	{
+		mCheckpointBytes -= mCheckpoints.front().data.size();
+		mCheckpoints.pop_front();
+	}
+}
+
+bool ReverseDecoder::_RestoreCheckpoint(int64_t frameIndex, Frame &frame)
+{
+	if (mCheckpoints.empty() || frameIndex < mCheckpoints.front().frame_index || frameIndex > mCheckpoints.back().frame_index)
+		return false;
+
+	const Checkpoint &checkpoint = mCheckpoints[static_cast<size_t>(frameIndex - mCheckpoints.front().frame_index)];
+	frame.frame_index = checkpoint.frame_index;
+	frame.timestamp_ns = checkpoint.timestamp_ns;
+	frame.width = checkpoint.width;
+	frame.height = checkpoint.height;
+	frame.has_alpha = checkpoint.has_alpha;
+	frame.planes.resize(static_cast<size_t>(checkpoint.planes_size));
+	if (checkpoint.data.empty())
+		return true;
+	if (checkpoint.data.size() == frame.planes.size())
+	{
+		memcpy(&frame.planes[0], &checkpoint.data[0], checkpoint.data.size());
+		return true;
+	}
+	return lz4_decompress(&checkpoint.data[0], static_cast<int>(checkpoint.data.size()),
+		&frame.planes[0], checkpoint.planes_size) == checkpoint.planes_size;
+}
+
+void ReverseDecoder::_DropCheckpoints(int64_t key, int64_t first)
+{
+	// 다른 GOP의 체크포인트는 모두 버리고, 같은 GOP에서는 first 이후를 버린다
+	if (mCheckpointKey != key)
+		first = LLONG_MIN;
+	mCheckpointKey = key;
+
+	while (!mCheckpoints.empty() && mCheckpoints.back().frame_index >= first)
+	{
+		mCheckpointBytes -= mCheckpoints.back().data.size();
+		mCheckpoints.pop_back();
+	}
+}
+
+void ReverseDecoder::_WorkerMain()
+{
+	const bool indexed = _BuildIndex();
+
+	std::unique_lock<std::mutex> lock(mLock);
+	mIndexed = true;
+	mFailed = !indexed;
+	mReadyCV.notify_all();
+
+	while (!mQuit)
+	{
+		if (mStarted && mNextLast == UNRESOLVED_FRAME && !mFailed)
+		{
+			const int64_t count = static_cast<int64_t>(mFrames.size());
+			mNextLast = (mFrom < 0) ? count + mFrom : std::min(mFrom, count - 1);
+			mReadyCV.notify_all();
+		}
+
+		if (mFailed || !mStarted || mReady || mNextLast < mTo)
+		{
+			mWorkCV.wait(lock);
+			continue;
+		}
+
+		// 다음 구간은 mNextLast에서 끝나고, 예산이 허락하는 만큼 같은 GOP 안에서 앞으로 넓힌다
+		const int64_t last = mNextLast;
+		int64_t key = last;
+		while (key > 0 && !mFrames[key].is_key)
+			--key;
+		const int64_t capacity = std::max<int64_t>(mMemoryBudget / (mFrameBytes * 2), 1);
+		const int64_t first = std::max(std::max(key, last - capacity + 1), mTo);
+		const uint32_t generation = mGeneration;
+		mCheckpointBudget = mMemoryBudget / 2;
+		if (last - key + 1 > capacity && key != mReportedKey)
+		{
+			// 예산이 GOP보다 작으면 체크포인트에서 풀거나 키 프레임부터 다시 디코딩해야 해서 정배속을 못 낼 수 있다
+			OutputDebugTrace("%s - GOP at frame %lld has %lld frames but a chunk holds %lld within %zu bytes.\n", __FUNCTION__,
+				static_cast<long long>(key), static_cast<long long>(last - key + 1), static_cast<long long>(capacity), mMemoryBudget);
+			mReportedKey = key;
+		}
+
+		std::unique_ptr<Chunk> chunk = (mSpare) ? std::move(mSpare) : std::unique_ptr<Chunk>(new Chunk());
+		mBusy = true;
+		lock.unlock();
+
+		const bool ok = _DecodeChunk(chunk.get(), key, first, last, generation);
+
+		lock.lock();
+		mBusy = false;
+		if (generation != mGeneration)
+		{
+			mSpare = std::move(chunk);
+		}
+		else if (!ok)
+		{
+			mFailed = true;
+		}
+		else
+		{
+			mReady = std::move(chunk);
+			mNextLast = first - 1;
+		}
+		mReadyCV.notify_all();
+	}
+}
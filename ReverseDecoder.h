@@ -0,0 +1,136 @@
+#pragma once
+
+#include <mkvparser.h>
+#include <mkvreader.h>
+#include <vpx_decoder.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "YUVtoRGB.h"
+
+// 역재생용 디코더. 키 프레임부터 GOP를 앞으로 디코딩해서 I420 프레임을 구간 단위로 모아두고 뒤에서부터 꺼내준다.
+// RGBA 변환은 꺼낸 프레임을 보여줄 때만 하므로 같은 예산에 RGBA보다 2.7배 많은 프레임이 들어간다.
+// 전용 스레드가 자기 파일 핸들과 libvpx 컨텍스트로 다음에 보여줄 (앞쪽) 구간을 미리 디코딩한다.
+// GOP가 구간보다 길면 구간 앞쪽의 프레임을 LZ4로 압축한 체크포인트로 남겨서, 다음 구간을 키 프레임부터 다시 디코딩하지 않고 풀어서 쓴다.
+class ReverseDecoder
+{
+public:
+	using ConvertFunc_t = void(*)(uint32_t, uint32_t,
+		const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*,
+		uint32_t, uint32_t, uint32_t, uint32_t,
+		uint8_t*, uint32_t, YCbCrType, AlphaCoverage*);
+
+	struct Frame
+	{
+		int64_t frame_index;
+		uint64_t timestamp_ns;
+		uint32_t width;		// 화면에 나가지 않는 프레임은 0
+		uint32_t height;
+		std::vector<uint8_t> planes;	// Y, U, V 순서로 빈틈 없이 담는다. 알파가 있으면 뒤에 알파 Y가 붙는다
+		bool has_alpha;
+	};
+
+public:
+	ReverseDecoder();
+	~ReverseDecoder();
+
+public:
+	bool Open(const std::string &fileName, vpx_codec_iface_t *iface, int videoTrack,
+		uint32_t width, uint32_t height, ConvertFunc_t convert);
+	bool IsOpen();
+	// 구간 두 개가 쓰는 메모리 상한. 긴 GOP의 체크포인트가 압축된 크기로 그 절반까지 더 쓴다
+	void SetMemoryBudget(size_t bytes);
+	// from부터 to까지 거꾸로 내보낸다. 음수 from은 끝에서부터 센다(-1이 마지막 프레임)
+	void Start(int64_t from, int64_t to);
+	// 구간이 아직 준비되지 않았으면 기다린다. to에 닿으면 nullptr
+	const Frame *Next();
+	// 기다리지 않고 꺼낼 수 있는 다음 프레임
+	const Frame *Peek();
+	// Next로 꺼낸 프레임을 RGBA로 변환한다. frame은 다음 Next까지 유효하다
+	void Convert(const Frame *frame, uint8_t *RGBA, uint32_t stride);
+	// 앞으로 재생을 이어갈 위치를 찾기 위해 frameIndex 이하의 가장 가까운 키 프레임을 찾는다
+	bool FindKeyFrame(int64_t frameIndex, int64_t &keyIndex, uint64_t &keyTimestamp);
+
+private:
+	struct FrameRef
+	{
+		const mkvparser::BlockEntry *block_entry;
+		int block_frame_index;
+		uint64_t timestamp_ns;
+		bool is_key;
+	};
+
+	struct Chunk
+	{
+		std::vector<Frame> frames;
+	};
+
+	// GOP 안에서 다음 구간이 될 프레임. 워커만 쓴다
+	struct Checkpoint
+	{
+		int64_t frame_index;
+		uint64_t timestamp_ns;
+		uint32_t width;
+		uint32_t height;
+		bool has_alpha;
+		int planes_size;
+		std::vector<uint8_t> data;	// planes를 LZ4로 압축한 것. 줄지 않으면 그대로 담는다
+	};
+
+	bool _WaitIndex(std::unique_lock<std::mutex> &lock);
+	bool _BuildIndex();
+	bool _DecodeChunk(Chunk *chunk, int64_t key, int64_t first, int64_t last, uint32_t generation);
+	void _AddCheckpoint(const Frame &frame);
+	bool _RestoreCheckpoint(int64_t frameIndex, Frame &frame);
+	void _DropCheckpoints(int64_t key, int64_t first);
+	void _WorkerMain();
+
+private:
+	FILE *mFile;
+	mkvparser::MkvReader *mReader;
+	mkvparser::Segment *mSegment;
+	vpx_codec_ctx_t mDecoder;
+	vpx_codec_ctx_t mDecoderAlpha;
+	std::vector<uint8_t> mBuffer;
+	std::vector<uint8_t> mBufferAlpha;
+	std::vector<FrameRef> mFrames;
+	// 프레임 번호 순서로 이어진 범위만 담는다. 앞에서 지우고 뒤에 붙인다
+	std::deque<Checkpoint> mCheckpoints;
+	std::vector<uint8_t> mCompressBuffer;
+	size_t mCheckpointBytes;
+	size_t mCheckpointBudget;	// 워커가 구간을 시작할 때 mMemoryBudget에서 정한다
+	int64_t mCheckpointKey;
+	int64_t mReportedKey;
+	int mVideoTrack;
+	uint32_t mWidth;
+	uint32_t mHeight;
+	size_t mFrameBytes;
+	size_t mMemoryBudget;
+	ConvertFunc_t mConvert;
+
+	std::mutex mLock;
+	std::condition_variable mWorkCV;
+	std::condition_variable mReadyCV;
+	std::thread mThread;
+	std::unique_ptr<Chunk> mCurrent;
+	std::unique_ptr<Chunk> mReady;
+	std::unique_ptr<Chunk> mSpare;
+	size_t mCursor;
+	int64_t mFrom;
+	int64_t mTo;
+	int64_t mNextLast;
+	std::atomic<uint32_t> mGeneration;
+	bool mStarted;
+	bool mConsumed;
+	bool mIndexed;
+	bool mFailed;
+	bool mBusy;
+	bool mQuit;
+};
@@ -0,0 +1,375 @@
+#include "TextureCompress.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// 경계 상자를 안쪽으로 (max - min) >> INSET_SHIFT만큼 줄인다. 끝점이 가장 바깥 픽셀에 붙으면 가운데 단계가 덜 쓰인다
+#define BC3_INSET_SHIFT 4
+#define BC7_INSET_SHIFT 5
+// 스레드 풀 작업 하나가 맡는 블록 줄 수. 1080p면 34개로 나뉜다
+#define TILE_BLOCK_ROWS 8
+
+// 첫 번째 끝점에서 두 번째 끝점 쪽으로 t번째 단계 -> 블록에 쓰는 인덱스
+static const uint8_t BC3_COLOR_INDEX[4] = { 0, 2, 3, 1 };
+static const uint8_t BC3_ALPHA_INDEX[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+size_t texture_compressed_size(TextureFormat format, uint32_t width, uint32_t height)
+{
+	if (format == TEXTURE_RGBA)
+		return static_cast<size_t>(width) * height * 4;
+
+	const size_t blocksWide = (width + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+	const size_t blocksHigh = (height + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+	return blocksWide * blocksHigh * TEXTURE_BLOCK_BYTES;
+}
+
+// 4x4 픽셀을 한 줄에 16바이트씩 읽는다. 가장자리 블록은 마지막 줄과 열을 반복해서 채운다
+static inline void load_block(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride,
+	uint32_t bx, uint32_t by, __m128i rows[4])
+{
+	const uint32_t x0 = bx * TEXTURE_BLOCK_SIZE;
+	const uint32_t y0 = by * TEXTURE_BLOCK_SIZE;
+	if (x0 + TEXTURE_BLOCK_SIZE <= width && y0 + TEXTURE_BLOCK_SIZE <= height)
+	{
+		for (uint32_t i = 0; i < TEXTURE_BLOCK_SIZE; ++i)
+			rows[i] = _mm_loadu_si128((const __m128i*)(RGBA + (y0 + i) * RGBA_stride + x0 * 4));
+		return;
+	}
+
+	uint8_t pixels[TEXTURE_BLOCK_SIZE * TEXTURE_BLOCK_SIZE * 4];
+	for (uint32_t i = 0; i < TEXTURE_BLOCK_SIZE; ++i)
+	{
+		const uint32_t y = std::min(y0 + i, height - 1);
+		for (uint32_t j = 0; j < TEXTURE_BLOCK_SIZE; ++j)
+		{
+			const uint32_t x = std::min(x0 + j, width - 1);
+			memcpy(pixels + (i * TEXTURE_BLOCK_SIZE + j) * 4, RGBA + y * RGBA_stride + x * 4, 4);
+		}
+	}
+	for (uint32_t i = 0; i < TEXTURE_BLOCK_SIZE; ++i)
+		rows[i] = _mm_loadu_si128((const __m128i*)(pixels + i * 16));
+}
+
+static inline void block_bounds(const __m128i rows[4], uint8_t minColor[4], uint8_t maxColor[4])
+{
+	__m128i low = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+	__m128i high = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+	low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(3, 2, 3, 2)));
+	low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 1, 1, 1)));
+	high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 2, 3, 2)));
+	high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 1, 1, 1)));
+
+	const uint32_t lowValue = static_cast<uint32_t>(_mm_cvtsi128_si32(low));
+	const uint32_t highValue = static_cast<uint32_t>(_mm_cvtsi128_si32(high));
+	memcpy(minColor, &lowValue, 4);
+	memcpy(maxColor, &highValue, 4);
+}
+
+template<int Channel>
+static inline __m128i broadcast_channel(__m128i pixels)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(Channel, Channel, Channel, Channel)), _MM_SHUFFLE(Channel, Channel, Channel, Channel));
+}
+
+// 범위가 가장 큰 채널을 기준으로, 기준 채널과 반대로 움직이는 채널은 끝점을 뒤집는다.
+// 경계 상자의 대각선 4개 중에서 픽셀 분포에 가장 가까운 것을 고르는 셈이다
+static void select_diagonal(const __m128i rows[4], const uint8_t minColor[4], const uint8_t maxColor[4],
+	uint32_t channels, int16_t e0[4], int16_t e1[4])
+{
+	uint32_t mainChannel = 0;
+	for (uint32_t c = 0; c < channels; ++c)
+	{
+		e0[c] = minColor[c];
+		e1[c] = maxColor[c];
+		if (maxColor[c] - minColor[c] > maxColor[mainChannel] - minColor[mainChannel])
+			mainChannel = c;
+	}
+
+	// 상자 중심에서의 거리를 4로 나눠서 곱이 16비트에 들어가게 하고 포화 덧셈으로 모은다. 부호만 쓴다
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i center = _mm_setr_epi16(
+		minColor[0] + maxColor[0], minColor[1] + maxColor[1], minColor[2] + maxColor[2], minColor[3] + maxColor[3],
+		minColor[0] + maxColor[0], minColor[1] + maxColor[1], minColor[2] + maxColor[2], minColor[3] + maxColor[3]);
+	__m128i covariance = zero;
+	for (int i = 0; i < TEXTURE_BLOCK_SIZE * 2; ++i)
+	{
+		const __m128i pixels = (i & 1) ? _mm_unpackhi_epi8(rows[i / 2], zero) : _mm_unpacklo_epi8(rows[i / 2], zero);
+		const __m128i offset = _mm_srai_epi16(_mm_sub_epi16(_mm_slli_epi16(pixels, 1), center), 2);
+		__m128i mainOffset;
+		switch (mainChannel)
+		{
+		case 0: mainOffset = broadcast_channel<0>(offset); break;
+		case 1: mainOffset = broadcast_channel<1>(offset); break;
+		case 2: mainOffset = broadcast_channel<2>(offset); break;
+		default: mainOffset = broadcast_channel<3>(offset); break;
+		}
+		covariance = _mm_adds_epi16(covariance, _mm_mullo_epi16(offset, mainOffset));
+	}
+	covariance = _mm_adds_epi16(covariance, _mm_srli_si128(covariance, 8));
+
+	int16_t sums[8];
+	_mm_storeu_si128((__m128i*)sums, covariance);
+	for (uint32_t c = 0; c < channels; ++c)
+	{
+		if (sums[c] < 0)
+			std::swap(e0[c], e1[c]);
+	}
+}
+
+static inline void inset_endpoints(int16_t e0[4], int16_t e1[4], uint32_t channels, int shift)
+{
+	for (uint32_t c = 0; c < channels; ++c)
+	{
+		const int16_t inset = static_cast<int16_t>((e1[c] - e0[c]) / (1 << shift));
+		e0[c] += inset;
+		e1[c] -= inset;
+	}
+}
+
+// 픽셀을 e0 -> e1 직선에 투영해서 0 ~ levels - 1 단계로 반올림한다. e0와 e1이 같은 채널은 무시된다
+static void project_indices(const __m128i rows[4], const int16_t e0[4], const int16_t e1[4], int levels, uint8_t indices[16])
+{
+	const int32_t d[4] = { e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2], e1[3] - e0[3] };
+	const int32_t length = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + d[3] * d[3];
+	if (length == 0)
+	{
+		memset(indices, 0, 16);
+		return;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i base = _mm_setr_epi16(e0[0], e0[1], e0[2], e0[3], e0[0], e0[1], e0[2], e0[3]);
+	const __m128i axis = _mm_setr_epi16(
+		static_cast<int16_t>(d[0]), static_cast<int16_t>(d[1]), static_cast<int16_t>(d[2]), static_cast<int16_t>(d[3]),
+		static_cast<int16_t>(d[0]), static_cast<int16_t>(d[1]), static_cast<int16_t>(d[2]), static_cast<int16_t>(d[3]));
+	const __m128 scale = _mm_set1_ps(static_cast<float>(levels - 1) / length);
+
+	__m128i steps[4];
+	for (int i = 0; i < TEXTURE_BLOCK_SIZE; ++i)
+	{
+		// 픽셀 두 개씩 (p - e0)·d를 구한다. madd 결과는 픽셀마다 (rg, ba) 두 칸이라 짝수/홀수 칸을 더한다
+		const __m128i low = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(rows[i], zero), base), axis);
+		const __m128i high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(rows[i], zero), base), axis);
+		const __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(3, 1, 3, 1));
+		const __m128i dot = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+		steps[i] = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(dot), scale));
+	}
+
+	const __m128i maxStep = _mm_set1_epi16(static_cast<int16_t>(levels - 1));
+	const __m128i top = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(steps[0], steps[1]), zero), maxStep);
+	const __m128i bottom = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(steps[2], steps[3]), zero), maxStep);
+	_mm_storeu_si128((__m128i*)indices, _mm_packus_epi16(top, bottom));
+}
+
+static inline uint16_t pack_565(const int16_t color[4])
+{
+	return static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static inline void unpack_565(uint16_t packed, int16_t color[4])
+{
+	const int16_t r = (packed >> 11) & 31;
+	const int16_t g = (packed >> 5) & 63;
+	const int16_t b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 0;
+}
+
+static void encode_bc3_block(const __m128i rows[4], uint8_t* block)
+{
+	uint8_t minColor[4], maxColor[4];
+	block_bounds(rows, minColor, maxColor);
+
+	// 알파: a0 > a1이면 8단계. 0과 255가 정확히 남도록 알파는 줄이지 않는다
+	const uint8_t alpha0 = maxColor[3];
+	const uint8_t alpha1 = minColor[3];
+	uint8_t alphaSteps[16];
+	const int16_t alphaStart[4] = { 0, 0, 0, alpha0 };
+	const int16_t alphaEnd[4] = { 0, 0, 0, alpha1 };
+	project_indices(rows, alphaStart, alphaEnd, 8, alphaSteps);
+
+	uint64_t alphaBits = 0;
+	for (int i = 0; i < 16; ++i)
+		alphaBits |= static_cast<uint64_t>(BC3_ALPHA_INDEX[alphaSteps[i]]) << (3 * i);
+	block[0] = alpha0;
+	block[1] = alpha1;
+	memcpy(block + 2, &alphaBits, 6);
+
+	// 색상: BC3의 색상 블록은 항상 4단계로 읽히지만 c0 > c1로 맞춰서 BC1 순서도 지킨다
+	int16_t e0[4], e1[4];
+	select_diagonal(rows, minColor, maxColor, 3, e0, e1);
+	inset_endpoints(e0, e1, 3, BC3_INSET_SHIFT);
+	e0[3] = e1[3] = 0;
+
+	uint16_t color0 = pack_565(e0);
+	uint16_t color1 = pack_565(e1);
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint32_t colorBits = 0;
+	if (color0 != color1)
+	{
+		// 565로 줄인 뒤의 끝점에 투영해야 디코더가 만드는 색과 맞는다
+		int16_t first[4], second[4];
+		unpack_565(color0, first);
+		unpack_565(color1, second);
+		uint8_t colorSteps[16];
+		project_indices(rows, first, second, 4, colorSteps);
+		for (int i = 0; i < 16; ++i)
+			colorBits |= static_cast<uint32_t>(BC3_COLOR_INDEX[colorSteps[i]]) << (2 * i);
+	}
+
+	memcpy(block + 8, &color0, 2);
+	memcpy(block + 10, &color1, 2);
+	memcpy(block + 12, &colorBits, 4);
+}
+
+struct bc7_writer
+{
+	uint64_t bits[2];
+	uint32_t position;
+};
+
+static inline void write_bits(bc7_writer &writer, uint32_t value, uint32_t count)
+{
+	const uint32_t word = writer.position / 64;
+	const uint32_t shift = writer.position % 64;
+	writer.bits[word] |= static_cast<uint64_t>(value) << shift;
+	if (shift + count > 64)
+		writer.bits[1] |= static_cast<uint64_t>(value) >> (64 - shift);
+	writer.position += count;
+}
+
+// 모드 6 끝점은 채널마다 7비트와 네 채널이 같이 쓰는 p비트 하나로 8비트가 된다.
+// 오차가 작은 p비트를 고르되, 불투명과 완전 투명은 그대로 남도록 알파 255와 0은 p비트를 정해 둔다
+static uint32_t quantize_bc7_endpoint(const int16_t color[4], uint8_t quantized[4])
+{
+	uint32_t bestBit = 0;
+	int32_t bestError = INT32_MAX;
+	for (uint32_t bit = 0; bit < 2; ++bit)
+	{
+		if ((color[3] == 255 && bit == 0) || (color[3] == 0 && bit == 1))
+			continue;
+
+		int32_t error = 0;
+		for (int c = 0; c < 4; ++c)
+		{
+			const int32_t value = std::min(127, std::max(0, (color[c] - static_cast<int32_t>(bit) + 1) >> 1));
+			error += std::abs(((value << 1) | static_cast<int32_t>(bit)) - color[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			bestBit = bit;
+		}
+	}
+
+	for (int c = 0; c < 4; ++c)
+		quantized[c] = static_cast<uint8_t>(std::min(127, std::max(0, (color[c] - static_cast<int32_t>(bestBit) + 1) >> 1)));
+	return bestBit;
+}
+
+static void encode_bc7_block(const __m128i rows[4], uint8_t* block)
+{
+	uint8_t minColor[4], maxColor[4];
+	block_bounds(rows, minColor, maxColor);
+
+	int16_t e0[4], e1[4];
+	select_diagonal(rows, minColor, maxColor, 4, e0, e1);
+	// 알파는 줄이지 않는다
+	inset_endpoints(e0, e1, 3, BC7_INSET_SHIFT);
+
+	uint8_t q0[4], q1[4];
+	uint32_t p0 = quantize_bc7_endpoint(e0, q0);
+	uint32_t p1 = quantize_bc7_endpoint(e1, q1);
+
+	int16_t first[4], second[4];
+	for (int c = 0; c < 4; ++c)
+	{
+		first[c] = static_cast<int16_t>((q0[c] << 1) | p0);
+		second[c] = static_cast<int16_t>((q1[c] << 1) | p1);
+	}
+	uint8_t steps[16];
+	project_indices(rows, first, second, 16, steps);
+
+	// 첫 픽셀 인덱스의 최상위 비트는 0으로 정해져 있어서 3비트만 쓴다. 넘으면 끝점을 바꾸고 인덱스를 뒤집는다
+	if (steps[0] >= 8)
+	{
+		std::swap(q0, q1);
+		std::swap(p0, p1);
+		for (int i = 0; i < 16; ++i)
+			steps[i] = 15 - steps[i];
+	}
+
+	bc7_writer writer = { { 0, 0 }, 0 };
+	write_bits(writer, 1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		write_bits(writer, q0[c], 7);
+		write_bits(writer, q1[c], 7);
+	}
+	write_bits(writer, p0, 1);
+	write_bits(writer, p1, 1);
+	write_bits(writer, steps[0], 3);
+	for (int i = 1; i < 16; ++i)
+		write_bits(writer, steps[i], 4);
+
+	memcpy(block, writer.bits, TEXTURE_BLOCK_BYTES);
+}
+
+template<void(*EncodeBlock)(const __m128i*, uint8_t*)>
+static void rgba_to_blocks(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks, uint32_t block_row_begin, uint32_t block_row_end)
+{
+	const uint32_t blocksWide = (width + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+	__m128i rows[TEXTURE_BLOCK_SIZE];
+	for (uint32_t by = block_row_begin; by < block_row_end; ++by)
+	{
+		uint8_t* block = blocks + static_cast<size_t>(by) * blocksWide * TEXTURE_BLOCK_BYTES;
+		for (uint32_t bx = 0; bx < blocksWide; ++bx, block += TEXTURE_BLOCK_BYTES)
+		{
+			load_block(width, height, RGBA, RGBA_stride, bx, by, rows);
+			EncodeBlock(rows, block);
+		}
+	}
+}
+
+void rgba_to_bc3_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks, uint32_t block_row_begin, uint32_t block_row_end)
+{
+	rgba_to_blocks<encode_bc3_block>(width, height, RGBA, RGBA_stride, blocks, block_row_begin, block_row_end);
+}
+
+void rgba_to_bc7_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks, uint32_t block_row_begin, uint32_t block_row_end)
+{
+	rgba_to_blocks<encode_bc7_block>(width, height, RGBA, RGBA_stride, blocks, block_row_begin, block_row_end);
+}
+
+bool compress_texture(ThreadPool* pool, TextureFormat format, uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks)
+{
+	if (format == TEXTURE_RGBA || width == 0 || height == 0)
+		return false;
+
+	auto encode = (format == TEXTURE_BC3) ? rgba_to_bc3_sse : rgba_to_bc7_sse;
+	const uint32_t blockRows = (height + TEXTURE_BLOCK_SIZE - 1) / TEXTURE_BLOCK_SIZE;
+	if (!pool)
+	{
+		encode(width, height, RGBA, RGBA_stride, blocks, 0, blockRows);
+		return true;
+	}
+
+	// 타일마다 쓰는 블록 줄이 겹치지 않아서 동기화 없이 나눠 쓴다
+	std::vector<ThreadPool::Task> tasks;
+	for (uint32_t row = 0; row < blockRows; row += TILE_BLOCK_ROWS)
+	{
+		const uint32_t rowEnd = std::min(row + TILE_BLOCK_ROWS, blockRows);
+		tasks.push_back([=]() { encode(width, height, RGBA, RGBA_stride, blocks, row, rowEnd); });
+	}
+	pool->Submit(tasks);
+	pool->Wait();
+	return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+enum TextureFormat
+{
+	TEXTURE_RGBA,
+	TEXTURE_BC3,	// DXT5. 색상 565 끝점 + 알파 8단계
+	TEXTURE_BC7	// 모드 6만 쓰는 빠른 BC7. RGBA 7777 + p비트 끝점, 16단계
+};
+
+#define TEXTURE_BLOCK_SIZE 4
+#define TEXTURE_BLOCK_BYTES 16
+
+// 압축한 텍스처의 바이트 수. 4의 배수가 아닌 크기는 가장자리 블록을 채워서 센다. RGBA면 width * height * 4
+size_t texture_compressed_size(TextureFormat format, uint32_t width, uint32_t height);
+
+// 블록 줄 [block_row_begin, block_row_end)만 압축한다. blocks는 전체 텍스처의 시작이고 블록은 줄 순서로 쓴다.
+// 블록의 끝점은 SSE2로 구한 경계 상자에서 잡고, 인덱스는 끝점 사이 직선에 투영해서 고른다
+void rgba_to_bc3_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks, uint32_t block_row_begin, uint32_t block_row_end);
+void rgba_to_bc7_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks, uint32_t block_row_begin, uint32_t block_row_end);
+
+// 블록 줄을 타일로 나눠서 pool에서 나눠 압축하고 끝날 때까지 기다린다. pool이 nullptr이면 호출한 스레드에서 전부 압축한다
+bool compress_texture(ThreadPool* pool, TextureFormat format, uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* blocks);
@@ -0,0 +1,149 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount /*= 0*/) : mQueued(0), mPending(0), mNextQueue(0), mQuit(false)
+{
+	if (threadCount == 0)
+	{
+		const uint32_t cores = std::thread::hardware_concurrency();
+		threadCount = (cores > 1) ? cores - 1 : 1;
+	}
+
+	// 마지막 큐는 Wait()를 호출한 스레드용
+	for (uint32_t i = 0; i <= threadCount; ++i)
+		mQueues.push_back(std::make_unique<WorkQueue>());
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+		mThreads.emplace_back(&ThreadPool::_WorkerMain, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> guard(mWakeLock);
+		mQuit = true;
+	}
+	mWakeCV.notify_all();
+	for (std::thread &thread : mThreads)
+		thread.join();
+}
+
+void ThreadPool::Submit(Task task)
+{
+	const uint32_t index = mNextQueue++ % static_cast<uint32_t>(mQueues.size());
+	mPending++;
+	{
+		// 꺼내는 쪽이 먼저 감소시키지 않도록 넣기 전에 증가시킨다
+		std::lock_guard<std::mutex> guard(mWakeLock);
+		mQueued++;
+	}
+	{
+		std::lock_guard<std::mutex> guard(mQueues[index]->lock);
+		mQueues[index]->tasks.push_back(std::move(task));
+	}
+	mWakeCV.notify_one();
+}
+
+void ThreadPool::Submit(std::vector<Task> &tasks)
+{
+	if (tasks.empty())
+		return;
+
+	const uint32_t queueCount = static_cast<uint32_t>(mQueues.size());
+	const uint32_t count = static_cast<uint32_t>(tasks.size());
+	mPending += count;
+	{
+		std::lock_guard<std::mutex> guard(mWakeLock);
+		mQueued += count;
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t index = mNextQueue++ % queueCount;
+		std::lock_guard<std::mutex> guard(mQueues[index]->lock);
+		mQueues[index]->tasks.push_back(std::move(tasks[i]));
+	}
+	tasks.clear();
+	mWakeCV.notify_all();
+}
+
+void ThreadPool::Wait()
+{
+	const uint32_t callerIndex = static_cast<uint32_t>(mQueues.size()) - 1;
+	while (mPending > 0)
+	{
+		Task task;
+		if (_PopTask(callerIndex, task) || _StealTask(callerIndex, task))
+		{
+			_RunTask(task);
+			continue;
+		}
+
+		// 남은 작업이 모두 다른 워커에서 실행 중
+		std::unique_lock<std::mutex> lock(mWakeLock);
+		mDoneCV.wait(lock, [this]() { return mPending == 0 || mQueued > 0; });
+	}
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+	return static_cast<uint32_t>(mThreads.size());
+}
+
+bool ThreadPool::_PopTask(uint32_t index, Task &task)
+{
+	WorkQueue &queue = *mQueues[index];
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.tasks.empty())
+		return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	mQueued--;
+	return true;
+}
+
+bool ThreadPool::_StealTask(uint32_t index, Task &task)
+{
+	const uint32_t queueCount = static_cast<uint32_t>(mQueues.size());
+	for (uint32_t i = 1; i < queueCount; ++i)
+	{
+		WorkQueue &queue = *mQueues[(index + i) % queueCount];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		mQueued--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::_RunTask(Task &task)
+{
+	task();
+	if (--mPending == 0)
+	{
+		std::lock_guard<std::mutex> guard(mWakeLock);
+		mDoneCV.notify_all();
+	}
+}
+
+void ThreadPool::_WorkerMain(uint32_t index)
+{
+	while (true)
+	{
+		Task task;
+		if (_PopTask(index, task) || _StealTask(index, task))
+		{
+			_RunTask(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeLock);
+		mWakeCV.wait(lock, [this]() { return mQuit || mQueued > 0; });
+		if (mQuit && mQueued == 0)
+			return;
+	}
+}
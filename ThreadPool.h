@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 워커마다 큐를 가지고, 자기 큐가 비면 다른 워커의 큐에서 작업을 훔쳐오는 스레드 풀
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	// threadCount가 0이면 (코어 수 - 1)개의 워커를 만든다. Wait()를 호출한 스레드도 작업을 처리한다.
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+public:
+	void Submit(Task task);
+	void Submit(std::vector<Task> &tasks);
+	void Wait();
+	uint32_t GetThreadCount() const;
+
+private:
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	bool _PopTask(uint32_t index, Task &task);
+	bool _StealTask(uint32_t index, Task &task);
+	void _RunTask(Task &task);
+	void _WorkerMain(uint32_t index);
+
+private:
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+	std::vector<std::thread> mThreads;
+	std::mutex mWakeLock;
+	std::condition_variable mWakeCV;
+	std::condition_variable mDoneCV;
+	std::atomic<uint32_t> mQueued;
+	std::atomic<uint32_t> mPending;
+	std::atomic<uint32_t> mNextQueue;
+	bool mQuit;
+};
@@ -0,0 +1,192 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 스레드 버퍼는 이만큼씩 필요할 때 잡는다
+#define TRACE_CHUNK_EVENTS 4096
+
+struct trace_event
+{
+	const char *name;
+	uint64_t timestamp_ns;
+	int64_t frame_index;
+	uint32_t decoder_id;
+	char phase;
+};
+
+// 쓰는 스레드는 하나뿐이고, count를 늘리기 전에 청크를 잡고 이벤트를 다 채우므로 Dump는 count까지만 읽으면 된다
+struct trace_buffer
+{
+	uint32_t tid;
+	std::unique_ptr<std::unique_ptr<trace_event[]>[]> chunks;
+	size_t capacity;
+	std::atomic<size_t> count;
+	std::atomic<uint64_t> dropped;
+};
+
+struct trace_registry
+{
+	std::mutex lock;
+	std::vector<std::unique_ptr<trace_buffer>> buffers;
+	// 스레드가 끝나서 주인이 없는 버퍼. 새 스레드가 이어서 쓴다
+	std::vector<trace_buffer*> free_buffers;
+	size_t events_per_thread;
+	std::chrono::steady_clock::time_point epoch;
+	std::atomic<uint32_t> next_decoder_id;
+
+	trace_registry() : events_per_thread(1 << 20), epoch(std::chrono::steady_clock::now()), next_decoder_id(1) {}
+};
+
+static trace_registry &get_registry()
+{
+	static trace_registry registry;
+	return registry;
+}
+
+// 스레드가 끝나면 버퍼를 빈 목록에 돌려준다. 기록한 이벤트는 Dump할 수 있도록 그대로 남는다.
+// 미리 읽기처럼 항목마다 새로 만드는 스레드가 있어도 버퍼 수는 동시에 기록하는 스레드 수를 넘지 않는다
+struct trace_thread
+{
+	trace_buffer *buffer;
+
+	trace_thread() : buffer(nullptr) {}
+	~trace_thread()
+	{
+		if (!buffer)
+			return;
+
+		trace_registry &registry = get_registry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		registry.free_buffers.push_back(buffer);
+	}
+};
+
+static trace_buffer *get_thread_buffer()
+{
+	static thread_local trace_thread thread;
+	if (thread.buffer)
+		return thread.buffer;
+
+	trace_registry &registry = get_registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	if (!registry.free_buffers.empty())
+	{
+		thread.buffer = registry.free_buffers.back();
+		registry.free_buffers.pop_back();
+		return thread.buffer;
+	}
+
+	std::unique_ptr<trace_buffer> created(new trace_buffer());
+	created->tid = static_cast<uint32_t>(registry.buffers.size() + 1);
+	created->capacity = registry.events_per_thread;
+	created->chunks.reset(new std::unique_ptr<trace_event[]>[(created->capacity + TRACE_CHUNK_EVENTS - 1) / TRACE_CHUNK_EVENTS]);
+	created->count = 0;
+	created->dropped = 0;
+	thread.buffer = created.get();
+	registry.buffers.push_back(std::move(created));
+	return thread.buffer;
+}
+
+std::atomic<bool> Trace::sEnabled(false);
+
+void Trace::Enable(bool enable, size_t eventsPerThread /*= 1 << 20*/)
+{
+	if (enable)
+	{
+		trace_registry &registry = get_registry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		registry.events_per_thread = eventsPerThread;
+	}
+	sEnabled = enable;
+}
+
+void Trace::Begin(const char *name, uint32_t decoderId, int64_t frameIndex)
+{
+	_Record('B', name, decoderId, frameIndex);
+}
+
+void Trace::End(const char *name, uint32_t decoderId, int64_t frameIndex)
+{
+	_Record('E', name, decoderId, frameIndex);
+}
+
+bool Trace::Dump(const std::string &fileName)
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, fileName.c_str(), "wb"))
+		return false;
+
+	trace_registry &registry = get_registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+
+	uint64_t dropped = 0;
+	bool first = true;
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (const std::unique_ptr<trace_buffer> &buffer : registry.buffers)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			(first) ? "" : ",\n", buffer->tid, buffer->tid);
+		first = false;
+
+		const size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const trace_event &event = buffer->chunks[i / TRACE_CHUNK_EVENTS][i % TRACE_CHUNK_EVENTS];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"webm\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+				"\"args\":{\"decoder\":%u,\"frame\":%lld}}",
+				event.name, event.phase, event.timestamp_ns / 1000.0, buffer->tid,
+				event.decoder_id, static_cast<long long>(event.frame_index));
+		}
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":%llu}}\n",
+		static_cast<unsigned long long>(dropped));
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+void Trace::Clear()
+{
+	trace_registry &registry = get_registry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	for (std::unique_ptr<trace_buffer> &buffer : registry.buffers)
+	{
+		buffer->count.store(0, std::memory_order_release);
+		buffer->dropped = 0;
+	}
+}
+
+uint32_t Trace::NewDecoderId()
+{
+	return get_registry().next_decoder_id++;
+}
+
+void Trace::_Record(char phase, const char *name, uint32_t decoderId, int64_t frameIndex)
+{
+	trace_buffer *buffer = get_thread_buffer();
+	const size_t index = buffer->count.load(std::memory_order_relaxed);
+	if (index >= buffer->capacity)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::unique_ptr<trace_event[]> &chunk = buffer->chunks[index / TRACE_CHUNK_EVENTS];
+	if (!chunk)
+		chunk.reset(new trace_event[TRACE_CHUNK_EVENTS]);
+
+	const auto elapsed = std::chrono::steady_clock::now() - get_registry().epoch;
+	trace_event &event = chunk[index % TRACE_CHUNK_EVENTS];
+	event.name = name;
+	event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	event.frame_index = frameIndex;
+	event.decoder_id = decoderId;
+	event.phase = phase;
+	buffer->count.store(index + 1, std::memory_order_release);
+}
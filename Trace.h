@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 0으로 정의하면 트레이스 기록 코드가 빠진다
+#ifndef WEBM_ENABLE_TRACE
+#define WEBM_ENABLE_TRACE 1
+#endif
+
+// 디코딩 단계의 시작/끝을 Chrome trace(JSON) 형식으로 남기는 기록기. chrome://tracing이나 Perfetto에서 연다.
+// 스레드마다 자기 버퍼에만 쓰므로 기록할 때 락을 잡지 않는다. 버퍼가 차면 이후 이벤트는 버린다.
+// 끝난 스레드의 버퍼는 다음에 기록을 시작하는 스레드가 이어서 쓰므로, tid 하나에 여러 스레드가 차례로 나올 수 있다.
+class Trace
+{
+public:
+	// 범위의 시작과 끝을 기록한다. frameIndex는 끝날 때 값을 다시 읽는다
+	class Scope
+	{
+	public:
+		Scope(const char *name, uint32_t decoderId, const int64_t &frameIndex) :
+			mName(name), mDecoderId(decoderId), mFrameIndex(frameIndex), mActive(IsEnabled())
+		{
+			if (mActive)
+				Begin(mName, mDecoderId, mFrameIndex);
+		}
+
+		~Scope()
+		{
+			if (mActive)
+				End(mName, mDecoderId, mFrameIndex);
+		}
+
+	private:
+		const char *mName;
+		uint32_t mDecoderId;
+		const int64_t &mFrameIndex;
+		bool mActive;
+	};
+
+public:
+	// 스레드 하나가 담을 수 있는 이벤트 수. 버퍼는 기록하는 만큼 나눠서 잡는다
+	static void Enable(bool enable, size_t eventsPerThread = 1 << 20);
+	static bool IsEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+	// name은 문자열 리터럴처럼 Dump할 때까지 살아 있어야 한다
+	static void Begin(const char *name, uint32_t decoderId, int64_t frameIndex);
+	static void End(const char *name, uint32_t decoderId, int64_t frameIndex);
+	// 기록을 멈춘 뒤에 부른다
+	static bool Dump(const std::string &fileName);
+	static void Clear();
+	// 디코더 인스턴스마다 다른 번호를 준다. 0은 디코더가 아닌 쪽(업로드 등)에 쓴다
+	static uint32_t NewDecoderId();
+
+private:
+	static void _Record(char phase, const char *name, uint32_t decoderId, int64_t frameIndex);
+
+private:
+	static std::atomic<bool> sEnabled;
+};
+
+// 범위 하나에 하나만 쓴다
+#if WEBM_ENABLE_TRACE
+#define WEBM_TRACE_SCOPE(name, decoderId, frameIndex) Trace::Scope trace_scope(name, decoderId, frameIndex)
+#else
+#define WEBM_TRACE_SCOPE(name, decoderId, frameIndex)
+#endif
@@ -1,13 +1,16 @@
 #include "WebmDecoder.h"
+#include "DebugTrace.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
-#include <assert.h>
+#include <webmids.h>
+#include <algorithm>
 #include <chrono>
 #include <intrin.h>
 #include <windows.h>
 #include <stdio.h>
 #include <chrono>
-#include <stdarg.h>
-#include <iostream>
+#include <mutex>
 
 #ifdef _DEBUG
 #pragma comment(lib, "./lib/libvpxd.lib")
@@ -17,22 +20,80 @@
 #pragma comment(lib, "./lib/libwebm.lib")
 #endif
 
-void OutputDebugTrace(char* lpszFormat, ...)
+// webmids.h에 없는 Matroska BlockAdditionMapping 요소
+#define MKV_BLOCK_ADDITION_MAPPING 0x41E4
+
+// 한 번의 DecodeFrame에서 변환 없이 디코딩만 하고 넘길 수 있는 최대 프레임 수
+#define MAX_DROP_FRAMES 8
+// 이 배속 이상에서는 키 프레임만 디코딩한다
+#define KEYFRAME_ONLY_RATE 4.0f
+// 에셋 키를 만들 때 요소 하나에서 해시하는 최대 바이트. 첫 클러스터가 커도 Load 시간이 파일 크기를 따라가지 않는다
+#define ASSET_HASH_MAX_BYTES (1024 * 1024)
+
+// VP9 uncompressed header를 읽기 위한 비트 리더
+struct vp9_bit_reader
 {
-	va_list args;
-	va_start(args, lpszFormat);
+	const uint8_t *data;
+	uint32_t size;
+	uint32_t pos;
+	bool overrun;
 
-	int buf;
-	char szBuffer[512];
+	uint32_t Read(int bits)
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < bits; ++i, ++pos)
+		{
+			if (pos >= size * 8)
+			{
+				overrun = true;
+				return 0;
+			}
+			value = (value << 1) | ((data[pos >> 3] >> (7 - (pos & 7))) & 1);
+		}
+		return value;
+	}
+};
 
-	buf = _vsnprintf_s(szBuffer, sizeof(szBuffer) / sizeof(szBuffer[0]), lpszFormat, args);
+// 건너뛰어도 이후 프레임이 달라지지 않는 VP9 인터 프레임인지 확인한다.
+// 참조 프레임을 갱신하지 않아도 다음 프레임은 이 프레임의 움직임 벡터(use_prev_frame_mvs)와 세그먼트 맵을 이어 쓰므로,
+// error_resilient_mode로 인코딩해서 프레임마다 이전 프레임과 끊어지는 스트림에서만 건너뛴다.
+// libvpx는 이 설정을 스트림 전체에 같이 쓰므로 이 프레임이 그렇다면 다음 프레임도 그렇다고 본다
+static bool vp9_is_droppable(const uint8_t *data, uint32_t size)
+{
+	// 슈퍼프레임은 숨겨진 참조 프레임을 포함하므로 건너뛰지 않는다
+	if (size == 0 || (data[size - 1] & 0xe0) == 0xc0)
+		return false;
 
-	assert(buf >= 0);
-	OutputDebugStringA(szBuffer);
-	va_end(args);
+	vp9_bit_reader br = { data, size, 0, false };
+	if (br.Read(2) != 2)	// frame_marker
+		return false;
+	const uint32_t profile_low_bit = br.Read(1);
+	const uint32_t profile = profile_low_bit | (br.Read(1) << 1);
+	if (profile == 3)
+		br.Read(1);
+	if (br.Read(1))			// show_existing_frame
+		return false;
+	if (br.Read(1) == 0)	// frame_type == KEY_FRAME
+		return false;
+	const uint32_t show_frame = br.Read(1);
+	if (!br.Read(1))		// error_resilient_mode
+		return false;
+	if (!show_frame && br.Read(1))	// intra_only
+		return false;
+	// error_resilient_mode에서는 reset_frame_context가 없고 refresh_frame_context는 항상 0이다
+	const uint32_t refresh_frame_flags = br.Read(8);
+	return !br.overrun && refresh_frame_flags == 0;
 }
 
-WebmDecoder::WebmDecoder() : mAccumTime(0), mUsingSSE(false), mUsingAVX(false)
+// Load에서 알파 디코더가 필요한지 정할 때도 쓴다. 정의는 Probe 옆에 있다
+static bool track_has_alpha(mkvparser::IMkvReader *reader, const mkvparser::Track *track);
+
+WebmDecoder::WebmDecoder() : mAccumTime(0), mUsingSSE(false), mUsingAVX(false),
+	mLoopCache(nullptr), mLoopCacheStorage(LoopCache::RAW), mFrameCache(nullptr), mLazyLoad(false),
+	mPrefetchClusters(0), mClock(SteadyClock::GetInstance()), mPingPong(false),
+	mReverseMemoryBudget(64 * 1024 * 1024), mOwnDecoderPool(1), mDecoderPool(&mOwnDecoderPool),
+	mBufferPool(BufferPool::GetInstance()), mLoadTime(0),
+	mPlaylistIndex(0), mPlaylistLoop(false), mNextIndex(0), mTraceId(Trace::NewDecoderId()), mDirtyTracking(false)
 {
 	int cpuInfo[4];
 	__cpuid(cpuInfo, 1);
@@ -44,12 +105,18 @@ WebmDecoder::WebmDecoder() : mAccumTime(0), mUsingSSE(false), mUsingAVX(false)
 
 WebmDecoder::~WebmDecoder()
 {
+	_ReleasePlaylist();
+	_ReleaseLoopClip();
 	mCTX.Reset();
 }
 
-bool WebmDecoder::Load(const std::string &fileName, bool loop, float frameRate /*= 1.0f*/)
+bool WebmDecoder::Load(const std::string &fileName, bool loop, float playbackRate /*= 1.0f*/)
 {
+	const uint64_t loadBegin = _GetTime();
+	_ReleasePlaylist();
+	_ReleaseLoopClip();
 	mCTX.Reset();
+	mStats.Reset();
 
 	OutputDebugTrace("%s - load to %s.\n", __FUNCTION__, fileName.c_str());
 	const errno_t error = fopen_s(&mCTX.file, fileName.c_str(), "rb");
@@ -59,49 +126,70 @@ bool WebmDecoder::Load(const std::string &fileName, bool loop, float frameRate /
 		return false;
 	}
 
-	if (!_IsWebM())
+	mCTX.file_name = fileName;
+	if (!_IsWebM(fileName))
 	{
 		mCTX.Reset();
 		return false;
 	}
+	if (mFrameCache)
+		mCTX.asset_hash = _HashAsset(fileName);
 
-	if (vpx_codec_dec_init(&mCTX.decoder, vpx_codec_vp8_dx(), nullptr, 0))
+	// 색상과 알파용 디코더. 같은 코덱과 해상도로 쓰던 것이 풀에 있으면 초기화 없이 다시 쓴다. 알파 디코더는 알파 트랙일 때만 만든다
+	const bool hasAlpha = track_has_alpha(mCTX.source, _FindVideoTrack(mCTX.segment));
+	mCTX.codec = mDecoderPool->Acquire(_GetCodecInterface(), mCTX.video_width, mCTX.video_height, hasAlpha);
+	if (!mCTX.codec)
 	{
 		mCTX.Reset();
-		_PrintError(&mCTX.decoder, "failed to initialize decoder");
+		OutputDebugTrace("%s - failed to initialize decoder\n", __FUNCTION__);
 		return false;
 	}
 
-	// 알파용 디코더
-	if (vpx_codec_dec_init(&mCTX.decoder_alpha, vpx_codec_vp8_dx(), nullptr, 0))
+	mCTX.playback_rate = (playbackRate > 0.0f) ? playbackRate : 1.0f;
+	mCTX.is_play_loop = loop;
+	_ResetTimeline();
+
+	if (mLoopCache && loop)
 	{
-		mCTX.Reset();
-		_PrintError(&mCTX.decoder_alpha, "failed to initialize decoder");
-		return false;
+		mCTX.loop_clip = mLoopCache->Acquire(fileName, mLoopCacheStorage);
+		mCTX.is_loop_cached = mCTX.loop_clip->complete;
+		mCTX.is_loop_builder = !mCTX.is_loop_cached && mLoopCache->BeginBuild(mCTX.loop_clip.get());
 	}
 
-	mCTX.frame_rate = frameRate;
-	mCTX.is_play_loop = loop;
-	mCTX.begin_timestamp_ms = _GetTime();
+	YUVtoRGBAFunc = (mUsingAVX) ? yuv420_rgb24_avx : (mUsingSSE) ? yuv420_rgb24_sse : yuv420_rgb24_std;
+	// 고른 커널은 CPU마다 같으므로 프로세스에서 한 번만 남긴다. 썸네일처럼 파일마다 Load하는 경로에서 출력이 쌓이지 않는다
+	static std::once_flag reportConvertFunc;
+	std::call_once(reportConvertFunc, [this]() {
+		OutputDebugTrace("%s - convert function: %s\n", __FUNCTION__, (mUsingAVX) ? "AVX2" : (mUsingSSE) ? "SSE2" : "Standard");
+	});
+	AlphaConstantFunc = (mUsingAVX) ? alpha_plane_constant_avx : (mUsingSSE) ? alpha_plane_constant_sse : alpha_plane_constant_std;
+	mCTX.dirty_tracker.SetDiffFunc((mUsingAVX) ? plane_diff_blocks_avx : (mUsingSSE) ? plane_diff_blocks_sse : plane_diff_blocks_std);
 
-	YUVtoRGBAFunc = [this]() -> YUVtoRGBAFunc_t {
-		if (mUsingAVX)
-		{
-			std::cout << "Decode Function: AVX2" << std::endl;
-			return yuv420_rgb24_avx;
-		}
-		if (mUsingSSE)
-		{
-			std::cout << "Decode Function: SSE2" << std::endl;
-			return yuv420_rgb24_sse;
-		}
-		std::cout << "Decode Function: Standard" << std::endl;
-		return yuv420_rgb24_std;
-		}();
+	// 끝에서 바로 거꾸로 돌 수 있도록 마지막 GOP를 미리 디코딩해둔다
+	if (mPingPong && loop && _OpenReverseDecoder())
+		mCTX.reverse_decoder->Start(-2, 1);
+
+	mLoadTime = _GetTime() - loadBegin;
+	return true;
+}
 
+bool WebmDecoder::LoadPlaylist(const std::vector<std::string> &fileNames, bool loop, float playbackRate /*= 1.0f*/)
+{
+	if (fileNames.empty() || !Load(fileNames[0], false, playbackRate))
+		return false;
+
+	mPlaylist = fileNames;
+	mPlaylistIndex = 0;
+	mPlaylistLoop = loop;
+	_PreloadNext();
 	return true;
 }
 
+size_t WebmDecoder::GetPlaylistIndex()
+{
+	return mPlaylistIndex;
+}
+
 bool WebmDecoder::IsInitialized()
 {
 	return (mCTX.file) ? true : false;
@@ -112,12 +200,67 @@ WebmDecoder::WEBM_STATE WebmDecoder::Update()
 	if (!mCTX.file)
 		return WEBM_STATE::NONE;
 
-	uint64_t systemTime = _GetTime() - mCTX.begin_timestamp_ms;
-	if (mCTX.timestamp_ms > systemTime)
+	if (!IsFrameDue())
 		return WEBM_STATE::PLAYING;
 
+	return DecodeFrame();
+}
+
+bool WebmDecoder::IsFrameDue()
+{
+	if (!mCTX.file)
+		return false;
+
+	return static_cast<int64_t>(mCTX.timestamp_ns) <= _GetPlaybackTime();
+}
+
+WebmDecoder::WEBM_STATE WebmDecoder::DecodeFrame()
+{
+	if (!mCTX.file)
+		return WEBM_STATE::NONE;
+
+	if (mCTX.is_reverse)
+		return _ReadReverseFrame();
+
+	if (mCTX.is_loop_cached)
+		return _ReadCachedFrame();
+
 	mCTX.state = _ReadFrame();
 
+	// 다음 프레임 시간까지 이미 지났으면 이번 프레임은 화면에 나가지 않으므로 디코딩만 하고 변환은 건너뛴다
+	int dropCount = 0;
+	while (mCTX.state == WEBM_STATE::PLAYING && !mCTX.is_looped && !mFrameCache && _IsBehindSchedule())
+	{
+		if (dropCount == MAX_DROP_FRAMES)
+		{
+			// 디코딩만으로도 따라잡지 못하면 재생 시간을 늦춰서 한 프레임 넘게 밀리지 않게 한다
+			mCTX.begin_timestamp_ns = _GetTime() - mCTX.timestamp_ns;
+			break;
+		}
+
+		// 루프 캐시는 모든 프레임이 있어야 하므로 만들던 캐시는 포기한다
+		_ReleaseLoopClip();
+		// 빠르게 재생할 때는 이후 프레임이 전혀 기대지 않는 프레임만 디코딩도 하지 않는다. 나머지는 디코딩하고 변환만 건너뛴다
+		if (!(mCTX.playback_rate > 1.0f && _IsDroppable()) && !_DecodeVPX())
+			return mCTX.state;
+		mCTX.dropped_frames++;
+		dropCount++;
+		mCTX.state = _ReadFrame();
+	}
+
+	if (mCTX.state == WEBM_STATE::END && mNextDecoder && _SwitchToNext())
+		return mCTX.state;
+
+	if (mCTX.state == WEBM_STATE::END && mPingPong && mCTX.is_play_loop && _BeginReverse(-2, 1))
+		return _ReadReverseFrame();
+
+	if (mCTX.is_looped)
+	{
+		mCTX.is_looped = false;
+		if (_OnLoopRestart())
+			return _ReadCachedFrame();
+	}
+
 	mCTX.img = nullptr;
 	mCTX.img_alpha = nullptr;
 	mCTX.iter = nullptr;
@@ -125,33 +268,37 @@ WebmDecoder::WEBM_STATE WebmDecoder::Update()
 
 	if (mCTX.state == WEBM_STATE::PLAYING)
 	{
-		if (vpx_codec_decode(&mCTX.decoder, &mCTX.buffer[0], mCTX.buffer_size, nullptr, 0))
+		if (mFrameCache)
 		{
-			_PrintError(&mCTX.decoder, "failed to decode frame");
-			mCTX.state = WEBM_STATE::LOAD_ERROR;
-			return mCTX.state;
+			if (_DecodeSharedFrame() != WEBM_STATE::PLAYING)
+				return mCTX.state;
 		}
-		mCTX.img = vpx_codec_get_frame(&mCTX.decoder, &mCTX.iter);
-
-		if (mCTX.buffer_alpha_size > 0)
+		else
 		{
-			if (vpx_codec_decode(&mCTX.decoder_alpha, &mCTX.buffer_alpha[0], mCTX.buffer_alpha_size, nullptr, 0))
-			{
-				_PrintError(&mCTX.decoder_alpha, "failed to decode frame");
-				mCTX.state = WEBM_STATE::LOAD_ERROR;
+			if (!_DecodeVPX())
 				return mCTX.state;
-			}
-			mCTX.img_alpha = vpx_codec_get_frame(&mCTX.decoder_alpha, &mCTX.iter_alpha);
+			_ConvertToRGBA();
+		}
+
+		if (_IsBehindSchedule())
+			mCTX.late_frames++;
+
+		if (mCTX.is_loop_builder && mCTX.frame_width > 0 &&
+			!mLoopCache->AddFrame(mCTX.loop_clip.get(), mCTX.media_timestamp_ns, mCTX.frame_width, mCTX.frame_height, _GetFramePixels()))
+		{
+			_ReleaseLoopClip();
 		}
-		_ConvertToRGBA();
 	}
 	return mCTX.state;
 }
 
 void WebmDecoder::Stop()
 {
+	// 첫 루프를 다 채우지 못했으면 버린다
+	_ReleaseLoopClip();
+	mCTX.is_loop_cached = false;
 	mCTX.cluster = nullptr;
-	mCTX.timestamp_ms = 0;
+	mCTX.timestamp_ns = 0;
 }
 
 void WebmDecoder::Restart()
@@ -159,19 +306,263 @@ void WebmDecoder::Restart()
 	if (!mCTX.file)
 		return;
 
+	_ReleaseLoopClip();
+	mCTX.is_loop_cached = mCTX.loop_clip && mCTX.loop_clip->complete;
+	mCTX.loop_frame_index = 0;
+
 	mCTX.block_entry = nullptr;
 	mCTX.cluster = mCTX.segment->GetFirst();
-	mCTX.begin_timestamp_ms = _GetTime();
-	mCTX.timestamp_ms = 0;
+	mCTX.frame_index = -1;
+	mCTX.decoded_frame_index = -1;
+	mCTX.wait_key_frame = false;
+	mCTX.is_reverse = false;
+	_ResetTimeline();
+	mCTX.timestamp_ns = 0;
+
+	if (mCTX.reverse_decoder && mPingPong)
+		mCTX.reverse_decoder->Start(-2, 1);
 }
 
 
 std::tuple<int, int, uint8_t*> WebmDecoder::GetRGBA()
 {
-	return std::make_tuple(
-		(mCTX.img) ? mCTX.img->d_w : 0,
-		(mCTX.img) ? mCTX.img->d_h : 0,
-		mCTX.pixels);
+	return std::make_tuple(mCTX.frame_width, mCTX.frame_height, _GetFramePixels());
+}
+
+const AlphaCoverage *WebmDecoder::GetAlphaCoverage()
+{
+	return (mCTX.has_alpha_coverage) ? &mCTX.alpha_coverage : nullptr;
+}
+
+const WebmDecoder::DirtyRegion &WebmDecoder::GetDirtyRegion()
+{
+	return mCTX.dirty_region;
+}
+
+WebmDecoder::FrameDesc WebmDecoder::GetFrameDesc()
+{
+	FrameDesc desc;
+	desc.frame_index = mCTX.frame_index;
+	desc.timestamp_ns = mCTX.timestamp_ns;
+	desc.width = mCTX.frame_width;
+	desc.height = mCTX.frame_height;
+	desc.stride = (mCTX.shared_frame) ? mCTX.shared_frame->stride : mCTX.frame_width * 4;
+	desc.geometry_version = mCTX.geometry_version;
+	desc.pixels = _GetFramePixels();
+	return desc;
+}
+
+Frame WebmDecoder::GetFrame()
+{
+	Frame frame;
+	if (mCTX.shared_frame)
+	{
+		// 프레임 캐시의 프레임은 다른 디코더와 나눠 쓰므로 복사해서 넘긴다
+		const FrameCache::Frame &shared = *mCTX.shared_frame;
+		if (frame.Allocate(mBufferPool, shared.width, shared.height, shared.stride, Frame::FORMAT_RGBA))
+			memcpy(frame.GetData(), shared.pixels.data(), shared.pixels.size());
+	}
+	else
+	{
+		frame = std::move(mCTX.frame);
+		mCTX.dirty_base = nullptr;
+	}
+
+	if (frame)
+		frame.SetTimestamp(mCTX.frame_index, mCTX.timestamp_ns);
+	return frame;
+}
+
+bool WebmDecoder::SetPlaybackRate(float rate)
+{
+	if (rate <= 0.0f)
+	{
+		OutputDebugTrace("%s - invalid playback rate %f.\n", __FUNCTION__, rate);
+		return false;
+	}
+
+	if (mCTX.file)
+	{
+		// 지금까지 재생한 위치를 기준으로 시간축을 다시 잡는다
+		const uint64_t now = _GetTime();
+		const uint64_t elapsed = (now > mCTX.begin_timestamp_ns) ? now - mCTX.begin_timestamp_ns : 0;
+		const uint64_t advanced = static_cast<uint64_t>(elapsed * static_cast<double>(mCTX.playback_rate));
+		if (mCTX.is_reverse)
+			mCTX.base_media_timestamp_ns = (mCTX.base_media_timestamp_ns > advanced) ? mCTX.base_media_timestamp_ns - advanced : 0;
+		else
+			mCTX.base_media_timestamp_ns += advanced;
+		mCTX.begin_timestamp_ns = now;
+
+		// 키 프레임만 디코딩하다 내려오면 다음 키 프레임까지는 디코딩할 수 없다
+		if (mCTX.playback_rate >= KEYFRAME_ONLY_RATE && rate < KEYFRAME_ONLY_RATE)
+			mCTX.wait_key_frame = true;
+	}
+
+	mCTX.playback_rate = rate;
+	mCTX.timestamp_ns = _ToPresentationTime(mCTX.media_timestamp_ns);
+	return true;
+}
+
+float WebmDecoder::GetPlaybackRate()
+{
+	return mCTX.playback_rate;
+}
+
+bool WebmDecoder::SetReverse(bool reverse)
+{
+	if (!mCTX.file)
+		return false;
+	if (mCTX.is_reverse == reverse)
+		return true;
+
+	if (!reverse)
+		return _SeekForward(mCTX.frame_index + 1);
+
+	// 루프 캐시에서 재생 중이면 캐시에서 꺼낸 프레임 번호가 현재 위치다
+	const int64_t current = (mCTX.is_loop_cached) ? static_cast<int64_t>(mCTX.loop_frame_index) - 1 : mCTX.frame_index;
+	if (current < 1)
+		return false;
+	return _BeginReverse(current - 1, (mPingPong) ? 1 : 0);
+}
+
+bool WebmDecoder::IsReverse()
+{
+	return mCTX.is_reverse;
+}
+
+void WebmDecoder::SetPingPong(bool pingPong)
+{
+	mPingPong = pingPong;
+}
+
+void WebmDecoder::SetReverseMemoryBudget(size_t bytes)
+{
+	mReverseMemoryBudget = bytes;
+	if (mCTX.reverse_decoder)
+		mCTX.reverse_decoder->SetMemoryBudget(bytes);
+}
+
+bool WebmDecoder::ExtractThumbnails(const std::string &fileName, const std::vector<uint64_t> &timestamps_ns, uint32_t size,
+	std::vector<Thumbnail> &thumbnails, DecoderPool *decoderPool /*= nullptr*/)
+{
+	thumbnails.clear();
+
+	// 헤더와 Cues만 읽고 필요한 클러스터만 불러온다
+	WebmDecoder decoder;
+	decoder.SetLazyLoad(true);
+	decoder.SetDecoderPool(decoderPool);
+	if (!decoder.Load(fileName, false))
+		return false;
+
+	thumbnails.resize(timestamps_ns.size());
+	const mkvparser::BlockEntry *prevEntry = nullptr;
+	for (size_t i = 0; i < timestamps_ns.size(); ++i)
+	{
+		const mkvparser::BlockEntry *entry = decoder._FindKeyFrame(timestamps_ns[i]);
+		if (!entry)
+		{
+			OutputDebugTrace("%s - failed to find key frame in %s.\n", __FUNCTION__, fileName.c_str());
+			thumbnails.clear();
+			return false;
+		}
+
+		// 같은 키 프레임이면 다시 디코딩하지 않는다
+		if (entry == prevEntry)
+		{
+			thumbnails[i] = thumbnails[i - 1];
+			continue;
+		}
+		if (!decoder._DecodeThumbnail(entry, size, thumbnails[i]))
+		{
+			thumbnails.clear();
+			return false;
+		}
+		prevEntry = entry;
+	}
+	return true;
+}
+
+void WebmDecoder::ExtractThumbnails(ThreadPool &pool, DecoderPool &decoderPool, const std::vector<std::string> &fileNames,
+	const std::vector<uint64_t> &timestamps_ns, uint32_t size, std::vector<std::vector<Thumbnail>> &thumbnails)
+{
+	thumbnails.clear();
+	thumbnails.resize(fileNames.size());
+
+	std::vector<ThreadPool::Task> tasks;
+	tasks.reserve(fileNames.size());
+	for (size_t i = 0; i < fileNames.size(); ++i)
+	{
+		tasks.push_back([&decoderPool, &fileNames, &timestamps_ns, &thumbnails, size, i]() {
+			ExtractThumbnails(fileNames[i], timestamps_ns, size, thumbnails[i], &decoderPool);
+		});
+	}
+	pool.Submit(tasks);
+	pool.Wait();
+}
+
+WebmDecoder::PlaybackStats WebmDecoder::GetPlaybackStats()
+{
+	PlaybackStats stats;
+	stats.dropped_frames = mCTX.dropped_frames;
+	stats.late_frames = mCTX.late_frames;
+	stats.load_ns = mLoadTime;
+	return stats;
+}
+
+DecoderStats::Snapshot WebmDecoder::GetStats()
+{
+	return mStats.GetSnapshot(mCTX.dropped_frames, mCTX.late_frames);
+}
+
+void WebmDecoder::SetLoopCache(LoopCache *cache, LoopCache::STORAGE storage /*= LoopCache::RAW*/)
+{
+	mLoopCache = cache;
+	mLoopCacheStorage = storage;
+}
+
+void WebmDecoder::SetFrameCache(FrameCache *cache)
+{
+	mFrameCache = cache;
+}
+
+void WebmDecoder::SetLazyLoad(bool lazy)
+{
+	mLazyLoad = lazy;
+}
+
+void WebmDecoder::SetPrefetch(uint32_t clusterCount)
+{
+	mPrefetchClusters = clusterCount;
+}
+
+void WebmDecoder::SetClock(Clock *clock)
+{
+	mClock = (clock) ? clock : SteadyClock::GetInstance();
+}
+
+void WebmDecoder::SetDecoderPool(DecoderPool *pool)
+{
+	mDecoderPool = (pool) ? pool : &mOwnDecoderPool;
+}
+
+void WebmDecoder::SetBufferPool(BufferPool *pool)
+{
+	mBufferPool = (pool) ? pool : BufferPool::GetInstance();
+}
+
+void WebmDecoder::SetDirtyTracking(bool enable)
+{
+	mDirtyTracking = enable;
+}
+
+PrefetchReader::Stats WebmDecoder::GetPrefetchStats()
+{
+	if (mCTX.prefetch_reader)
+		return mCTX.prefetch_reader->GetStats();
+
+	PrefetchReader::Stats stats;
+	memset(&stats, 0, sizeof(stats));
+	return stats;
 }
 
 void WebmDecoder::_PrintError(vpx_codec_ctx_t *ctx, const char *error)
@@ -182,12 +573,22 @@ void WebmDecoder::_PrintError(vpx_codec_ctx_t *ctx, const char *error)
 		OutputDebugTrace("    %s\n", detail);
 }
 
-bool WebmDecoder::_IsWebM()
+bool WebmDecoder::_IsWebM(const std::string &fileName)
 {
-	mCTX.reader = new mkvparser::MkvReader(mCTX.file);
+	if (mPrefetchClusters > 0)
+	{
+		mCTX.prefetch_reader = new PrefetchReader(mCTX.file, fileName, mPrefetchClusters + 1);
+		mCTX.source = mCTX.prefetch_reader;
+	}
+	else
+	{
+		mCTX.reader = new mkvparser::MkvReader(mCTX.file);
+		mCTX.source = mCTX.reader;
+	}
+
 	mkvparser::EBMLHeader ebmlHeader;
 	long long pos = 0;
-	long long ret = ebmlHeader.Parse(mCTX.reader, pos);
+	long long ret = ebmlHeader.Parse(mCTX.source, pos);
 	if (ret < 0) {
 		OutputDebugTrace("%s - EBMLHeader::Parse() failed.\n", __FUNCTION__);
 		return false;
@@ -202,158 +603,836 @@ bool WebmDecoder::_IsWebM()
 
 	// segment 불러오기
 	mkvparser::Segment *segment;
-	if (mkvparser::Segment::CreateInstance(mCTX.reader, pos, segment))
+	if (mkvparser::Segment::CreateInstance(mCTX.source, pos, segment))
 	{
 		OutputDebugTrace("%s - failed to create segment instance.\n", __FUNCTION__);
 		return false;
 	}
 	mCTX.segment = segment;
-	if (mCTX.segment->Load() < 0)
+	if (mLazyLoad)
+	{
+		// 헤더와 Cues, 첫 클러스터만 읽고 나머지 클러스터는 재생하면서 불러온다
+		if (mCTX.segment->ParseHeaders() != 0 || mCTX.segment->LoadCluster() < 0)
+		{
+			OutputDebugTrace("%s - failed to parse segment headers.\n", __FUNCTION__);
+			return false;
+		}
+		_LoadCues(mCTX.segment);
+	}
+	else if (mCTX.segment->Load() < 0)
 	{
 		OutputDebugTrace("%s - failed to load segment instance.\n", __FUNCTION__);
 		return false;
 	}
 
 	// VideoTrack 확인
-	const mkvparser::Tracks *const tracks = segment->GetTracks();
-	const mkvparser::VideoTrack *video_track = nullptr;
-	for (unsigned long i = 0; i < tracks->GetTracksCount(); ++i)
-	{
-		const mkvparser::Track *const track = tracks->GetTrackByIndex(i);
-		if (track->GetType() == mkvparser::Track::kVideo)
-		{
-			video_track = static_cast<const mkvparser::VideoTrack*>(track);
-			mCTX.video_track_index = static_cast<int>(track->GetNumber());
-			break;
-		}
-	}
-
+	const mkvparser::VideoTrack *video_track = _FindVideoTrack(segment);
 	if (video_track == nullptr || video_track->GetCodecId() == nullptr)
 	{
 		OutputDebugTrace("%s - unable to find video codec.\n", __FUNCTION__);
 		return false;
 	}
+	mCTX.video_track_index = static_cast<int>(video_track->GetNumber());
 
 	// codec 확인
-	if (!strncmp(video_track->GetCodecId(), "V_VP8", 5))
-	{
-		mCTX.fourcc = VP8_FOURCC;
-	}
-	else if (!strncmp(video_track->GetCodecId(), "V_VP9", 5))
-	{
-		mCTX.fourcc = VP9_FOURCC;
-	}
-	else
+	mCTX.fourcc = _GetFourCC(video_track);
+	if (mCTX.fourcc == 0)
 	{
 		OutputDebugTrace("%s - it is not vp8 or vp9 codec.\n", __FUNCTION__);
 		return false;
 	}
 
-	mCTX.framerate_numerator = 0;
-	mCTX.framerate_denominator = 0;
+	_GetFrameRate(video_track, mCTX.framerate_numerator, mCTX.framerate_denominator);
 	mCTX.video_width = static_cast<uint32_t>(video_track->GetWidth());
 	mCTX.video_height = static_cast<uint32_t>(video_track->GetHeight());
 	mCTX.cluster = mCTX.segment->GetFirst();
+	_PrefetchClusters();
 
 	return true;
 }
 
-WebmDecoder::WEBM_STATE WebmDecoder::_ReadFrame()
+uint64_t WebmDecoder::_HashAsset(const std::string &fileName)
 {
-	if (!mCTX.cluster)
-		return WEBM_STATE::NONE;
+	// 파일 식별 정보에 EBML 헤더, Segment Info, Tracks, 첫 클러스터를 더한다. 나머지 클러스터는 읽지 않는다
+	uint64_t hash = FrameCache::HashFileIdentity(fileName);
+	const mkvparser::Segment *segment = mCTX.segment;
+	const mkvparser::SegmentInfo *info = segment->GetInfo();
+	const mkvparser::Tracks *tracks = segment->GetTracks();
+	const mkvparser::Cluster *cluster = segment->GetFirst();
+	const long long ranges[][2] = {
+		{ 0, segment->m_element_start },
+		{ (info) ? info->m_element_start : 0, (info) ? info->m_element_size : 0 },
+		{ (tracks) ? tracks->m_element_start : 0, (tracks) ? tracks->m_element_size : 0 },
+		{ (cluster && !cluster->EOS()) ? cluster->m_element_start : 0, (cluster && !cluster->EOS()) ? cluster->GetElementSize() : 0 },
+	};
 
-	bool block_entry_eos = false;
-	do
+	std::vector<uint8_t> buffer;
+	for (const auto &range : ranges)
 	{
-		long status = 0;
-		bool get_new_block = false;
-		if (mCTX.block_entry == nullptr && !block_entry_eos)
-		{
-			status = mCTX.cluster->GetFirst(mCTX.block_entry);
-			get_new_block = true;
-		}
-		else if (block_entry_eos || mCTX.block_entry->EOS())
-		{
-			mCTX.cluster = mCTX.segment->GetNext(mCTX.cluster);
-			if (mCTX.cluster == nullptr || mCTX.cluster->EOS())
-			{
-				if (!mCTX.is_play_loop)
-				{
-					mCTX.cluster = nullptr;
-					return WEBM_STATE::END;
-				}
-				mCTX.cluster = mCTX.segment->GetFirst();
-				mCTX.begin_timestamp_ms = _GetTime();
-			}
-			status = mCTX.cluster->GetFirst(mCTX.block_entry);
-			block_entry_eos = false;
-			get_new_block = true;
-		}
-		else if (mCTX.block == nullptr || mCTX.block_frame_index == mCTX.block->GetFrameCount() ||
-			mCTX.block->GetTrackNumber() != mCTX.video_track_index)
+		const long long size = std::min<long long>(range[1], ASSET_HASH_MAX_BYTES);
+		if (size <= 0)
+			continue;
+
+		buffer.resize(static_cast<size_t>(size));
+		if (mCTX.source->Read(range[0], static_cast<long>(size), &buffer[0]) == 0)
+			hash = FrameCache::Hash(hash, &buffer[0], buffer.size());
+	}
+	return hash;
+}
+
+void WebmDecoder::_LoadCues(mkvparser::Segment *segment)
+{
+	// 파일 끝에 있는 Cues는 SeekHead를 통해서만 찾을 수 있다
+	const mkvparser::SeekHead *seekHead = segment->GetSeekHead();
+	if (!segment->GetCues() && seekHead)
+	{
+		for (int i = 0; i < seekHead->GetCount(); ++i)
 		{
-			status = mCTX.cluster->GetNext(mCTX.block_entry, mCTX.block_entry);
-			if (mCTX.block_entry == nullptr || mCTX.block_entry->EOS())
-			{
-				block_entry_eos = true;
+			const mkvparser::SeekHead::Entry *entry = seekHead->GetEntry(i);
+			if (entry->id != libwebm::kMkvCues)
 				continue;
-			}
-			get_new_block = true;
-		}
 
-		if (status || mCTX.block_entry == nullptr)
-		{
-			return WEBM_STATE::LOAD_ERROR;
+			long long pos = 0;
+			long len = 0;
+			segment->ParseCues(entry->pos, pos, len);
+			break;
 		}
+	}
 
-		if (get_new_block)
-		{
-			mCTX.block = mCTX.block_entry->GetBlock();
-			int frameCount = mCTX.block->GetFrameCount();
-			if (mCTX.block == nullptr)
-				return WEBM_STATE::LOAD_ERROR;
-			mCTX.block_frame_index = 0;
+	const mkvparser::Cues *cues = segment->GetCues();
+	if (!cues)
+		return;
+
+	while (!cues->DoneParsing())
+		cues->LoadCuePoint();
+}
+
+const mkvparser::VideoTrack *WebmDecoder::_FindVideoTrack(const mkvparser::Segment *segment)
+{
+	const mkvparser::Tracks *const tracks = segment->GetTracks();
+	if (!tracks)
+		return nullptr;
+
+	for (unsigned long i = 0; i < tracks->GetTracksCount(); ++i)
+	{
+		const mkvparser::Track *const track = tracks->GetTrackByIndex(i);
+		if (track && track->GetType() == mkvparser::Track::kVideo)
+			return static_cast<const mkvparser::VideoTrack*>(track);
+	}
+	return nullptr;
+}
+
+uint32_t WebmDecoder::_GetFourCC(const mkvparser::VideoTrack *track)
+{
+	if (!strncmp(track->GetCodecId(), "V_VP8", 5))
+		return VP8_FOURCC;
+	if (!strncmp(track->GetCodecId(), "V_VP9", 5))
+		return VP9_FOURCC;
+	return 0;
+}
+
+void WebmDecoder::_GetFrameRate(const mkvparser::VideoTrack *track, int &numerator, int &denominator)
+{
+	// DefaultDuration(프레임당 ns)을 우선하고, 없으면 폐기된 FrameRate 요소를 쓴다
+	long long num = 0;
+	long long den = 0;
+	if (track->GetDefaultDuration() > 0)
+	{
+		num = 1000000000;
+		den = static_cast<long long>(track->GetDefaultDuration());
+	}
+	else if (track->GetFrameRate() > 0.0)
+	{
+		num = static_cast<long long>(track->GetFrameRate() * 1000.0 + 0.5);
+		den = 1000;
+	}
+
+	long long a = num, b = den;
+	while (b != 0)
+	{
+		const long long t = a % b;
+		a = b;
+		b = t;
+	}
+	numerator = (a > 0) ? static_cast<int>(num / a) : 0;
+	denominator = (a > 0) ? static_cast<int>(den / a) : 0;
+}
+
+// TrackEntry에 알파(BlockAdditional)가 선언돼 있는지 확인한다. mkvparser는 이 요소들을 노출하지 않는다
+static bool track_has_alpha(mkvparser::IMkvReader *reader, const mkvparser::Track *track)
+{
+	long long pos = track->m_element_start;
+	const long long stop = track->m_element_start + track->m_element_size;
+	long long id = 0;
+	long long size = 0;
+	if (mkvparser::ParseElementHeader(reader, pos, stop, id, size) < 0)
+		return false;
+
+	while (pos < stop)
+	{
+		if (mkvparser::ParseElementHeader(reader, pos, stop, id, size) < 0)
+			return false;
+
+		if (id == MKV_BLOCK_ADDITION_MAPPING)
+			return true;
+		if (id == libwebm::kMkvMaxBlockAdditionID && mkvparser::UnserializeUInt(reader, pos, size) > 0)
+			return true;
+		if (id == libwebm::kMkvVideo)
+		{
+			long long video_pos = pos;
+			const long long video_stop = pos + size;
+			while (video_pos < video_stop)
+			{
+				if (mkvparser::ParseElementHeader(reader, video_pos, video_stop, id, size) < 0)
+					return false;
+				if (id == libwebm::kMkvAlphaMode && mkvparser::UnserializeUInt(reader, video_pos, size) == 1)
+					return true;
+				video_pos += size;
+			}
 		}
-	} while (block_entry_eos || mCTX.block->GetTrackNumber() != mCTX.video_track_index);
+		pos += size;
+	}
+	return false;
+}
 
-	const mkvparser::Block::Frame &frame = mCTX.block->GetFrame(mCTX.block_frame_index++);
-	if (frame.len > static_cast<long>(mCTX.buffer.size()))
+bool WebmDecoder::Probe(const std::string &fileName, MediaInfo &info)
+{
+	memset(&info, 0, sizeof(info));
+
+	FILE *file = nullptr;
+	if (fopen_s(&file, fileName.c_str(), "rb"))
 	{
-		mCTX.buffer.resize(frame.len * 2);
+		OutputDebugTrace("%s - failed to open %s.\n", __FUNCTION__, fileName.c_str());
+		return false;
 	}
-	mCTX.buffer_size = frame.len;
+
+	mkvparser::MkvReader reader(file);
+	mkvparser::EBMLHeader ebmlHeader;
+	mkvparser::Segment *segment = nullptr;
+	long long pos = 0;
+	bool ok = ebmlHeader.Parse(&reader, pos) >= 0 && !_stricmp(ebmlHeader.m_docType, "webm") &&
+		!mkvparser::Segment::CreateInstance(&reader, pos, segment) && segment &&
+		segment->ParseHeaders() == 0;
+
+	const mkvparser::VideoTrack *track = (ok) ? _FindVideoTrack(segment) : nullptr;
+	ok = track && track->GetCodecId() && _GetFourCC(track) != 0;
+	if (ok)
+	{
+		info.fourcc = _GetFourCC(track);
+		info.width = static_cast<uint32_t>(track->GetWidth());
+		info.height = static_cast<uint32_t>(track->GetHeight());
+		info.has_alpha = track_has_alpha(&reader, track);
+		_GetFrameRate(track, info.framerate_numerator, info.framerate_denominator);
+
+		// Duration이 없는 파일은 마지막 CuePoint 시간으로 대신한다
+		const long long duration = (segment->GetInfo()) ? segment->GetInfo()->GetDuration() : -1;
+		if (duration >= 0)
+		{
+			info.duration_ns = duration;
+		}
+		else
+		{
+			_LoadCues(segment);
+			const mkvparser::Cues *cues = segment->GetCues();
+			const mkvparser::CuePoint *last = (cues) ? cues->GetLast() : nullptr;
+			if (last)
+				info.duration_ns = last->GetTime(segment) + track->GetDefaultDuration();
+		}
+
+		if (track->GetDefaultDuration() > 0)
+			info.frame_count = (info.duration_ns + track->GetDefaultDuration() / 2) / track->GetDefaultDuration();
+	}
+	else
+	{
+		OutputDebugTrace("%s - failed to probe %s.\n", __FUNCTION__, fileName.c_str());
+	}
+
+	delete segment;
+	fclose(file);
+	return ok;
+}
+
+void WebmDecoder::Probe(ThreadPool &pool, const std::vector<std::string> &fileNames, std::vector<MediaInfo> &infos)
+{
+	infos.clear();
+	infos.resize(fileNames.size());
+
+	std::vector<ThreadPool::Task> tasks;
+	tasks.reserve(fileNames.size());
+	for (size_t i = 0; i < fileNames.size(); ++i)
+	{
+		tasks.push_back([&fileNames, &infos, i]() {
+			Probe(fileNames[i], infos[i]);
+		});
+	}
+	pool.Submit(tasks);
+	pool.Wait();
+}
+
+void WebmDecoder::_PrefetchClusters()
+{
+	if (!mCTX.prefetch_reader || !mCTX.cluster || mCTX.cluster->EOS())
+		return;
+
+	const size_t rangeCount = mPrefetchClusters + 1;
+	std::vector<PrefetchReader::Range> ranges;
+	long long nextPos = -1;
+
+	// 이미 불러온 클러스터는 위치와 크기를 바로 알 수 있다. 루프 재생이면 처음으로 돌아가서 이어 붙인다
+	const mkvparser::Cluster *cluster = mCTX.cluster;
+	while (cluster && !cluster->EOS() && ranges.size() < rangeCount)
+	{
+		const long long size = cluster->GetElementSize();
+		if (size <= 0)
+			break;
+		ranges.push_back({ cluster->m_element_start, size });
+		nextPos = cluster->m_element_start + size;
+
+		if (cluster->GetIndex() + 1 < static_cast<long>(mCTX.segment->GetCount()))
+		{
+			cluster = mCTX.segment->GetNext(cluster);
+		}
+		else if (mCTX.segment->DoneParsing() && mCTX.is_play_loop)
+		{
+			cluster = mCTX.segment->GetFirst();
+			nextPos = -1;
+		}
+		else
+		{
+			cluster = nullptr;
+		}
+
+		if (cluster == mCTX.cluster)
+			break;
+	}
+
+	// 아직 불러오지 않은 클러스터는 Cues에 기록된 클러스터 위치 사이를 구간으로 잡는다
+	const mkvparser::Cues *cues = mCTX.segment->GetCues();
+	const mkvparser::Track *track = mCTX.segment->GetTracks()->GetTrackByNumber(mCTX.video_track_index);
+	if (cues && track && nextPos >= 0)
+	{
+		long long prevPos = -1;
+		for (const mkvparser::CuePoint *cue = cues->GetFirst(); cue && ranges.size() < rangeCount; cue = cues->GetNext(cue))
+		{
+			const mkvparser::CuePoint::TrackPosition *position = cue->Find(track);
+			if (!position)
+				continue;
+
+			const long long pos = mCTX.segment->m_start + position->m_pos;
+			if (pos < nextPos || pos == prevPos)
+				continue;
+			if (prevPos >= 0)
+				ranges.push_back({ prevPos, pos - prevPos });
+			prevPos = pos;
+		}
+	}
+
+	mCTX.prefetch_reader->Prefetch(ranges);
+}
+
+WebmDecoder::WEBM_STATE WebmDecoder::_ReadFrame()
+{
+	if (!mCTX.cluster)
+		return WEBM_STATE::NONE;
+
+	WEBM_STAGE_TIMER(mStats, STAGE_READ);
+	WEBM_TRACE_SCOPE("read", mTraceId, mCTX.frame_index);
+
+	bool block_entry_eos = false;
+	do
+	{
+		long status = 0;
+		bool get_new_block = false;
+		if (mCTX.block_entry == nullptr && !block_entry_eos)
+		{
+			status = mCTX.cluster->GetFirst(mCTX.block_entry);
+			get_new_block = true;
+		}
+		else if (block_entry_eos || mCTX.block_entry->EOS())
+		{
+			if (mLazyLoad && !mCTX.segment->DoneParsing() &&
+				mCTX.cluster->GetIndex() + 1 >= static_cast<long>(mCTX.segment->GetCount()))
+			{
+				if (mCTX.segment->LoadCluster() < 0)
+				{
+					OutputDebugTrace("%s - failed to load cluster\n", __FUNCTION__);
+					return WEBM_STATE::LOAD_ERROR;
+				}
+			}
+			mCTX.cluster = mCTX.segment->GetNext(mCTX.cluster);
+			if (mCTX.cluster == nullptr || mCTX.cluster->EOS())
+			{
+				// 핑퐁 루프는 끝에서 DecodeFrame이 역재생으로 넘긴다
+				if (!mCTX.is_play_loop || mPingPong)
+				{
+					mCTX.cluster = nullptr;
+					return WEBM_STATE::END;
+				}
+				mCTX.cluster = mCTX.segment->GetFirst();
+				mCTX.frame_index = -1;
+				mCTX.decoded_frame_index = -1;
+				_ResetTimeline();
+				mCTX.is_looped = true;
+			}
+			_PrefetchClusters();
+			status = mCTX.cluster->GetFirst(mCTX.block_entry);
+			block_entry_eos = false;
+			get_new_block = true;
+		}
+		else if (mCTX.block == nullptr || mCTX.block_frame_index == mCTX.block->GetFrameCount() ||
+			mCTX.block->GetTrackNumber() != mCTX.video_track_index)
+		{
+			status = mCTX.cluster->GetNext(mCTX.block_entry, mCTX.block_entry);
+			if (mCTX.block_entry == nullptr || mCTX.block_entry->EOS())
+			{
+				block_entry_eos = true;
+				continue;
+			}
+			get_new_block = true;
+		}
+
+		if (status || mCTX.block_entry == nullptr)
+		{
+			return WEBM_STATE::LOAD_ERROR;
+		}
+
+		if (get_new_block)
+		{
+			mCTX.block = mCTX.block_entry->GetBlock();
+			int frameCount = mCTX.block->GetFrameCount();
+			if (mCTX.block == nullptr)
+				return WEBM_STATE::LOAD_ERROR;
+			mCTX.block_frame_index = 0;
+		}
+	} while (block_entry_eos || mCTX.block->GetTrackNumber() != mCTX.video_track_index || _IsSkippedBlock());
+
+	const int block_frame_index = mCTX.block_frame_index++;
 	mCTX.is_key_frame = mCTX.block->IsKey();
-	std::chrono::nanoseconds timestamp_ns(mCTX.block->GetTime(mCTX.cluster));
-	mCTX.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp_ns).count();
-	mCTX.timestamp_ms = (long long)(mCTX.timestamp_ms / mCTX.frame_rate);
+	mCTX.frame_index++;
+	if (mCTX.is_key_frame)
+	{
+		mCTX.key_cluster = mCTX.cluster;
+		mCTX.key_block_entry = mCTX.block_entry;
+		mCTX.key_block_frame_index = mCTX.block_frame_index - 1;
+		mCTX.key_frame_index = mCTX.frame_index;
+	}
+	const uint64_t media_timestamp_ns = mCTX.block->GetTime(mCTX.cluster);
+	if (mCTX.frame_index > 0 && media_timestamp_ns > mCTX.media_timestamp_ns)
+		mCTX.frame_duration_ns = media_timestamp_ns - mCTX.media_timestamp_ns;
+	mCTX.media_timestamp_ns = media_timestamp_ns;
+	mCTX.timestamp_ns = _ToPresentationTime(media_timestamp_ns);
+
+	if (!_ReadBlockData(mCTX.block, block_frame_index))
+		return WEBM_STATE::LOAD_ERROR;
+	return WEBM_STATE::PLAYING;
+}
 
-	long ret = frame.Read(mCTX.reader, &mCTX.buffer[0]);
+bool WebmDecoder::_ReadBlockData(const mkvparser::Block *block, int frameIndex)
+{
+	const mkvparser::Block::Frame &frame = block->GetFrame(frameIndex);
+	std::vector<uint8_t> &buffer = mCTX.codec->buffer;
+	if (frame.len > static_cast<long>(buffer.size()))
+	{
+		buffer.resize(frame.len * 2);
+	}
+	mCTX.buffer_size = frame.len;
+	long ret = frame.Read(mCTX.source, &buffer[0]);
 	if (ret)
 	{
 		OutputDebugTrace("%s - failed to read frame\n", __FUNCTION__);
-		return WEBM_STATE::LOAD_ERROR;
+		return false;
 	}
 
-	if (mCTX.block->GetFrameAdditionCount() > 0)
+	mCTX.buffer_alpha_size = 0;
+	if (block->GetFrameAdditionCount() > 0)
 	{
-		const mkvparser::Block::Frame &frame_addition = mCTX.block->GetFrameAddition(0);
-		if (frame_addition.len > static_cast<long>(mCTX.buffer_alpha.size()))
+		const mkvparser::Block::Frame &frame_addition = block->GetFrameAddition(0);
+		std::vector<uint8_t> &buffer_alpha = mCTX.codec->buffer_alpha;
+		if (frame_addition.len > static_cast<long>(buffer_alpha.size()))
 		{
-			mCTX.buffer_alpha.resize(frame_addition.len * 2);
+			buffer_alpha.resize(frame_addition.len * 2);
 		}
 		mCTX.buffer_alpha_size = frame_addition.len;
-		ret = frame_addition.Read(mCTX.reader, &mCTX.buffer_alpha[0]);
+		ret = frame_addition.Read(mCTX.source, &buffer_alpha[0]);
 		if (ret)
 		{
 			OutputDebugTrace("%s - failed to read frame\n", __FUNCTION__);
-			return WEBM_STATE::LOAD_ERROR;
+			return false;
 		}
 	}
-	return WEBM_STATE::PLAYING;
+	mStats.AddBytesRead(mCTX.buffer_size + mCTX.buffer_alpha_size);
+	return true;
+}
+
+const mkvparser::BlockEntry *WebmDecoder::_FindKeyFrame(uint64_t timestamp_ns)
+{
+	const mkvparser::Track *track = mCTX.segment->GetTracks()->GetTrackByNumber(mCTX.video_track_index);
+	const long long time_ns = static_cast<long long>(timestamp_ns);
+
+	// Cues가 있으면 해당 클러스터만 불러온다
+	const mkvparser::Cues *cues = mCTX.segment->GetCues();
+	const mkvparser::CuePoint *cue = nullptr;
+	const mkvparser::CuePoint::TrackPosition *position = nullptr;
+	if (cues && cues->Find(time_ns, track, cue, position))
+	{
+		const mkvparser::Cluster *cluster = mCTX.segment->FindOrPreloadCluster(position->m_pos);
+		const mkvparser::BlockEntry *entry = (cluster) ? cluster->GetEntry(*cue, *position) : nullptr;
+		if (entry && !entry->EOS())
+			return entry;
+	}
+
+	// Cues가 없으면 클러스터를 모두 불러와서 블록의 키 프레임 표시로 찾는다
+	if (!mCTX.segment->DoneParsing() && mCTX.segment->Load() < 0)
+		return nullptr;
+
+	const mkvparser::BlockEntry *entry = nullptr;
+	if (track->Seek(time_ns, entry) < 0 || !entry || entry->EOS())
+		return nullptr;
+	return entry;
+}
+
+bool WebmDecoder::_DecodeThumbnail(const mkvparser::BlockEntry *entry, uint32_t size, Thumbnail &thumbnail)
+{
+	const mkvparser::Block *block = entry->GetBlock();
+	if (!_ReadBlockData(block, 0) || !_DecodeVPX() || !mCTX.img)
+		return false;
+
+	// 긴 변을 size에 맞추고 키우지는 않는다
+	const uint32_t width = mCTX.img->d_w;
+	const uint32_t height = mCTX.img->d_h;
+	const uint32_t longest = (width > height) ? width : height;
+	thumbnail.timestamp_ns = block->GetTime(entry->GetCluster());
+	thumbnail.width = (longest > size) ? std::max<uint32_t>(width * size / longest, 1) : width;
+	thumbnail.height = (longest > size) ? std::max<uint32_t>(height * size / longest, 1) : height;
+	thumbnail.pixels.resize(thumbnail.width * thumbnail.height * 4);
+
+	const unsigned char *a = (mCTX.img_alpha) ? mCTX.img_alpha->planes[VPX_PLANE_Y] : nullptr;
+	const int strideA = (mCTX.img_alpha) ? mCTX.img_alpha->stride[VPX_PLANE_Y] : 0;
+	yuv420_rgba_scale_std(width, height,
+		mCTX.img->planes[VPX_PLANE_Y], mCTX.img->planes[VPX_PLANE_U], mCTX.img->planes[VPX_PLANE_V], a,
+		mCTX.img->stride[VPX_PLANE_Y], mCTX.img->stride[VPX_PLANE_U], mCTX.img->stride[VPX_PLANE_V], strideA,
+		&thumbnail.pixels[0], thumbnail.width, thumbnail.height, thumbnail.width * 4, YCBCR_JPEG);
+	return true;
+}
+
+bool WebmDecoder::_DecodeVPX()
+{
+	mCTX.img = nullptr;
+	mCTX.img_alpha = nullptr;
+	mCTX.iter = nullptr;
+	mCTX.iter_alpha = nullptr;
+
+	DecoderPool::Context *codec = mCTX.codec.get();
+	if (mCTX.buffer_alpha_size > 0 && !DecoderPool::InitAlpha(codec))
+	{
+		OutputDebugTrace("%s - failed to initialize alpha decoder\n", __FUNCTION__);
+		mCTX.state = WEBM_STATE::LOAD_ERROR;
+		return false;
+	}
+	{
+		WEBM_STAGE_TIMER(mStats, STAGE_DECODE);
+		WEBM_TRACE_SCOPE("decode", mTraceId, mCTX.frame_index);
+		if (vpx_codec_decode(&codec->decoder, &codec->buffer[0], mCTX.buffer_size, nullptr, 0))
+		{
+			_PrintError(&codec->decoder, "failed to decode frame");
+			mCTX.state = WEBM_STATE::LOAD_ERROR;
+			return false;
+		}
+		mCTX.img = vpx_codec_get_frame(&codec->decoder, &mCTX.iter);
+	}
+
+	if (mCTX.buffer_alpha_size > 0)
+	{
+		WEBM_STAGE_TIMER(mStats, STAGE_DECODE_ALPHA);
+		WEBM_TRACE_SCOPE("decode_alpha", mTraceId, mCTX.frame_index);
+		if (vpx_codec_decode(&codec->decoder_alpha, &codec->buffer_alpha[0], mCTX.buffer_alpha_size, nullptr, 0))
+		{
+			_PrintError(&codec->decoder_alpha, "failed to decode frame");
+			mCTX.state = WEBM_STATE::LOAD_ERROR;
+			return false;
+		}
+		mCTX.img_alpha = vpx_codec_get_frame(&codec->decoder_alpha, &mCTX.iter_alpha);
+	}
+	mCTX.decoded_frame_index = mCTX.frame_index;
+	mStats.AddDecodedFrame();
+	return true;
 }
 
-void WebmDecoder::_ConvertToRGBA()
+WebmDecoder::WEBM_STATE WebmDecoder::_DecodeSharedFrame()
+{
+	const FrameCache::Key key = { mCTX.asset_hash, static_cast<uint64_t>(mCTX.frame_index), FrameCache::FORMAT_RGBA, 1 };
+	bool owner = false;
+	std::shared_ptr<const FrameCache::Frame> frame = mFrameCache->Acquire(key, owner);
+	if (!owner)
+	{
+		mCTX.shared_frame = frame;
+		_SetFrameSize(frame->width, frame->height);
+		return mCTX.state;
+	}
+
+	// 캐시된 프레임을 쓰느라 건너뛴 프레임이 있으면 키 프레임부터 다시 디코딩해서 libvpx 상태를 맞춘다
+	if (!mCTX.is_key_frame && mCTX.decoded_frame_index + 1 != mCTX.frame_index && !_Resync())
+	{
+		mFrameCache->Publish(key, nullptr);
+		mCTX.state = WEBM_STATE::LOAD_ERROR;
+		return mCTX.state;
+	}
+
+	if (!_DecodeVPX() || !mCTX.img)
+	{
+		mFrameCache->Publish(key, nullptr);
+		return mCTX.state;
+	}
+
+	std::shared_ptr<FrameCache::Frame> newFrame = std::make_shared<FrameCache::Frame>();
+	newFrame->width = mCTX.img->d_w;
+	newFrame->height = mCTX.img->d_h;
+	newFrame->stride = newFrame->width * 4;
+	newFrame->pixels.resize(newFrame->stride * newFrame->height);
+	_ConvertToRGBA(&newFrame->pixels[0]);
+
+	mCTX.shared_frame = newFrame;
+	mFrameCache->Publish(key, newFrame);
+	return mCTX.state;
+}
+
+bool WebmDecoder::_Resync()
+{
+	const int64_t target = mCTX.frame_index;
+	mCTX.cluster = mCTX.key_cluster;
+	mCTX.block_entry = mCTX.key_block_entry;
+	mCTX.block = mCTX.key_block_entry->GetBlock();
+	mCTX.block_frame_index = mCTX.key_block_frame_index;
+	mCTX.frame_index = mCTX.key_frame_index - 1;
+
+	while (_ReadFrame() == WEBM_STATE::PLAYING)
+	{
+		if (mCTX.frame_index == target)
+			return true;
+		if (!_DecodeVPX())
+			return false;
+	}
+	return false;
+}
+
+bool WebmDecoder::_IsBehindSchedule()
+{
+	// 다음 프레임이 나갈 시간이 이미 지났는지 본다
+	if (mCTX.frame_duration_ns == 0)
+		return false;
+
+	return static_cast<int64_t>(_ToPresentationTime(mCTX.media_timestamp_ns + mCTX.frame_duration_ns)) <= _GetPlaybackTime();
+}
+
+bool WebmDecoder::_IsSkippedBlock()
+{
+	// 키 프레임만 디코딩하는 동안에는 나머지 블록을 읽지 않고 넘긴다
+	if (mCTX.block->IsKey())
+	{
+		mCTX.wait_key_frame = false;
+		return false;
+	}
+	if (mCTX.playback_rate < KEYFRAME_ONLY_RATE && !mCTX.wait_key_frame)
+		return false;
+
+	_ReleaseLoopClip();
+	mCTX.frame_index += mCTX.block->GetFrameCount() - mCTX.block_frame_index;
+	mCTX.block_frame_index = mCTX.block->GetFrameCount();
+	mCTX.dropped_frames++;
+	return true;
+}
+
+bool WebmDecoder::_IsDroppable()
+{
+	if (mCTX.fourcc != VP9_FOURCC)
+		return false;
+	if (!vp9_is_droppable(&mCTX.codec->buffer[0], mCTX.buffer_size))
+		return false;
+	return mCTX.buffer_alpha_size == 0 || vp9_is_droppable(&mCTX.codec->buffer_alpha[0], mCTX.buffer_alpha_size);
+}
+
+uint64_t WebmDecoder::_ToPresentationTime(uint64_t media_timestamp_ns)
+{
+	// 역재생은 기준 위치에서 앞쪽으로 시간이 흐른다
+	if (mCTX.is_reverse)
+	{
+		if (media_timestamp_ns >= mCTX.base_media_timestamp_ns)
+			return 0;
+		return static_cast<uint64_t>((mCTX.base_media_timestamp_ns - media_timestamp_ns) / static_cast<double>(mCTX.playback_rate));
+	}
+
+	if (media_timestamp_ns <= mCTX.base_media_timestamp_ns)
+		return 0;
+	return static_cast<uint64_t>((media_timestamp_ns - mCTX.base_media_timestamp_ns) / static_cast<double>(mCTX.playback_rate));
+}
+
+void WebmDecoder::_ResetTimeline()
+{
+	mCTX.begin_timestamp_ns = _GetTime();
+	mCTX.base_media_timestamp_ns = 0;
+}
+
+vpx_codec_iface_t *WebmDecoder::_GetCodecInterface()
+{
+	return (mCTX.fourcc == VP9_FOURCC) ? vpx_codec_vp9_dx() : vpx_codec_vp8_dx();
+}
+
+bool WebmDecoder::_OpenReverseDecoder()
+{
+	if (mCTX.reverse_decoder)
+		return true;
+
+	mCTX.reverse_decoder = new ReverseDecoder();
+	mCTX.reverse_decoder->SetMemoryBudget(mReverseMemoryBudget);
+	if (!mCTX.reverse_decoder->Open(mCTX.file_name, _GetCodecInterface(), mCTX.video_track_index,
+		mCTX.video_width, mCTX.video_height, YUVtoRGBAFunc))
+	{
+		OutputDebugTrace("%s - failed to open reverse decoder.\n", __FUNCTION__);
+		SAFE_DELETE(mCTX.reverse_decoder);
+		return false;
+	}
+	return true;
+}
+
+bool WebmDecoder::_BeginReverse(int64_t from, int64_t to)
+{
+	if (!_OpenReverseDecoder())
+		return false;
+
+	// 역재생하는 동안에는 루프 캐시를 채울 수 없다
+	_ReleaseLoopClip();
+	mCTX.is_loop_cached = false;
+	mCTX.reverse_decoder->Start(from, to);
+	mCTX.is_reverse = true;
+
+	// 마지막으로 보여준 프레임에서부터 거꾸로 흐르는 시간축을 잡는다
+	mCTX.base_media_timestamp_ns = mCTX.media_timestamp_ns;
+	mCTX.begin_timestamp_ns = _GetTime();
+	return true;
+}
+
+WebmDecoder::WEBM_STATE WebmDecoder::_ReadReverseFrame()
+{
+	const ReverseDecoder::Frame *frame = mCTX.reverse_decoder->Next();
+
+	// 이미 지난 프레임과 화면에 나가지 않는 프레임은 넘긴다
+	const int64_t systemTime = _GetPlaybackTime();
+	while (frame)
+	{
+		const ReverseDecoder::Frame *next = mCTX.reverse_decoder->Peek();
+		if (frame->width > 0 && (!next || static_cast<int64_t>(_ToPresentationTime(next->timestamp_ns)) > systemTime))
+			break;
+		if (frame->width > 0)
+			mCTX.dropped_frames++;
+		frame = mCTX.reverse_decoder->Next();
+	}
+
+	if (!frame)
+	{
+		// 처음에 닿았다
+		if (mPingPong && mCTX.is_play_loop)
+		{
+			Restart();
+			return DecodeFrame();
+		}
+		if (!mCTX.is_play_loop)
+		{
+			mCTX.state = WEBM_STATE::END;
+			return mCTX.state;
+		}
+
+		mCTX.reverse_decoder->Start(-1, 0);
+		frame = mCTX.reverse_decoder->Next();
+		if (!frame || frame->width == 0)
+		{
+			mCTX.state = WEBM_STATE::END;
+			return mCTX.state;
+		}
+		mCTX.base_media_timestamp_ns = frame->timestamp_ns;
+		mCTX.begin_timestamp_ns = _GetTime();
+	}
+
+	uint8_t *pixels = _GetPixelBuffer(frame->width, frame->height);
+	if (!pixels)
+	{
+		mCTX.state = WEBM_STATE::LOAD_ERROR;
+		return mCTX.state;
+	}
+	mCTX.reverse_decoder->Convert(frame, pixels, frame->width * 4);
+
+	mCTX.shared_frame = nullptr;
+	mCTX.frame_index = frame->frame_index;
+	_SetFrameSize(frame->width, frame->height);
+	mCTX.media_timestamp_ns = frame->timestamp_ns;
+	mCTX.timestamp_ns = _ToPresentationTime(frame->timestamp_ns);
+	mCTX.state = WEBM_STATE::PLAYING;
+	return mCTX.state;
+}
+
+bool WebmDecoder::_SeekForward(int64_t target)
+{
+	int64_t keyIndex = 0;
+	uint64_t keyTimestamp = 0;
+	if (!mCTX.reverse_decoder || !mCTX.reverse_decoder->FindKeyFrame(target, keyIndex, keyTimestamp))
+		return false;
+
+	// 역재생용 세그먼트에서 찾은 키 프레임을 재생용 세그먼트에서 다시 찾는다
+	const mkvparser::Cluster *keyCluster = nullptr;
+	for (const mkvparser::Cluster *cluster = mCTX.segment->GetFirst(); cluster && !cluster->EOS(); cluster = mCTX.segment->GetNext(cluster))
+	{
+		if (cluster->GetTime() > static_cast<long long>(keyTimestamp))
+			break;
+		keyCluster = cluster;
+	}
+	if (!keyCluster)
+		return false;
+
+	const mkvparser::BlockEntry *entry = nullptr;
+	keyCluster->GetFirst(entry);
+	while (entry && !entry->EOS())
+	{
+		const mkvparser::Block *block = entry->GetBlock();
+		if (block->GetTrackNumber() == mCTX.video_track_index && block->IsKey() &&
+			block->GetTime(keyCluster) == static_cast<long long>(keyTimestamp))
+		{
+			break;
+		}
+		keyCluster->GetNext(entry, entry);
+	}
+	if (!entry || entry->EOS())
+	{
+		OutputDebugTrace("%s - failed to find key frame\n", __FUNCTION__);
+		return false;
+	}
+
+	const uint64_t shown_timestamp_ns = mCTX.media_timestamp_ns;
+	mCTX.is_reverse = false;
+	mCTX.cluster = keyCluster;
+	mCTX.block_entry = entry;
+	mCTX.block = entry->GetBlock();
+	mCTX.block_frame_index = 0;
+	mCTX.frame_index = keyIndex - 1;
+	mCTX.decoded_frame_index = keyIndex - 1;
+	_PrefetchClusters();
+
+	// 키 프레임부터 보여준 프레임까지는 변환 없이 디코딩만 한다
+	while (mCTX.frame_index + 1 < target)
+	{
+		if (_ReadFrame() != WEBM_STATE::PLAYING || !_DecodeVPX())
+		{
+			mCTX.state = WEBM_STATE::LOAD_ERROR;
+			return false;
+		}
+	}
+
+	mCTX.base_media_timestamp_ns = shown_timestamp_ns;
+	mCTX.begin_timestamp_ns = _GetTime();
+	mCTX.media_timestamp_ns = shown_timestamp_ns;
+	mCTX.timestamp_ns = 0;
+	return true;
+}
+
+void WebmDecoder::_ConvertToRGBA(uint8_t *dst /*= nullptr*/)
 {
 	if (!mCTX.img)
 		return;
@@ -361,10 +1440,14 @@ void WebmDecoder::_ConvertToRGBA()
 	const unsigned int width = mCTX.img->d_w;
 	const unsigned int height = mCTX.img->d_h;
 
-	int pixels = 0;
-	if (!mCTX.pixels)
+	// 바뀐 영역은 디코더가 가진 출력 버퍼에 변환할 때만 쓴다. 프레임 캐시로 나가는 프레임은 매번 새 버퍼다
+	const bool tracking = mDirtyTracking && !dst;
+	if (!dst)
 	{
-		mCTX.pixels = new unsigned char[width * height * 4];
+		dst = _GetPixelBuffer(width, height);
+		if (!dst)
+			return;
+		mCTX.shared_frame = nullptr;
 	}
 
 	const unsigned char *y = mCTX.img->planes[VPX_PLANE_Y];
@@ -377,11 +1460,270 @@ void WebmDecoder::_ConvertToRGBA()
 	const int strideV = mCTX.img->stride[VPX_PLANE_V];
 	const int strideA = (mCTX.img_alpha) ? mCTX.img_alpha->stride[VPX_PLANE_Y] : 0;
 
-	YUVtoRGBAFunc(width, height, y, u, v, a, strideY, strideU, strideV, strideA, mCTX.pixels, width * 4, YCBCR_JPEG);
+	int constantAlpha = -1;
+	bool uniformAlpha = true;
+	bool partial = false;
+	const DirtyTracker::Rect frameRect = { 0, 0, width, height };
+	{
+		WEBM_STAGE_TIMER(mStats, STAGE_CONVERT);
+		WEBM_TRACE_SCOPE("convert", mTraceId, mCTX.frame_index);
+
+		// 페이드 구간처럼 알파 평면 전체가 한 값이면 픽셀마다 알파를 섞지 않는다.
+		// 모두 255면 알파 없는 커널로 변환하고, 모두 0이면 색상이 보이지 않으므로 변환하지 않고 0으로 채운다
+		if (a)
+		{
+			constantAlpha = AlphaConstantFunc(width, height, a, strideA);
+			uniformAlpha = constantAlpha == 0 || constantAlpha == 255;
+		}
+
+		// 직전에 변환한 프레임이 버퍼에 그대로 남아 있으면 바뀐 블록만 다시 변환한다.
+		// 평면은 비교하지 못한 프레임에서도 갱신해야 다음 프레임과 비교할 수 있다
+		if (tracking)
+			partial = mCTX.dirty_tracker.Update(width, height, y, u, v, a, strideY, strideU, strideV, strideA) && mCTX.dirty_base == dst;
+
+		const std::vector<DirtyTracker::Rect> &dirtyRects = mCTX.dirty_tracker.GetRects();
+		const DirtyTracker::Rect *rects = (partial) ? dirtyRects.data() : &frameRect;
+		const size_t rectCount = (partial) ? dirtyRects.size() : 1;
+		for (size_t i = 0; i < rectCount; ++i)
+		{
+			// 사각형은 32픽셀 경계에서 시작하므로 평면 포인터가 커널의 정렬 로드 조건을 그대로 만족한다
+			const DirtyTracker::Rect &rect = rects[i];
+			const uint32_t rectWidth = rect.right - rect.left;
+			uint8_t *rgba = dst + (static_cast<size_t>(rect.top) * width + rect.left) * 4;
+			if (constantAlpha == 0)
+			{
+				for (uint32_t row = 0; row < rect.bottom - rect.top; ++row)
+					memset(rgba + static_cast<size_t>(row) * width * 4, 0, rectWidth * 4);
+				continue;
+			}
+
+			// 알파가 한 값이면 분포는 변환한 뒤에 바로 채우고, 일부만 변환하면 프레임 전체의 분포를 구할 수 없다
+			YUVtoRGBAFunc(rectWidth, rect.bottom - rect.top,
+				y + rect.top * strideY + rect.left,
+				u + rect.top / 2 * strideU + rect.left / 2,
+				v + rect.top / 2 * strideV + rect.left / 2,
+				(constantAlpha == 255 || !a) ? nullptr : a + rect.top * strideA + rect.left,
+				strideY, strideU, strideV, strideA, rgba, width * 4, YCBCR_JPEG, (partial || uniformAlpha) ? nullptr : &mCTX.alpha_coverage);
+		}
+	}
+	_SetFrameSize(width, height);
+
+	if (constantAlpha == 0 || constantAlpha == 255)
+		mStats.AddConstantAlphaFrame(constantAlpha == 0);
+
+	if (tracking)
+	{
+		if (partial)
+		{
+			mCTX.dirty_region.base_frame_index = mCTX.dirty_base_frame_index;
+			mCTX.dirty_region.rects = mCTX.dirty_tracker.GetRects();
+		}
+		mCTX.dirty_base = dst;
+		mCTX.dirty_base_frame_index = mCTX.frame_index;
+		mStats.AddDirtyRegion(static_cast<uint64_t>(width) * height, (partial) ? mCTX.dirty_tracker.GetDirtyPixels() : static_cast<uint64_t>(width) * height);
+	}
+
+	if (uniformAlpha)
+		alpha_coverage_fill(&mCTX.alpha_coverage, width, height, (a) ? static_cast<uint8_t>(constantAlpha) : 255);
+	else if (partial)
+		return;
+
+	const AlphaCoverage &coverage = mCTX.alpha_coverage;
+	mCTX.has_alpha_coverage = true;
+	mStats.AddAlphaCoverage(static_cast<uint64_t>(width) * height,
+		static_cast<uint64_t>(coverage.right - coverage.left) * (coverage.bottom - coverage.top),
+		coverage.opaque_tiles, coverage.transparent_tiles, coverage.mixed_tiles);
+}
+
+bool WebmDecoder::_OnLoopRestart()
+{
+	if (mCTX.is_loop_builder)
+	{
+		mLoopCache->EndBuild(mCTX.loop_clip.get(), true);
+		mCTX.is_loop_builder = false;
+	}
+
+	// 다른 디코더가 채운 캐시도 루프가 돌아오는 시점부터 사용한다
+	if (!mCTX.loop_clip || !mCTX.loop_clip->complete)
+		return false;
+
+	mCTX.is_loop_cached = true;
+	mCTX.loop_frame_index = 0;
+	return true;
+}
+
+WebmDecoder::WEBM_STATE WebmDecoder::_ReadCachedFrame()
+{
+	const LoopCache::Clip *clip = mCTX.loop_clip.get();
+	if (mCTX.loop_frame_index >= clip->frames.size())
+	{
+		mCTX.loop_frame_index = 0;
+		_ResetTimeline();
+	}
+
+	// 캐시된 프레임은 디코딩 상태가 없으므로 이미 지난 프레임은 그냥 넘긴다
+	const int64_t systemTime = _GetPlaybackTime();
+	while (mCTX.loop_frame_index + 1 < clip->frames.size() &&
+		static_cast<int64_t>(_ToPresentationTime(clip->frames[mCTX.loop_frame_index + 1].timestamp_ns)) <= systemTime)
+	{
+		mCTX.loop_frame_index++;
+		mCTX.dropped_frames++;
+	}
+
+	const LoopCache::Frame &frame = clip->frames[mCTX.loop_frame_index];
+	uint8_t *pixels = _GetPixelBuffer(frame.width, frame.height);
+	if (!pixels || !mLoopCache->ReadFrame(clip, mCTX.loop_frame_index, pixels))
+	{
+		OutputDebugTrace("%s - failed to read cached frame\n", __FUNCTION__);
+		mCTX.state = WEBM_STATE::LOAD_ERROR;
+		return mCTX.state;
+	}
+
+	mCTX.loop_frame_index++;
+	mCTX.shared_frame = nullptr;
+	_SetFrameSize(frame.width, frame.height);
+	mCTX.media_timestamp_ns = frame.timestamp_ns;
+	mCTX.timestamp_ns = _ToPresentationTime(frame.timestamp_ns);
+	mCTX.state = WEBM_STATE::PLAYING;
+	return mCTX.state;
+}
+
+uint8_t *WebmDecoder::_GetFramePixels()
+{
+	if (mCTX.shared_frame)
+		return const_cast<uint8_t*>(mCTX.shared_frame->pixels.data());
+	return mCTX.frame.GetData();
+}
+
+uint8_t *WebmDecoder::_GetPixelBuffer(uint32_t width, uint32_t height)
+{
+	// 해상도가 커질 때만 더 큰 등급의 버퍼로 바꾸고, 작아지면 지금 버퍼를 그대로 쓴다
+	if (!mCTX.frame.Allocate(mBufferPool, width, height, width * 4, Frame::FORMAT_RGBA))
+	{
+		OutputDebugTrace("%s - failed to allocate %ux%u frame\n", __FUNCTION__, width, height);
+		return nullptr;
+	}
+	return mCTX.frame.GetData();
+}
+
+void WebmDecoder::_SetFrameSize(uint32_t width, uint32_t height)
+{
+	// 프레임이 바뀔 때마다 불린다. 직접 변환한 프레임이면 _ConvertToRGBA가 다시 켠다
+	mCTX.has_alpha_coverage = false;
+	mCTX.dirty_base = nullptr;
+	mCTX.dirty_region.base_frame_index = -1;
+	mCTX.dirty_region.rects.assign(1, { 0, 0, width, height });
+	if (width != mCTX.frame_width || height != mCTX.frame_height)
+		mCTX.geometry_version++;
+	mCTX.frame_width = width;
+	mCTX.frame_height = height;
+}
+
+void WebmDecoder::_ReleaseLoopClip()
+{
+	if (mCTX.is_loop_builder)
+		mLoopCache->EndBuild(mCTX.loop_clip.get(), false);
+	mCTX.is_loop_builder = false;
 }
 
 uint64_t WebmDecoder::_GetTime()
 {
-	std::chrono::milliseconds now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-	return now.count();
+	return mClock->Now();
+}
+
+int64_t WebmDecoder::_GetPlaybackTime()
+{
+	// 다음 항목으로 넘어간 직후에는 시작 시각이 앞 항목의 마지막 프레임이 끝나는 미래라서 음수가 된다
+	return static_cast<int64_t>(_GetTime() - mCTX.begin_timestamp_ns);
+}
+
+void WebmDecoder::_PreloadNext()
+{
+	size_t next = mPlaylistIndex + 1;
+	if (next == mPlaylist.size())
+	{
+		if (!mPlaylistLoop)
+			return;
+		next = 0;
+	}
+
+	if (!mNextDecoder)
+		mNextDecoder.reset(new WebmDecoder());
+
+	// 넘어간 뒤 그대로 이어서 쓰므로 같은 설정으로 연다
+	WebmDecoder *decoder = mNextDecoder.get();
+	decoder->mFrameCache = mFrameCache;
+	decoder->mLazyLoad = mLazyLoad;
+	decoder->mPrefetchClusters = mPrefetchClusters;
+	decoder->mClock = mClock;
+	decoder->mDecoderPool = mDecoderPool;
+	decoder->mBufferPool = mBufferPool;
+	decoder->mDirtyTracking = mDirtyTracking;
+	mNextIndex = next;
+
+	const std::string fileName = mPlaylist[next];
+	const float playbackRate = mCTX.playback_rate;
+	mPreloadThread = std::thread([decoder, fileName, playbackRate]() {
+		// Load가 먼저 끝난 항목의 컨텍스트를 정리한다
+		if (decoder->Load(fileName, false, playbackRate))
+			decoder->_Preroll();
+	});
+}
+
+bool WebmDecoder::_Preroll()
+{
+	mCTX.state = _ReadFrame();
+	if (mCTX.state != WEBM_STATE::PLAYING)
+		return false;
+
+	if (mFrameCache)
+		return _DecodeSharedFrame() == WEBM_STATE::PLAYING;
+
+	if (!_DecodeVPX())
+		return false;
+	_ConvertToRGBA();
+	return true;
+}
+
+bool WebmDecoder::_SwitchToNext()
+{
+	if (mPreloadThread.joinable())
+		mPreloadThread.join();
+
+	if (!mNextDecoder->mCTX.file || mNextDecoder->mCTX.state != WEBM_STATE::PLAYING)
+	{
+		OutputDebugTrace("%s - failed to preload %s.\n", __FUNCTION__, mPlaylist[mNextIndex].c_str());
+		return false;
+	}
+
+	// 현재 항목의 마지막 프레임이 끝나는 시각에 다음 항목의 첫 프레임이 나가도록 시간을 이어 붙인다
+	// 보통 마지막 프레임이 화면에 있는 동안 넘어오므로 시작 시각은 미래가 되고, 그때까지는 다음 프레임이 due가 아니다
+	const uint64_t end_timestamp_ns = mCTX.begin_timestamp_ns + mCTX.timestamp_ns +
+		static_cast<uint64_t>(mCTX.frame_duration_ns / mCTX.playback_rate);
+	const float playbackRate = mCTX.playback_rate;
+	const uint64_t droppedFrames = mCTX.dropped_frames;
+	const uint64_t lateFrames = mCTX.late_frames;
+
+	std::swap(mCTX, mNextDecoder->mCTX);
+	mCTX.playback_rate = playbackRate;
+	mCTX.begin_timestamp_ns = end_timestamp_ns;
+	mCTX.base_media_timestamp_ns = mCTX.media_timestamp_ns;
+	mCTX.timestamp_ns = 0;
+	mCTX.dropped_frames += droppedFrames;
+	mCTX.late_frames += lateFrames;
+	mPlaylistIndex = mNextIndex;
+
+	_PreloadNext();
+	return true;
+}
+
+void WebmDecoder::_ReleasePlaylist()
+{
+	if (mPreloadThread.joinable())
+		mPreloadThread.join();
+	mNextDecoder = nullptr;
+	mPlaylist.clear();
+	mPlaylistIndex = 0;
+	mPlaylistLoop = false;
+	mNextIndex = 0;
 }
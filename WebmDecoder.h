@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <vp8.h>
 #include <vp8dx.h>
@@ -9,10 +11,22 @@
 #include <mkvreader.h>
 #include <mkvmuxer.h>
 #include "YUVtoRGB.h"
+#include "LoopCache.h"
+#include "FrameCache.h"
+#include "PrefetchReader.h"
+#include "Clock.h"
+#include "ReverseDecoder.h"
+#include "DecoderPool.h"
+#include "BufferPool.h"
+#include "Frame.h"
+#include "DecoderStats.h"
+#include "DirtyTracker.h"
 
 #define SAFE_DELETE(p)       { if(p) { delete (p);     (p)=NULL; } }
 #define SAFE_DELETE_ARRAY(p) { if(p) { delete[] (p);   (p)=NULL; } }
 
+class ThreadPool;
+
 const uint32_t VP8_FOURCC = 0x30385056;
 const uint32_t VP9_FOURCC = 0x30395056;
 
@@ -27,72 +41,173 @@ public:
 		END,
 	};
 
+	struct PlaybackStats
+	{
+		uint64_t dropped_frames;
+		uint64_t late_frames;
+		uint64_t load_ns;	// 마지막 Load에 걸린 시간
+	};
+
+	// GetRGBA와 같은 프레임을 가리킨다. 해상도가 바뀔 때마다 geometry_version이 늘어난다
+	struct FrameDesc
+	{
+		int64_t frame_index;
+		uint64_t timestamp_ns;	// 재생 시작 기준 표시 시간
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;
+		uint32_t geometry_version;
+		const uint8_t *pixels;
+	};
+
+	// Probe 결과. 디코더를 만들지 않고 헤더만 읽어서 채운다
+	struct MediaInfo
+	{
+		uint64_t duration_ns;
+		uint64_t frame_count;	// DefaultDuration이 없으면 0
+		uint32_t width;
+		uint32_t height;
+		uint32_t fourcc;
+		int framerate_numerator;
+		int framerate_denominator;
+		bool has_alpha;
+	};
+
+	// 현재 프레임이 base_frame_index 프레임에서 바뀐 영역. 이 사각형만 다시 올리면 된다.
+	// base_frame_index가 -1이면 이전 프레임과 비교하지 못한 것으로, 프레임 전체 사각형 하나가 들어 있다
+	struct DirtyRegion
+	{
+		int64_t base_frame_index;
+		std::vector<DirtyTracker::Rect> rects;
+	};
+
+	struct Thumbnail
+	{
+		uint64_t timestamp_ns;	// 실제로 디코딩한 키 프레임의 시간
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> pixels;
+	};
+
 private:
 	struct webm_context
 	{
 		FILE *file;
-		vpx_codec_ctx_t decoder;
-		vpx_codec_ctx_t decoder_alpha;
+		std::string file_name;
+		std::shared_ptr<DecoderPool::Context> codec;
 		vpx_codec_iter_t iter;
 		vpx_codec_iter_t iter_alpha;
 		vpx_image_t *img;
 		vpx_image_t *img_alpha;
 		mkvparser::MkvReader *reader;
+		PrefetchReader *prefetch_reader;
+		ReverseDecoder *reverse_decoder;
+		mkvparser::IMkvReader *source;
 		mkvparser::Segment *segment;
 		const mkvparser::Cluster *cluster;
 		const mkvparser::Block *block;
 		const mkvparser::BlockEntry *block_entry;
-		uint8_t *pixels;
-		std::vector<uint8_t> buffer;
-		std::vector<uint8_t> buffer_alpha;
+		const mkvparser::Cluster *key_cluster;
+		const mkvparser::BlockEntry *key_block_entry;
+		Frame frame;	// 출력 버퍼. 첫 프레임을 변환하기 전이나 GetFrame으로 넘겨준 뒤에는 비어 있다
+		std::shared_ptr<const FrameCache::Frame> shared_frame;
+		std::shared_ptr<LoopCache::Clip> loop_clip;
+		AlphaCoverage alpha_coverage;	// 마지막으로 변환한 프레임의 알파 분포
+		DirtyTracker dirty_tracker;
+		DirtyRegion dirty_region;
+		const uint8_t *dirty_base;	// dirty_tracker의 평면을 변환한 프레임이 그대로 남아 있는 출력 버퍼. 없으면 nullptr
+		int64_t dirty_base_frame_index;
 		uint32_t buffer_size;
 		uint32_t buffer_alpha_size;
 		WEBM_STATE state;
 		int block_frame_index;
+		int key_block_frame_index;
+		int64_t frame_index;
+		int64_t key_frame_index;
+		int64_t decoded_frame_index;
+		uint64_t asset_hash;
 		int video_track_index;
 		uint32_t fourcc;
 		uint32_t video_width;
 		uint32_t video_height;
+		uint32_t frame_width;
+		uint32_t frame_height;
+		uint32_t geometry_version;
 		int framerate_numerator;
 		int framerate_denominator;
-		float frame_rate;
-		uint64_t timestamp_ms;
-		uint64_t begin_timestamp_ms;
+		float playback_rate;
+		uint64_t timestamp_ns;
+		uint64_t media_timestamp_ns;
+		uint64_t base_media_timestamp_ns;
+		uint64_t begin_timestamp_ns;
+		uint64_t frame_duration_ns;
+		uint64_t dropped_frames;
+		uint64_t late_frames;
+		size_t loop_frame_index;
 		bool is_key_frame;
 		bool is_play_loop;
+		bool is_looped;
+		bool is_loop_builder;
+		bool is_loop_cached;
+		bool wait_key_frame;
+		bool is_reverse;
+		bool has_alpha_coverage;	// 현재 프레임이 alpha_coverage를 구한 프레임인지
 
 		webm_context()
 		{
 			file = nullptr;
-			decoder.iface = nullptr;
-			decoder_alpha.iface = nullptr;
 			img = nullptr;
 			img_alpha = nullptr;
 			iter = nullptr;
 			iter_alpha = nullptr;
 			reader = nullptr;
+			prefetch_reader = nullptr;
+			reverse_decoder = nullptr;
+			source = nullptr;
 			segment = nullptr;
 			cluster = nullptr;
 			block = nullptr;
 			block_entry = nullptr;
-			pixels = nullptr;
-			buffer.resize(1024 * 256);
-			buffer_alpha.resize(1024 * 256);
+			key_cluster = nullptr;
+			key_block_entry = nullptr;
 			buffer_size = 0;
 			buffer_alpha_size = 0;
 			state = WEBM_STATE::NONE;
 			block_frame_index = 0;
+			key_block_frame_index = 0;
+			frame_index = -1;
+			key_frame_index = 0;
+			decoded_frame_index = -1;
+			asset_hash = 0;
 			video_track_index = 0;
 			fourcc = 0;
 			video_width = 0;
 			video_height = 0;
+			frame_width = 0;
+			frame_height = 0;
+			geometry_version = 0;
 			framerate_numerator = 0;
 			framerate_denominator = 0;
-			//frame_rate = 1.0f;
-			timestamp_ms = 0;
-			begin_timestamp_ms = 0;
+			playback_rate = 1.0f;
+			timestamp_ns = 0;
+			media_timestamp_ns = 0;
+			base_media_timestamp_ns = 0;
+			begin_timestamp_ns = 0;
+			frame_duration_ns = 0;
+			dropped_frames = 0;
+			late_frames = 0;
+			loop_frame_index = 0;
 			is_key_frame = false;
 			is_play_loop = false;
+			is_looped = false;
+			is_loop_builder = false;
+			is_loop_cached = false;
+			wait_key_frame = false;
+			is_reverse = false;
+			has_alpha_coverage = false;
+			dirty_region.base_frame_index = -1;
+			dirty_base = nullptr;
+			dirty_base_frame_index = -1;
 		}
 
 		void Reset()
@@ -102,35 +217,65 @@ private:
 				fclose(file);
 				file = nullptr;
 			}
-			if (decoder.iface)
-				vpx_codec_destroy(&decoder);
-			if (decoder_alpha.iface)
-				vpx_codec_destroy(&decoder_alpha);
+			file_name.clear();
+			codec = nullptr;
 			img = nullptr;
 			img_alpha = nullptr;
 			iter = nullptr;
 			iter_alpha = nullptr;
 			SAFE_DELETE(reader);
+			SAFE_DELETE(prefetch_reader);
+			SAFE_DELETE(reverse_decoder);
+			source = nullptr;
 			SAFE_DELETE(segment);
 			cluster = nullptr;
 			block = nullptr;
 			block_entry = nullptr;
-			SAFE_DELETE_ARRAY(pixels);
+			key_cluster = nullptr;
+			key_block_entry = nullptr;
+			frame.Reset();
+			shared_frame = nullptr;
+			loop_clip = nullptr;
 			buffer_size = 0;
 			buffer_alpha_size = 0;
 			state = WEBM_STATE::NONE;
 			block_frame_index = 0;
+			key_block_frame_index = 0;
+			frame_index = -1;
+			key_frame_index = 0;
+			decoded_frame_index = -1;
+			asset_hash = 0;
 			video_track_index = 0;
 			fourcc = 0;
 			video_width = 0;
 			video_height = 0;
+			frame_width = 0;
+			frame_height = 0;
+			geometry_version = 0;
 			framerate_numerator = 0;
 			framerate_denominator = 0;
-			//frame_rate = 1.0f; LoadVPX 에서 초기화됨
-			timestamp_ms = 0;
-			begin_timestamp_ms = 0;
+			playback_rate = 1.0f;
+			timestamp_ns = 0;
+			media_timestamp_ns = 0;
+			base_media_timestamp_ns = 0;
+			begin_timestamp_ns = 0;
+			frame_duration_ns = 0;
+			dropped_frames = 0;
+			late_frames = 0;
+			loop_frame_index = 0;
 			is_key_frame = false;
 			is_play_loop = false;
+			is_looped = false;
+			is_loop_builder = false;
+			is_loop_cached = false;
+			wait_key_frame = false;
+			is_reverse = false;
+			has_alpha_coverage = false;
+			dirty_tracker.Reset();
+			dirty_region.base_frame_index = -1;
+			dirty_region.rects.clear();
+			dirty_base = nullptr;
+			dirty_base_frame_index = -1;
 		}
 	};
 
@@ -139,29 +284,152 @@ public:
 	~WebmDecoder();
 
 public:
-	bool Load(const std::string &fileName, bool loop, float frameRate = 1.0f);
+	bool Load(const std::string &fileName, bool loop, float playbackRate = 1.0f);
+	// 목록을 끊김 없이 이어서 재생한다. 다음 항목은 백그라운드에서 열어 첫 프레임까지 디코딩해두고,
+	// 현재 항목의 마지막 프레임이 끝나는 시각에 넘어가며 재생 시간도 그대로 이어진다
+	bool LoadPlaylist(const std::vector<std::string> &fileNames, bool loop, float playbackRate = 1.0f);
+	// 재생 중인 플레이리스트 항목 번호
+	size_t GetPlaylistIndex();
 	bool IsInitialized();
 	WEBM_STATE Update();
+	bool IsFrameDue();
+	WEBM_STATE DecodeFrame();
 	void Stop();
 	void Restart();
 	std::tuple<int, int, uint8_t*> GetRGBA();
+	FrameDesc GetFrameDesc();
+	// 현재 프레임을 변환하면서 구한 알파 사각형과 타일 분류. 업로드를 사각형으로 자르거나 불투명 타일의 블렌딩을 끌 때 쓴다.
+	// 프레임 캐시, 루프 캐시, 역재생에서 꺼낸 프레임처럼 이 디코더가 변환하지 않은 프레임이면 nullptr
+	const AlphaCoverage *GetAlphaCoverage();
+	// 직전에 나온 프레임에서 바뀐 영역. SetDirtyTracking을 켜지 않았거나 캐시, 역재생에서 꺼낸 프레임이면 프레임 전체다
+	const DirtyRegion &GetDirtyRegion();
+	// 현재 프레임의 소유권을 넘겨받는다. 이후 GetRGBA는 다음 프레임이 나올 때까지 nullptr을 돌려주고,
+	// 디코더는 다음 프레임을 풀에서 받은 새 버퍼에 변환한다. 프레임 캐시를 쓰는 중이면 복사본을 준다
+	Frame GetFrame();
+	// 재생 중에도 바꿀 수 있다. 빠르게 재생할 때는 보여주지 않을 프레임의 디코딩을 건너뛴다
+	bool SetPlaybackRate(float rate);
+	float GetPlaybackRate();
+	// 재생 중에 방향을 바꾼다. 역재생은 GOP 단위로 미리 디코딩해둔 프레임을 거꾸로 꺼낸다
+	bool SetReverse(bool reverse);
+	bool IsReverse();
+	// Load 전에 설정한다. 루프 재생이 끝에 닿으면 처음으로 돌아가지 않고 거꾸로 재생한다
+	void SetPingPong(bool pingPong);
+	// 역재생에서 디코딩한 I420 구간을 담아둘 메모리 상한. 긴 GOP는 압축한 체크포인트가 그 절반까지 더 쓴다
+	void SetReverseMemoryBudget(size_t bytes);
+
+	// EBML 헤더, Segment Info, Tracks, Cues만 읽는다. libvpx 디코더는 초기화하지 않는다
+	static bool Probe(const std::string &fileName, MediaInfo &info);
+	// 여러 파일을 pool에서 나눠서 처리한다. 실패한 파일은 fourcc가 0이다
+	static void Probe(ThreadPool &pool, const std::vector<std::string> &fileNames, std::vector<MediaInfo> &infos);
+
+	// 요청한 시간마다 그 이전의 가장 가까운 키 프레임 하나만 디코딩해서 긴 변이 size 이하가 되도록 줄인다.
+	// thumbnails는 timestamps_ns와 같은 순서로 채워진다.
+	// decoderPool이 있으면 libvpx 디코더를 거기서 받아서 돌려준다
+	static bool ExtractThumbnails(const std::string &fileName, const std::vector<uint64_t> &timestamps_ns, uint32_t size,
+		std::vector<Thumbnail> &thumbnails, DecoderPool *decoderPool = nullptr);
+	// 여러 파일을 pool에서 나눠서 처리하고 디코더는 decoderPool에서 같이 쓴다. 파일마다 디코더를 새로 만들지 않으려면
+	// decoderPool이 pool의 스레드 수만큼 남겨둘 수 있어야 한다. 실패한 파일은 빈 목록이 된다
+	static void ExtractThumbnails(ThreadPool &pool, DecoderPool &decoderPool, const std::vector<std::string> &fileNames,
+		const std::vector<uint64_t> &timestamps_ns, uint32_t size, std::vector<std::vector<Thumbnail>> &thumbnails);
+	// 따라잡느라 변환하지 않고 버린 프레임 수와, 다음 프레임 시간이 지난 뒤에 나온 프레임 수
+	PlaybackStats GetPlaybackStats();
+	// 마지막 Load 이후 단계별 지연(p50/p99/max)과 디코딩, 드롭, 지연 프레임 수, 읽은 바이트, 알파 분포와 바뀐 영역 합계.
+	// WEBM_ENABLE_STATS가 0이면 단계별 지연은 비어 있다
+	DecoderStats::Snapshot GetStats();
+	// Load 전에 설정한다. 루프 재생 클립은 첫 루프 이후 cache에서 프레임을 꺼낸다
+	void SetLoopCache(LoopCache *cache, LoopCache::STORAGE storage = LoopCache::RAW);
+	// Load 전에 설정한다. 같은 에셋의 같은 프레임은 캐시를 공유하는 디코더 중 하나만 디코딩한다
+	void SetFrameCache(FrameCache *cache);
+	// Load 전에 설정한다. 전체 클러스터를 미리 파싱하지 않고 재생 위치에 맞춰 하나씩 불러온다
+	void SetLazyLoad(bool lazy);
+	// Load 전에 설정한다. 0이 아니면 I/O 스레드가 현재와 다음 clusterCount개의 클러스터를 미리 읽는다
+	void SetPrefetch(uint32_t clusterCount);
+	// Load 전에 설정한다. 재생 시간을 잴 시계로, nullptr이면 SteadyClock을 쓴다
+	void SetClock(Clock *clock);
+	PrefetchReader::Stats GetPrefetchStats();
+	// Load 전에 설정한다. 클립을 바꿀 때 디코더와 출력 버퍼를 pool에서 다시 쓴다. nullptr이면 디코더마다 가진 풀을 쓴다
+	void SetDecoderPool(DecoderPool *pool);
+	// Load 전에 설정한다. RGBA 출력 버퍼를 받을 풀로, nullptr이면 프로세스 공용 풀을 쓴다
+	void SetBufferPool(BufferPool *pool);
+	// Load 전에 설정한다. 연속한 프레임의 YUV 평면을 16x16 블록으로 비교해서 바뀐 영역만 출력 버퍼에 다시 변환한다.
+	// 화면 대부분이 멈춰 있는 UI 클립에 쓰고, GetFrame으로 버퍼를 넘겨받으면 다음 프레임은 전체를 변환한다
+	void SetDirtyTracking(bool enable);
 
 private:
 	void _PrintError(vpx_codec_ctx_t *ctx, const char *error);
-	bool _IsWebM();
+	bool _IsWebM(const std::string &fileName);
+	uint64_t _HashAsset(const std::string &fileName);
+	static void _LoadCues(mkvparser::Segment *segment);
+	static const mkvparser::VideoTrack *_FindVideoTrack(const mkvparser::Segment *segment);
+	static uint32_t _GetFourCC(const mkvparser::VideoTrack *track);
+	static void _GetFrameRate(const mkvparser::VideoTrack *track, int &numerator, int &denominator);
+	void _PrefetchClusters();
 	WEBM_STATE _ReadFrame();
-	void _ConvertToRGBA();
+	bool _ReadBlockData(const mkvparser::Block *block, int frameIndex);
+	const mkvparser::BlockEntry *_FindKeyFrame(uint64_t timestamp_ns);
+	bool _DecodeThumbnail(const mkvparser::BlockEntry *entry, uint32_t size, Thumbnail &thumbnail);
+	bool _DecodeVPX();
+	WEBM_STATE _DecodeSharedFrame();
+	bool _Resync();
+	bool _IsBehindSchedule();
+	bool _IsSkippedBlock();
+	bool _IsDroppable();
+	uint64_t _ToPresentationTime(uint64_t media_timestamp_ns);
+	void _ResetTimeline();
+	vpx_codec_iface_t *_GetCodecInterface();
+	bool _OpenReverseDecoder();
+	bool _BeginReverse(int64_t from, int64_t to);
+	WEBM_STATE _ReadReverseFrame();
+	bool _SeekForward(int64_t target);
+	void _ConvertToRGBA(uint8_t *dst = nullptr);
+	uint8_t *_GetFramePixels();
+	uint8_t *_GetPixelBuffer(uint32_t width, uint32_t height);
+	void _SetFrameSize(uint32_t width, uint32_t height);
+	bool _OnLoopRestart();
+	WEBM_STATE _ReadCachedFrame();
+	void _ReleaseLoopClip();
+	void _PreloadNext();
+	bool _Preroll();
+	bool _SwitchToNext();
+	void _ReleasePlaylist();
 	uint64_t _GetTime();
+	// begin_timestamp_ns부터 지난 재생 시간. 시작 시각이 아직 오지 않았으면 음수
+	int64_t _GetPlaybackTime();
 
 private:
 	webm_context mCTX;
 	long mAccumTime;
 	bool mUsingSSE;
 	bool mUsingAVX;
+	LoopCache *mLoopCache;
+	LoopCache::STORAGE mLoopCacheStorage;
+	FrameCache *mFrameCache;
+	bool mLazyLoad;
+	uint32_t mPrefetchClusters;
+	Clock *mClock;
+	bool mPingPong;
+	size_t mReverseMemoryBudget;
+	DecoderPool mOwnDecoderPool;
+	DecoderPool *mDecoderPool;
+	BufferPool *mBufferPool;
+	uint64_t mLoadTime;
+	DecoderStats mStats;
+	std::vector<std::string> mPlaylist;
+	size_t mPlaylistIndex;
+	bool mPlaylistLoop;
+	// 다음 항목을 미리 여는 디코더. 넘어간 뒤에는 끝난 항목의 컨텍스트를 넘겨받아 백그라운드에서 정리한다
+	std::unique_ptr<WebmDecoder> mNextDecoder;
+	size_t mNextIndex;
+	std::thread mPreloadThread;
+	uint32_t mTraceId;	// 트레이스에서 디코더를 구분하는 번호
+	bool mDirtyTracking;
 
 	using YUVtoRGBAFunc_t = void(*)(uint32_t, uint32_t,
 		const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*,
 		uint32_t, uint32_t, uint32_t, uint32_t,
-		uint8_t*, uint32_t, YCbCrType);
+		uint8_t*, uint32_t, YCbCrType, AlphaCoverage*);
 	YUVtoRGBAFunc_t YUVtoRGBAFunc;
+
+	using AlphaConstantFunc_t = int(*)(uint32_t, uint32_t, const uint8_t*, uint32_t);
+	AlphaConstantFunc_t AlphaConstantFunc;
 };
\ No newline at end of file
@@ -0,0 +1,460 @@
+#include "WebmEncoder.h"
+#include "WebmDecoder.h"
+#include "DebugTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#define ALPHA_BLOCK_ADDITIONAL_ID 1
+// 색상과 알파 인코더가 하나씩 돈다
+#define ENCODER_STREAM_COUNT 2
+// VP9 타일 열과 VP8 토큰 파티션은 2의 거듭제곱 개수로 나누므로 스레드 수의 log2를 쓴다
+#define MAX_VP9_TILE_COLUMNS_LOG2 6
+#define MAX_VP8_TOKEN_PARTITIONS_LOG2 3
+
+static uint64_t get_time_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int log2_floor(uint32_t value)
+{
+	int log2 = 0;
+	while (value > 1)
+	{
+		value >>= 1;
+		log2++;
+	}
+	return log2;
+}
+
+static void fill_neutral_chroma(vpx_image_t *img)
+{
+	for (int plane : { VPX_PLANE_U, VPX_PLANE_V })
+	{
+		for (uint32_t y = 0; y < (img->d_h + 1) / 2; ++y)
+			memset(img->planes[plane] + y * img->stride[plane], 128, (img->d_w + 1) / 2);
+	}
+}
+
+WebmFileWriter::WebmFileWriter() : mFile(nullptr)
+{
+}
+
+WebmFileWriter::~WebmFileWriter()
+{
+	Close();
+}
+
+bool WebmFileWriter::Open(const std::string &fileName)
+{
+	if (fopen_s(&mFile, fileName.c_str(), "wb"))
+		mFile = nullptr;
+	return mFile != nullptr;
+}
+
+void WebmFileWriter::Close()
+{
+	if (mFile)
+		fclose(mFile);
+	mFile = nullptr;
+}
+
+mkvmuxer::int32 WebmFileWriter::Write(const void *buf, mkvmuxer::uint32 len)
+{
+	return (mFile && fwrite(buf, 1, len, mFile) == len) ? 0 : -1;
+}
+
+mkvmuxer::int64 WebmFileWriter::Position() const
+{
+	return (mFile) ? _ftelli64(mFile) : 0;
+}
+
+mkvmuxer::int32 WebmFileWriter::Position(mkvmuxer::int64 position)
+{
+	return (mFile) ? _fseeki64(mFile, position, SEEK_SET) : -1;
+}
+
+bool WebmFileWriter::Seekable() const
+{
+	return true;
+}
+
+void WebmFileWriter::ElementStartNotify(mkvmuxer::uint64, mkvmuxer::int64)
+{
+}
+
+WebmEncoder::WebmEncoder() : RGBAtoYUVFunc(rgba_yuv420_std), mPool(ENCODER_STREAM_COUNT), mSegment(nullptr), mTrack(0),
+	mOpenTime(0), mFrameCount(0), mWidth(0), mHeight(0), mHasAlpha(false), mOpen(false),
+	mFourcc(VP9_FOURCC), mBitrate(2000), mAlphaBitrate(0), mFramerateNumerator(30), mFramerateDenominator(1),
+	mKeyFrameInterval(30), mThreads(0), mCpuUsed(4), mYCbCrType(YCBCR_JPEG)
+{
+	memset(&mStats, 0, sizeof(mStats));
+	for (encoder_stream *stream : { &mColor, &mAlpha })
+	{
+		stream->codec.iface = nullptr;
+		stream->has_images = false;
+		stream->bytes = 0;
+		stream->encode_ns = 0;
+		stream->ok = true;
+	}
+
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 7);
+	if (cpuInfo[1] & (1 << 5))
+	{
+		RGBAtoYUVFunc = rgba_yuv420_avx;
+		return;
+	}
+	__cpuid(cpuInfo, 1);
+	if ((cpuInfo[3] >> 26) & 1)
+		RGBAtoYUVFunc = rgba_yuv420_sse;
+}
+
+WebmEncoder::~WebmEncoder()
+{
+	if (mOpen)
+		Close();
+}
+
+void WebmEncoder::SetCodec(uint32_t fourcc)
+{
+	mFourcc = fourcc;
+}
+
+void WebmEncoder::SetBitrate(uint32_t kbps, uint32_t alphaKbps)
+{
+	mBitrate = kbps;
+	mAlphaBitrate = alphaKbps;
+}
+
+void WebmEncoder::SetFrameRate(int numerator, int denominator)
+{
+	mFramerateNumerator = numerator;
+	mFramerateDenominator = denominator;
+}
+
+void WebmEncoder::SetKeyFrameInterval(uint32_t frames)
+{
+	mKeyFrameInterval = frames;
+}
+
+void WebmEncoder::SetThreads(uint32_t threads)
+{
+	mThreads = threads;
+}
+
+void WebmEncoder::SetCpuUsed(int cpuUsed)
+{
+	mCpuUsed = cpuUsed;
+}
+
+void WebmEncoder::SetYCbCrType(YCbCrType type)
+{
+	mYCbCrType = type;
+}
+
+bool WebmEncoder::Open(const std::string &fileName, uint32_t width, uint32_t height, bool hasAlpha)
+{
+	if (mOpen)
+		Close();
+
+	if (width == 0 || height == 0 || mFramerateNumerator <= 0 || mFramerateDenominator <= 0)
+		return false;
+
+	memset(&mStats, 0, sizeof(mStats));
+	mOpenTime = get_time_ns();
+	mFileName = fileName;
+	mWidth = width;
+	mHeight = height;
+	mHasAlpha = hasAlpha;
+	mFrameCount = 0;
+
+	// 알파 채널은 같은 코덱의 휘도 평면으로 인코딩한다. 색상보다 단순하므로 따로 정하지 않으면 비트레이트는 절반만 준다
+	bool ok = _InitStream(mColor, mBitrate, false);
+	ok = ok && (!hasAlpha || _InitStream(mAlpha, (mAlphaBitrate) ? mAlphaBitrate : mBitrate / 2, true));
+
+	// 이 인코더가 파일을 만들었을 때만 실패하면 지운다. 인코더를 못 만들었으면 원래 있던 파일을 그대로 둔다
+	mSegment = new mkvmuxer::Segment();
+	const bool created = ok && mWriter.Open(fileName);
+	ok = created && mSegment->Init(&mWriter);
+	if (ok)
+	{
+		mSegment->set_mode(mkvmuxer::Segment::kFile);
+		mSegment->OutputCues(true);
+		mSegment->GetSegmentInfo()->set_writing_app("WebmEncoder");
+
+		mTrack = mSegment->AddVideoTrack(width, height, 0);
+		mkvmuxer::VideoTrack *video = static_cast<mkvmuxer::VideoTrack*>(mSegment->GetTrackByNumber(mTrack));
+		ok = video != nullptr;
+		if (ok)
+		{
+			video->set_codec_id((mFourcc == VP8_FOURCC) ? mkvmuxer::Tracks::kVp8CodecId : mkvmuxer::Tracks::kVp9CodecId);
+			video->set_frame_rate(static_cast<double>(mFramerateNumerator) / mFramerateDenominator);
+			video->set_default_duration(1000000000ull * mFramerateDenominator / mFramerateNumerator);
+			if (hasAlpha)
+			{
+				video->SetAlphaMode(mkvmuxer::VideoTrack::kAlpha);
+				video->set_max_block_additional_id(ALPHA_BLOCK_ADDITIONAL_ID);
+			}
+			ok = mSegment->CuesTrack(mTrack);
+		}
+	}
+
+	if (!ok)
+	{
+		OutputDebugTrace("%s - failed to open encoder for %s.\n", __FUNCTION__, fileName.c_str());
+		_Release();
+		if (created)
+			remove(fileName.c_str());
+		return false;
+	}
+
+	mOpen = true;
+	return true;
+}
+
+bool WebmEncoder::AddFrame(const uint8_t *RGBA, uint32_t stride)
+{
+	if (!mOpen)
+		return false;
+
+	// 직전 프레임이 다른 슬롯에서 인코딩되는 동안 변환한다
+	const int slot = static_cast<int>(mFrameCount % 2);
+	vpx_image_t *img = &mColor.images[slot];
+	vpx_image_t *imgAlpha = (mHasAlpha) ? &mAlpha.images[slot] : nullptr;
+	const uint64_t convertBegin = get_time_ns();
+	RGBAtoYUVFunc(mWidth, mHeight, RGBA, stride,
+		img->planes[VPX_PLANE_Y], img->planes[VPX_PLANE_U], img->planes[VPX_PLANE_V], (imgAlpha) ? imgAlpha->planes[VPX_PLANE_Y] : nullptr,
+		img->stride[VPX_PLANE_Y], img->stride[VPX_PLANE_U], img->stride[VPX_PLANE_V], (imgAlpha) ? imgAlpha->stride[VPX_PLANE_Y] : 0,
+		mYCbCrType);
+	mStats.convert_ns += get_time_ns() - convertBegin;
+
+	if (!_Finish())
+		return false;
+
+	const vpx_enc_frame_flags_t flags = (mKeyFrameInterval == 0 || mFrameCount % mKeyFrameInterval == 0) ? VPX_EFLAG_FORCE_KF : 0;
+	_Submit(img, imgAlpha, mFrameCount, flags);
+	mFrameCount++;
+	return true;
+}
+
+bool WebmEncoder::Close()
+{
+	if (!mOpen)
+		return false;
+
+	// 인코더에 남은 패킷을 비운다
+	bool ok = _Finish();
+	if (ok)
+	{
+		_Submit(nullptr, nullptr, -1, 0);
+		ok = _Finish();
+	}
+	// 다 비운 뒤에도 남은 패킷은 짝이 되는 알파나 색상 프레임이 없다
+	if (ok && (!mColor.packets.empty() || !mAlpha.packets.empty()))
+	{
+		OutputDebugTrace("%s - %zu color and %zu alpha packets left without a pair.\n", __FUNCTION__,
+			mColor.packets.size(), mAlpha.packets.size());
+		ok = false;
+	}
+	ok = ok && mSegment->Finalize();
+
+	mStats.frames = static_cast<uint64_t>(mFrameCount);
+	mStats.encode_ns = mColor.encode_ns;
+	mStats.encode_alpha_ns = mAlpha.encode_ns;
+	mStats.alpha_bytes = mAlpha.bytes;
+	mStats.bytes = mColor.bytes + mAlpha.bytes;
+	mStats.elapsed_ns = get_time_ns() - mOpenTime;
+	mStats.fps = (mStats.elapsed_ns) ? mStats.frames * 1000000000.0 / mStats.elapsed_ns : 0.0;
+
+	_Release();
+	if (!ok)
+		remove(mFileName.c_str());
+	return ok;
+}
+
+bool WebmEncoder::_InitStream(encoder_stream &stream, uint32_t bitrateKbps, bool alpha)
+{
+	stream.packets.clear();
+	stream.bytes = 0;
+	stream.encode_ns = 0;
+	stream.ok = true;
+
+	stream.has_images = vpx_img_alloc(&stream.images[0], VPX_IMG_FMT_I420, mWidth, mHeight, 32) != nullptr;
+	if (stream.has_images && !vpx_img_alloc(&stream.images[1], VPX_IMG_FMT_I420, mWidth, mHeight, 32))
+	{
+		vpx_img_free(&stream.images[0]);
+		stream.has_images = false;
+	}
+	if (!stream.has_images)
+		return false;
+
+	if (alpha)
+	{
+		fill_neutral_chroma(&stream.images[0]);
+		fill_neutral_chroma(&stream.images[1]);
+	}
+
+	vpx_codec_iface_t *iface = (mFourcc == VP8_FOURCC) ? vpx_codec_vp8_cx() : vpx_codec_vp9_cx();
+	vpx_codec_enc_cfg_t cfg;
+	if (vpx_codec_enc_config_default(iface, &cfg, 0))
+		return false;
+
+	// 두 인코더가 동시에 돌므로 따로 정하지 않으면 코어를 반씩 나눈다
+	const uint32_t cores = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+	const uint32_t threads = (mThreads) ? mThreads : std::max<uint32_t>(cores / ENCODER_STREAM_COUNT, 1);
+
+	cfg.g_w = mWidth;
+	cfg.g_h = mHeight;
+	cfg.g_timebase.num = mFramerateDenominator;
+	cfg.g_timebase.den = mFramerateNumerator;
+	cfg.g_threads = threads;
+	// 프레임마다 패킷 하나가 바로 나오게 해서 색상과 알파 패킷을 같은 블록으로 묶는다
+	cfg.g_lag_in_frames = 0;
+	cfg.g_pass = VPX_RC_ONE_PASS;
+	cfg.rc_end_usage = VPX_VBR;
+	cfg.rc_target_bitrate = bitrateKbps;
+	cfg.rc_dropframe_thresh = 0;
+	// 키 프레임은 색상과 알파가 같은 위치에 오도록 직접 넣는다
+	cfg.kf_mode = VPX_KF_DISABLED;
+
+	if (vpx_codec_enc_init(&stream.codec, iface, &cfg, 0))
+	{
+		stream.codec.iface = nullptr;
+		return false;
+	}
+
+	vpx_codec_control(&stream.codec, VP8E_SET_CPUUSED, mCpuUsed);
+	if (mFourcc == VP8_FOURCC)
+	{
+		vpx_codec_control(&stream.codec, VP8E_SET_TOKEN_PARTITIONS, std::min(log2_floor(threads), MAX_VP8_TOKEN_PARTITIONS_LOG2));
+	}
+	else
+	{
+		// 타일 열로 나눠야 인코더와 디코더가 여러 스레드를 쓴다. 타일 폭의 하한은 libvpx가 맞춘다
+		vpx_codec_control(&stream.codec, VP9E_SET_TILE_COLUMNS, std::min(log2_floor(threads), MAX_VP9_TILE_COLUMNS_LOG2));
+		vpx_codec_control(&stream.codec, VP9E_SET_ROW_MT, 1u);
+		if (mYCbCrType == YCBCR_JPEG)
+			vpx_codec_control(&stream.codec, VP9E_SET_COLOR_RANGE, static_cast<int>(VPX_CR_FULL_RANGE));
+	}
+	return true;
+}
+
+void WebmEncoder::_ReleaseStream(encoder_stream &stream)
+{
+	if (stream.codec.iface)
+		vpx_codec_destroy(&stream.codec);
+	stream.codec.iface = nullptr;
+
+	if (stream.has_images)
+	{
+		vpx_img_free(&stream.images[0]);
+		vpx_img_free(&stream.images[1]);
+	}
+	stream.has_images = false;
+	stream.packets.clear();
+}
+
+void WebmEncoder::_Encode(encoder_stream &stream, vpx_image_t *img, int64_t pts, vpx_enc_frame_flags_t flags)
+{
+	const uint64_t begin = get_time_ns();
+	if (vpx_codec_encode(&stream.codec, img, pts, 1, flags, VPX_DL_GOOD_QUALITY))
+	{
+		stream.ok = false;
+		return;
+	}
+
+	vpx_codec_iter_t iter = nullptr;
+	const vpx_codec_cx_pkt_t *pkt = nullptr;
+	while ((pkt = vpx_codec_get_cx_data(&stream.codec, &iter)) != nullptr)
+	{
+		if (pkt->kind != VPX_CODEC_CX_FRAME_PKT)
+			continue;
+
+		const uint8_t *data = static_cast<const uint8_t*>(pkt->data.frame.buf);
+		encoded_packet packet;
+		packet.data.assign(data, data + pkt->data.frame.sz);
+		packet.pts = pkt->data.frame.pts;
+		packet.is_key = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
+		stream.bytes += pkt->data.frame.sz;
+		stream.packets.push_back(std::move(packet));
+	}
+	stream.encode_ns += get_time_ns() - begin;
+}
+
+void WebmEncoder::_Submit(vpx_image_t *img, vpx_image_t *imgAlpha, int64_t pts, vpx_enc_frame_flags_t flags)
+{
+	// 인코더 하나는 한 번에 한 스레드만 쓰므로 스트림마다 작업 하나씩 넣고 다음 프레임 전에 기다린다
+	std::vector<ThreadPool::Task> tasks;
+	tasks.push_back([this, img, pts, flags]() { _Encode(mColor, img, pts, flags); });
+	if (mHasAlpha)
+		tasks.push_back([this, imgAlpha, pts, flags]() { _Encode(mAlpha, imgAlpha, pts, flags); });
+	mPool.Submit(tasks);
+}
+
+bool WebmEncoder::_Finish()
+{
+	mPool.Wait();
+	for (encoder_stream *stream : { &mColor, &mAlpha })
+	{
+		if (!stream->ok)
+		{
+			OutputDebugTrace("%s - encode failed: %s\n", __FUNCTION__, vpx_codec_error(&stream->codec));
+			return false;
+		}
+	}
+	return _WritePackets();
+}
+
+bool WebmEncoder::_WritePackets()
+{
+	// 색상과 알파 인코더는 따로 돌기 때문에 한쪽 패킷이 먼저 나올 수 있다. 짝이 없는 패킷은 다음에 쓴다
+	size_t count = mColor.packets.size();
+	if (mHasAlpha)
+		count = std::min(count, mAlpha.packets.size());
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const encoded_packet &packet = mColor.packets[i];
+		const uint64_t timestamp = static_cast<uint64_t>(packet.pts) * 1000000000ull * mFramerateDenominator / mFramerateNumerator;
+		bool ok = false;
+		if (mHasAlpha)
+		{
+			const encoded_packet &packetAlpha = mAlpha.packets[i];
+			if (packetAlpha.pts != packet.pts)
+			{
+				OutputDebugTrace("%s - alpha packet pts %lld does not match color pts %lld.\n", __FUNCTION__,
+					static_cast<long long>(packetAlpha.pts), static_cast<long long>(packet.pts));
+				return false;
+			}
+			ok = mSegment->AddFrameWithAdditional(&packet.data[0], packet.data.size(),
+				&packetAlpha.data[0], packetAlpha.data.size(), ALPHA_BLOCK_ADDITIONAL_ID,
+				mTrack, timestamp, packet.is_key);
+		}
+		else
+		{
+			ok = mSegment->AddFrame(&packet.data[0], packet.data.size(), mTrack, timestamp, packet.is_key);
+		}
+
+		if (!ok)
+			return false;
+	}
+
+	mColor.packets.erase(mColor.packets.begin(), mColor.packets.begin() + count);
+	if (mHasAlpha)
+		mAlpha.packets.erase(mAlpha.packets.begin(), mAlpha.packets.begin() + count);
+	return true;
+}
+
+void WebmEncoder::_Release()
+{
+	mPool.Wait();
+	_ReleaseStream(mColor);
+	_ReleaseStream(mAlpha);
+	SAFE_DELETE(mSegment);
+	mWriter.Close();
+	mOpen = false;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vpx_encoder.h>
+#include <vp8cx.h>
+#include <mkvmuxer.h>
+#include "YUVtoRGB.h"
+#include "ThreadPool.h"
+
+// 같이 들어 있는 mkvwriter.h는 libwebm 소스 트리 경로로 헤더를 찾아서 여기서는 직접 구현한다
+class WebmFileWriter : public mkvmuxer::IMkvWriter
+{
+public:
+	WebmFileWriter();
+	virtual ~WebmFileWriter();
+
+public:
+	bool Open(const std::string &fileName);
+	void Close();
+
+	virtual mkvmuxer::int32 Write(const void *buf, mkvmuxer::uint32 len) override;
+	virtual mkvmuxer::int64 Position() const override;
+	virtual mkvmuxer::int32 Position(mkvmuxer::int64 position) override;
+	virtual bool Seekable() const override;
+	virtual void ElementStartNotify(mkvmuxer::uint64 element_id, mkvmuxer::int64 position) override;
+
+private:
+	FILE *mFile;
+};
+
+// RGBA 프레임을 VP8/VP9 WebM으로 인코딩한다. 알파 채널은 같은 코덱의 두 번째 인코더로 휘도 평면만 인코딩해서
+// BlockAdditional에 넣고, 탐색할 수 있게 Cues를 쓴다.
+// 색상과 알파 인코더는 스레드 풀에서 동시에 돌고, 그동안 AddFrame을 부른 스레드는 다음 프레임을 YUVA420으로 변환한다
+class WebmEncoder
+{
+public:
+	struct EncodeStats
+	{
+		uint64_t frames;
+		uint64_t bytes;			// 색상과 알파 패킷의 합
+		uint64_t alpha_bytes;
+		uint64_t convert_ns;	// RGBA -> YUVA420
+		uint64_t encode_ns;		// 색상 vpx_codec_encode
+		uint64_t encode_alpha_ns;	// 알파 vpx_codec_encode. 색상과 겹쳐서 돌므로 elapsed_ns에는 둘 중 긴 쪽만 보인다
+		uint64_t elapsed_ns;	// Open부터 Close까지
+		double fps;				// 초당 인코딩한 프레임
+	};
+
+public:
+	WebmEncoder();
+	~WebmEncoder();
+	WebmEncoder(const WebmEncoder&) = delete;
+	WebmEncoder &operator=(const WebmEncoder&) = delete;
+
+public:
+	// 아래 설정은 Open 전에 설정한다
+	// VP8_FOURCC 또는 VP9_FOURCC. 기본은 VP9
+	void SetCodec(uint32_t fourcc);
+	// alphaKbps가 0이면 색상의 절반을 쓴다
+	void SetBitrate(uint32_t kbps, uint32_t alphaKbps);
+	void SetFrameRate(int numerator, int denominator);
+	// 색상과 알파의 키 프레임이 같은 위치에 오도록 이 간격으로 직접 넣는다
+	void SetKeyFrameInterval(uint32_t frames);
+	// 인코더 하나가 쓰는 libvpx 스레드 수. 0이면 코어 수의 절반
+	void SetThreads(uint32_t threads);
+	// libvpx cpu-used. 높을수록 빠르고 화질이 낮다
+	void SetCpuUsed(int cpuUsed);
+	// 재생기가 YCBCR_JPEG으로 변환하므로 기본도 JPEG이다
+	void SetYCbCrType(YCbCrType type);
+
+	bool Open(const std::string &fileName, uint32_t width, uint32_t height, bool hasAlpha);
+	// RGBA(width x height)를 변환해서 인코더에 넘긴다. 인코딩은 다음 AddFrame이나 Close에서 끝난다
+	bool AddFrame(const uint8_t *RGBA, uint32_t stride);
+	// 남은 패킷을 비우고 Cues를 써서 파일을 닫는다. 실패하면 파일을 지운다
+	bool Close();
+	bool IsOpen() const { return mOpen; }
+	const EncodeStats &GetStats() const { return mStats; }
+
+private:
+	struct encoded_packet
+	{
+		std::vector<uint8_t> data;
+		int64_t pts;
+		bool is_key;
+	};
+
+	struct encoder_stream
+	{
+		vpx_codec_ctx_t codec;
+		vpx_image_t images[2];	// 하나를 인코딩하는 동안 다른 하나에 다음 프레임을 변환한다
+		bool has_images;
+		std::vector<encoded_packet> packets;
+		uint64_t bytes;
+		uint64_t encode_ns;
+		bool ok;
+	};
+
+	using RGBAtoYUVFunc_t = void(*)(uint32_t, uint32_t, const uint8_t*, uint32_t,
+		uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint32_t, uint32_t, uint32_t, uint32_t, YCbCrType);
+	RGBAtoYUVFunc_t RGBAtoYUVFunc;
+
+	bool _InitStream(encoder_stream &stream, uint32_t bitrateKbps, bool alpha);
+	void _ReleaseStream(encoder_stream &stream);
+	void _Encode(encoder_stream &stream, vpx_image_t *img, int64_t pts, vpx_enc_frame_flags_t flags);
+	void _Submit(vpx_image_t *img, vpx_image_t *imgAlpha, int64_t pts, vpx_enc_frame_flags_t flags);
+	bool _Finish();
+	bool _WritePackets();
+	void _Release();
+
+private:
+	ThreadPool mPool;
+	WebmFileWriter mWriter;
+	mkvmuxer::Segment *mSegment;
+	encoder_stream mColor;
+	encoder_stream mAlpha;
+	EncodeStats mStats;
+	std::string mFileName;
+	uint64_t mTrack;
+	uint64_t mOpenTime;
+	int64_t mFrameCount;
+	uint32_t mWidth;
+	uint32_t mHeight;
+	bool mHasAlpha;
+	bool mOpen;
+
+	uint32_t mFourcc;
+	uint32_t mBitrate;
+	uint32_t mAlphaBitrate;
+	int mFramerateNumerator;
+	int mFramerateDenominator;
+	uint32_t mKeyFrameInterval;
+	uint32_t mThreads;
+	int mCpuUsed;
+	YCbCrType mYCbCrType;
+};
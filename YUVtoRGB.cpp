@@ -1,5 +1,7 @@
 #include "YUVtoRGB.h"
 #include <emmintrin.h>
+#include <intrin.h>
+#include <algorithm>
 #include <memory>
 
 uint8_t clamp(int16_t value)
@@ -7,11 +9,135 @@ uint8_t clamp(int16_t value)
 	return value < 0 ? 0 : (value > 255 ? 255 : value);
 }
 
-void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type)
+void alpha_coverage_begin(AlphaCoverage* coverage, uint32_t width, uint32_t height, bool has_alpha)
+{
+	coverage->tiles_wide = (width + ALPHA_TILE_SIZE - 1) / ALPHA_TILE_SIZE;
+	coverage->tiles_high = (height + ALPHA_TILE_SIZE - 1) / ALPHA_TILE_SIZE;
+	coverage->tiles.assign(static_cast<size_t>(coverage->tiles_wide) * coverage->tiles_high,
+		(has_alpha) ? ALPHA_TILE_OPAQUE | ALPHA_TILE_TRANSPARENT : ALPHA_TILE_OPAQUE);
+
+	// 알파가 있으면 빈 사각형에서 시작해서 보이는 픽셀마다 넓힌다
+	coverage->left = (has_alpha) ? width : 0;
+	coverage->top = (has_alpha) ? height : 0;
+	coverage->right = (has_alpha) ? 0 : width;
+	coverage->bottom = (has_alpha) ? 0 : height;
+}
+
+void alpha_coverage_end(AlphaCoverage* coverage)
+{
+	coverage->opaque_tiles = 0;
+	coverage->transparent_tiles = 0;
+	coverage->mixed_tiles = 0;
+	for (uint8_t& tile : coverage->tiles)
+	{
+		// 홀수 크기의 마지막 줄, 열처럼 커널이 변환하지 않은 픽셀만 있는 타일은 섞인 타일로 둔다
+		if (tile == (ALPHA_TILE_OPAQUE | ALPHA_TILE_TRANSPARENT))
+			tile = ALPHA_TILE_MIXED;
+
+		if (tile == ALPHA_TILE_OPAQUE)
+			coverage->opaque_tiles++;
+		else if (tile == ALPHA_TILE_TRANSPARENT)
+			coverage->transparent_tiles++;
+		else
+			coverage->mixed_tiles++;
+	}
+
+	if (coverage->left >= coverage->right || coverage->top >= coverage->bottom)
+		coverage->left = coverage->top = coverage->right = coverage->bottom = 0;
+}
+
+void alpha_coverage_fill(AlphaCoverage* coverage, uint32_t width, uint32_t height, uint8_t alpha)
+{
+	// 모두 투명할 때만 빈 사각형에서 시작하고, 타일은 한 종류로 채운다
+	alpha_coverage_begin(coverage, width, height, alpha == 0);
+	const uint8_t tile = (alpha == 255) ? ALPHA_TILE_OPAQUE : (alpha == 0) ? ALPHA_TILE_TRANSPARENT : ALPHA_TILE_MIXED;
+	std::fill(coverage->tiles.begin(), coverage->tiles.end(), tile);
+	alpha_coverage_end(coverage);
+}
+
+int alpha_plane_constant_std(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride)
+{
+	if (width == 0 || height == 0)
+		return -1;
+
+	const uint8_t value = A[0];
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* a_ptr = A + y * A_stride;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			if (a_ptr[x] != value)
+				return -1;
+		}
+	}
+	return value;
+}
+
+uint32_t plane_diff_copy_blocks(uint32_t width, uint32_t top, uint32_t bottom, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty_row)
+{
+	const uint32_t blocks_wide = (width + block_size - 1) / block_size;
+	uint32_t changed = 0;
+	uint32_t bx = 0;
+	while (bx < blocks_wide)
+	{
+		if (dirty_row[bx] != 2)
+		{
+			bx++;
+			continue;
+		}
+
+		// 이어진 블록은 줄마다 한 번에 복사한다
+		const uint32_t first = bx;
+		while (bx < blocks_wide && dirty_row[bx] == 2)
+			dirty_row[bx++] = 1;
+		changed += bx - first;
+
+		const uint32_t left = first * block_size;
+		const uint32_t right = std::min(bx * block_size, width);
+		for (uint32_t y = top; y < bottom; ++y)
+			memcpy(prev + y * prev_stride + left, src + y * src_stride + left, right - left);
+	}
+	return changed;
+}
+
+uint32_t plane_diff_blocks_std(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride)
+{
+	uint32_t changed = 0;
+	for (uint32_t top = 0; top < height; top += block_size)
+	{
+		const uint32_t bottom = std::min(top + block_size, height);
+		uint8_t* dirty_row = dirty + (top / block_size) * dirty_stride;
+		for (uint32_t y = top; y < bottom; ++y)
+		{
+			const uint8_t* src_ptr = src + y * src_stride;
+			const uint8_t* prev_ptr = prev + y * prev_stride;
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				if (src_ptr[x] != prev_ptr[x])
+					dirty_row[x / block_size] = 2;
+			}
+		}
+		changed += plane_diff_copy_blocks(width, top, bottom, block_size, src, src_stride, prev, prev_stride, dirty_row);
+	}
+	return changed;
+}
+
+// 2x2 픽셀의 알파를 더한다. x는 짝수라서 두 픽셀이 같은 타일에 들어간다
+static inline void alpha_coverage_add_quad(AlphaCoverage* coverage, uint32_t x, uint32_t y, const uint8_t* a_ptr1, const uint8_t* a_ptr2)
+{
+	const uint32_t zero1 = (a_ptr1[0] == 0) | ((a_ptr1[1] == 0) << 1);
+	const uint32_t zero2 = (a_ptr2[0] == 0) | ((a_ptr2[1] == 0) << 1);
+	const uint32_t opaque = (a_ptr1[0] == 255 && a_ptr2[0] == 255) | ((a_ptr1[1] == 255 && a_ptr2[1] == 255) << 1);
+	alpha_coverage_add(coverage, x, y, 2, zero1, zero2, opaque);
+}
+
+void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage)
 {
 	const YUV2RGBParam* const param = &(YUV2RGB[yuv_type]);
+	if (coverage)
+		alpha_coverage_begin(coverage, width, height, A != nullptr);
 	uint32_t x, y;
-	for (y = 0; y < (height - 1); y += 2)
+	for (y = 0; y + 1 < height; y += 2)
 	{
 		const uint8_t* y_ptr1 = Y + y * Y_stride,
 			* y_ptr2 = Y + (y + 1) * Y_stride,
@@ -23,8 +149,11 @@ void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const u
 		uint8_t* rgb_ptr1 = RGBA + y * RGBA_stride,
 			* rgb_ptr2 = RGBA + (y + 1) * RGBA_stride;
 
-		for (x = 0; x < (width - 1); x += 2)
+		for (x = 0; x + 1 < width; x += 2)
 		{
+			if (coverage && a_ptr1)
+				alpha_coverage_add_quad(coverage, x, y, a_ptr1, a_ptr2);
+
 			int8_t u_tmp, v_tmp;
 			u_tmp = u_ptr[0] - 128;
 			v_tmp = v_ptr[0] - 128;
@@ -68,13 +197,81 @@ void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const u
 			rgb_ptr2 += 8;
 		}
 	}
+
+	if (coverage)
+		alpha_coverage_end(coverage);
+}
+
+void yuv420_rgba_scale_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_width, uint32_t RGBA_height, uint32_t RGBA_stride, YCbCrType yuv_type)
+{
+	const YUV2RGBParam* const param = &(YUV2RGB[yuv_type]);
+	for (uint32_t dy = 0; dy < RGBA_height; ++dy)
+	{
+		const uint32_t y0 = dy * height / RGBA_height;
+		const uint32_t y1 = ((dy + 1) * height / RGBA_height > y0) ? (dy + 1) * height / RGBA_height : y0 + 1;
+		const uint32_t cy0 = y0 / 2;
+		const uint32_t cy1 = (y1 + 1) / 2;
+		uint8_t* rgba_ptr = RGBA + dy * RGBA_stride;
+
+		for (uint32_t dx = 0; dx < RGBA_width; ++dx)
+		{
+			const uint32_t x0 = dx * width / RGBA_width;
+			const uint32_t x1 = ((dx + 1) * width / RGBA_width > x0) ? (dx + 1) * width / RGBA_width : x0 + 1;
+			const uint32_t cx0 = x0 / 2;
+			const uint32_t cx1 = (x1 + 1) / 2;
+
+			uint32_t y_sum = 0, a_sum = 0;
+			for (uint32_t y = y0; y < y1; ++y)
+			{
+				for (uint32_t x = x0; x < x1; ++x)
+				{
+					y_sum += Y[y * Y_stride + x];
+					if (A)
+						a_sum += A[y * A_stride + x];
+				}
+			}
+
+			uint32_t u_sum = 0, v_sum = 0;
+			for (uint32_t y = cy0; y < cy1; ++y)
+			{
+				for (uint32_t x = cx0; x < cx1; ++x)
+				{
+					u_sum += U[y * U_stride + x];
+					v_sum += V[y * V_stride + x];
+				}
+			}
+
+			const uint32_t count = (y1 - y0) * (x1 - x0);
+			const uint32_t c_count = (cy1 - cy0) * (cx1 - cx0);
+
+			int8_t u_tmp, v_tmp;
+			u_tmp = (uint8_t)(u_sum / c_count) - 128;
+			v_tmp = (uint8_t)(v_sum / c_count) - 128;
+
+			int16_t b_cb_offset, r_cr_offset, g_cbcr_offset;
+			b_cb_offset = (param->cb_factor * u_tmp) >> 6;
+			r_cr_offset = (param->cr_factor * v_tmp) >> 6;
+			g_cbcr_offset = (param->g_cb_factor * u_tmp + param->g_cr_factor * v_tmp) >> 7;
+
+			int16_t y_tmp;
+			y_tmp = (param->y_factor * ((uint8_t)(y_sum / count) - param->y_offset)) >> 7;
+			rgba_ptr[0] = clamp(y_tmp + r_cr_offset);
+			rgba_ptr[1] = clamp(y_tmp - g_cbcr_offset);
+			rgba_ptr[2] = clamp(y_tmp + b_cb_offset);
+			rgba_ptr[3] = (A) ? (uint8_t)(a_sum / count) : 255;
+			rgba_ptr += 4;
+		}
+	}
 }
 
-void yuv420_rgb24_extra(int w, int width, const uint8_t* y_ptr1, const uint8_t* y_ptr2, const uint8_t* u_ptr, const uint8_t* v_ptr, const uint8_t* a_ptr1, const uint8_t* a_ptr2, uint8_t* rgb_ptr1, uint8_t* rgb_ptr2, YCbCrType yuv_type)
+void yuv420_rgb24_extra(int w, int width, const uint8_t* y_ptr1, const uint8_t* y_ptr2, const uint8_t* u_ptr, const uint8_t* v_ptr, const uint8_t* a_ptr1, const uint8_t* a_ptr2, uint8_t* rgb_ptr1, uint8_t* rgb_ptr2, YCbCrType yuv_type, uint32_t h, AlphaCoverage* coverage)
 {
 	const YUV2RGBParam* const param = &(YUV2RGB[yuv_type]);
 	for (; w < (width - 1); w += 2)
 	{
+		if (coverage && a_ptr1)
+			alpha_coverage_add_quad(coverage, static_cast<uint32_t>(w), h, a_ptr1, a_ptr2);
+
 		int8_t u_tmp, v_tmp;
 		u_tmp = u_ptr[0] - 128;
 		v_tmp = v_ptr[0] - 128;
@@ -162,10 +359,12 @@ void yuv420_rgb24_extra(int w, int width, const uint8_t* y_ptr1, const uint8_t*
 	PACK_RGBA32_32_STEP(RGBA1, RGBA2, RGBA3, RGBA4, RGBA5, RGBA6, RGBA7, RGBA8, R1, R2, G1, G2, B1, B2, A1, A2) \
 	PACK_RGBA32_32_STEP(R1, R2, G1, G2, B1, B2, A1, A2, RGBA1, RGBA2, RGBA3, RGBA4, RGBA5, RGBA6, RGBA7, RGBA8) \
 
-void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type)
+void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage)
 {
 	const YUV2RGBParam* const param = &(YUV2RGB[yuv_type]);
-	for (uint32_t h = 0; h < (height - 1); h += 2)
+	if (coverage)
+		alpha_coverage_begin(coverage, width, height, A != nullptr);
+	for (uint32_t h = 0; h + 1 < height; h += 2)
 	{
 		const uint8_t* y_ptr1 = Y + h * Y_stride;
 		const uint8_t* y_ptr2 = Y + (h + 1) * Y_stride;
@@ -178,7 +377,8 @@ void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const u
 		uint8_t* rgba_ptr2 = RGBA + ((h + 1) * RGBA_stride);
 
 		uint32_t w = 0;
-		for (; w < (width - 31); w += 32)
+		// width가 32보다 작을 때 부호 없는 뺄셈이 넘치지 않도록 더해서 비교한다
+		for (; w + 31 < width; w += 32)
 		{
 			__m128i u = LOAD_SI128((const __m128i*)(u_ptr));
 			__m128i v = LOAD_SI128((const __m128i*)(v_ptr));
@@ -263,6 +463,20 @@ void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const u
 			__m128i b_8_22 = _mm_packus_epi16(b_16_1, b_16_2);
 			__m128i a_8_22 = (a_ptr2) ? LOAD_SI128((const __m128i*)(a_ptr2 + 16)) : _mm_set1_epi8((char)255);
 
+			// PACK_RGBA32_32이 입력 레지스터를 덮어쓰므로 섞기 전에 알파를 본다
+			if (coverage && a_ptr1)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i full = _mm_set1_epi8((char)255);
+				const uint32_t zero1 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a_8_11, zero))) |
+					(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a_8_12, zero))) << 16);
+				const uint32_t zero2 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a_8_21, zero))) |
+					(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a_8_22, zero))) << 16);
+				const uint32_t opaque = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(a_8_11, a_8_21), full))) |
+					(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(a_8_12, a_8_22), full))) << 16);
+				alpha_coverage_add(coverage, w, h, 32, zero1, zero2, opaque);
+			}
+
 			__m128i rgba1[8];
 			__m128i rgba2[8];
 
@@ -283,6 +497,220 @@ void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const u
 		}
 
 		// width의 남은 픽셀은 그냥 계산
-		yuv420_rgb24_extra(w, width, y_ptr1, y_ptr2, u_ptr, v_ptr, a_ptr1, a_ptr2, rgba_ptr1, rgba_ptr2, yuv_type);
+		yuv420_rgb24_extra(w, width, y_ptr1, y_ptr2, u_ptr, v_ptr, a_ptr1, a_ptr2, rgba_ptr1, rgba_ptr2, yuv_type, h, coverage);
+	}
+
+	if (coverage)
+		alpha_coverage_end(coverage);
+}
+
+int alpha_plane_constant_sse(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride)
+{
+	if (width == 0 || height == 0)
+		return -1;
+
+	const uint8_t value = A[0];
+	const __m128i expected = _mm_set1_epi8(static_cast<char>(value));
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* a_ptr = A + y * A_stride;
+
+		// 한 줄의 차이를 OR로 모아서 줄 끝에서 한 번만 확인한다
+		__m128i diff = _mm_setzero_si128();
+		uint32_t x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a_ptr + x)), expected));
+			diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a_ptr + x + 16)), expected));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+			return -1;
+
+		for (; x < width; ++x)
+		{
+			if (a_ptr[x] != value)
+				return -1;
+		}
+	}
+	return value;
+}
+
+uint32_t plane_diff_blocks_sse(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride)
+{
+	const uint32_t block_mask = (1u << block_size) - 1;
+	uint32_t changed = 0;
+	for (uint32_t top = 0; top < height; top += block_size)
+	{
+		const uint32_t bottom = std::min(top + block_size, height);
+		uint8_t* dirty_row = dirty + (top / block_size) * dirty_stride;
+		for (uint32_t y = top; y < bottom; ++y)
+		{
+			const uint8_t* src_ptr = src + y * src_stride;
+			const uint8_t* prev_ptr = prev + y * prev_stride;
+			uint32_t x = 0;
+			for (; x + 16 <= width; x += 16)
+			{
+				const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src_ptr + x)), _mm_loadu_si128((const __m128i*)(prev_ptr + x)));
+				uint32_t diff = ~static_cast<uint32_t>(_mm_movemask_epi8(equal)) & 0xFFFF;
+
+				// 다른 바이트가 있는 블록마다 한 번씩 표시한다. x가 16의 배수라서 블록은 x에서 시작한다
+				while (diff)
+				{
+					unsigned long index;
+					_BitScanForward(&index, diff);
+					const uint32_t bx = (x + index) / block_size;
+					dirty_row[bx] = 2;
+					diff &= ~(block_mask << (bx * block_size - x));
+				}
+			}
+
+			for (; x < width; ++x)
+			{
+				if (src_ptr[x] != prev_ptr[x])
+					dirty_row[x / block_size] = 2;
+			}
+		}
+		changed += plane_diff_copy_blocks(width, top, bottom, block_size, src, src_stride, prev, prev_stride, dirty_row);
+	}
+	return changed;
+}
+
+static inline uint8_t rgb_to_y(const uint8_t* p, const RGB2YUVParam* param)
+{
+	return clamp(static_cast<int16_t>((param->y_r * p[0] + param->y_g * p[1] + param->y_b * p[2] + (param->y_offset << 14) + (1 << 13)) >> 14));
+}
+
+void rgba_yuv420_extra(uint32_t x, uint32_t width, const uint8_t* rgba_ptr1, const uint8_t* rgba_ptr2, uint8_t* y_ptr1, uint8_t* y_ptr2, uint8_t* u_ptr, uint8_t* v_ptr, uint8_t* a_ptr1, uint8_t* a_ptr2, YCbCrType yuv_type)
+{
+	const RGB2YUVParam* const param = &(RGB2YUV[yuv_type]);
+	for (; x < width; x += 2)
+	{
+		const uint32_t x2 = (x + 1 < width) ? x + 1 : x;
+		const uint8_t* p1 = rgba_ptr1 + x * 4;
+		const uint8_t* p2 = rgba_ptr1 + x2 * 4;
+		const uint8_t* p3 = rgba_ptr2 + x * 4;
+		const uint8_t* p4 = rgba_ptr2 + x2 * 4;
+
+		y_ptr1[x] = rgb_to_y(p1, param);
+		y_ptr1[x2] = rgb_to_y(p2, param);
+		y_ptr2[x] = rgb_to_y(p3, param);
+		y_ptr2[x2] = rgb_to_y(p4, param);
+		if (a_ptr1)
+		{
+			a_ptr1[x] = p1[3];
+			a_ptr1[x2] = p2[3];
+			a_ptr2[x] = p3[3];
+			a_ptr2[x2] = p4[3];
+		}
+
+		// 평균을 내지 않고 네 픽셀의 합에 곱한 뒤 2비트를 더 내린다
+		const int r = p1[0] + p2[0] + p3[0] + p4[0];
+		const int g = p1[1] + p2[1] + p3[1] + p4[1];
+		const int b = p1[2] + p2[2] + p3[2] + p4[2];
+		u_ptr[x / 2] = clamp(static_cast<int16_t>((param->cb_r * r + param->cb_g * g + param->cb_b * b + (128 << 16) + (1 << 15)) >> 16));
+		v_ptr[x / 2] = clamp(static_cast<int16_t>((param->cr_r * r + param->cr_g * g + param->cr_b * b + (128 << 16) + (1 << 15)) >> 16));
+	}
+}
+
+void rgba_yuv420_std(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type)
+{
+	for (uint32_t y = 0; y < height; y += 2)
+	{
+		const uint32_t y2 = (y + 1 < height) ? y + 1 : y;
+		rgba_yuv420_extra(0, width, RGBA + y * RGBA_stride, RGBA + y2 * RGBA_stride, Y + y * Y_stride, Y + y2 * Y_stride,
+			U + (y / 2) * U_stride, V + (y / 2) * V_stride,
+			(A) ? A + y * A_stride : nullptr, (A) ? A + y2 * A_stride : nullptr, yuv_type);
+	}
+}
+
+static inline int coef_pair(int16_t lo, int16_t hi)
+{
+	return static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16) | static_cast<uint16_t>(lo));
+}
+
+// 4픽셀을 16비트 [R, B], [G, A] 쌍으로 나눈다
+#define SPLIT_RGBA_SSE(PX, RB, GA) \
+	RB = _mm_and_si128(PX, _mm_set1_epi16(0x00FF)); \
+	GA = _mm_srli_epi16(PX, 8);
+
+#define RGB2YUV_SSE(RB, GA, C_RB, C_GA, BIAS, SHIFT) \
+	_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(RB, C_RB), _mm_madd_epi16(GA, C_GA)), BIAS), SHIFT)
+
+// 두 4픽셀 묶음의 32비트 색차(0, 2번째 자리)를 [c0, c1, d0, d1] 순서로 모은다
+#define MERGE_CHROMA_SSE(C, D) \
+	_mm_shuffle_epi32(_mm_or_si128(_mm_and_si128(C, _mm_set_epi32(0, -1, 0, -1)), _mm_slli_epi64(D, 32)), _MM_SHUFFLE(3, 1, 2, 0))
+
+void rgba_yuv420_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type)
+{
+	const RGB2YUVParam* const param = &(RGB2YUV[yuv_type]);
+	const __m128i y_rb = _mm_set1_epi32(coef_pair(param->y_r, param->y_b));
+	const __m128i y_ga = _mm_set1_epi32(coef_pair(param->y_g, 0));
+	const __m128i cb_rb = _mm_set1_epi32(coef_pair(param->cb_r, param->cb_b));
+	const __m128i cb_ga = _mm_set1_epi32(coef_pair(param->cb_g, 0));
+	const __m128i cr_rb = _mm_set1_epi32(coef_pair(param->cr_r, param->cr_b));
+	const __m128i cr_ga = _mm_set1_epi32(coef_pair(param->cr_g, 0));
+	const __m128i y_bias = _mm_set1_epi32((param->y_offset << 14) + (1 << 13));
+	const __m128i c_bias = _mm_set1_epi32((128 << 16) + (1 << 15));
+
+	uint32_t y = 0;
+	for (; y + 1 < height; y += 2)
+	{
+		const uint8_t* rgba_ptr1 = RGBA + y * RGBA_stride;
+		const uint8_t* rgba_ptr2 = RGBA + (y + 1) * RGBA_stride;
+		uint8_t* y_ptr1 = Y + y * Y_stride;
+		uint8_t* y_ptr2 = Y + (y + 1) * Y_stride;
+		uint8_t* u_ptr = U + (y / 2) * U_stride;
+		uint8_t* v_ptr = V + (y / 2) * V_stride;
+		uint8_t* a_ptr1 = (A) ? A + y * A_stride : nullptr;
+		uint8_t* a_ptr2 = (A) ? A + (y + 1) * A_stride : nullptr;
+
+		uint32_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i y1[4], y2[4], a1[4], a2[4], cb[4], cr[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				const __m128i px1 = _mm_loadu_si128((const __m128i*)(rgba_ptr1 + (x + i * 4) * 4));
+				const __m128i px2 = _mm_loadu_si128((const __m128i*)(rgba_ptr2 + (x + i * 4) * 4));
+				__m128i rb1, ga1, rb2, ga2;
+				SPLIT_RGBA_SSE(px1, rb1, ga1)
+				SPLIT_RGBA_SSE(px2, rb2, ga2)
+				y1[i] = RGB2YUV_SSE(rb1, ga1, y_rb, y_ga, y_bias, 14);
+				y2[i] = RGB2YUV_SSE(rb2, ga2, y_rb, y_ga, y_bias, 14);
+				a1[i] = _mm_srli_epi32(px1, 24);
+				a2[i] = _mm_srli_epi32(px2, 24);
+
+				// 위아래를 더하고 옆 픽셀을 더하면 0, 2번째 32비트 자리에 2x2 합이 남는다
+				__m128i rb = _mm_add_epi16(rb1, rb2);
+				__m128i ga = _mm_add_epi16(ga1, ga2);
+				rb = _mm_add_epi16(rb, _mm_srli_epi64(rb, 32));
+				ga = _mm_add_epi16(ga, _mm_srli_epi64(ga, 32));
+				cb[i] = RGB2YUV_SSE(rb, ga, cb_rb, cb_ga, c_bias, 16);
+				cr[i] = RGB2YUV_SSE(rb, ga, cr_rb, cr_ga, c_bias, 16);
+			}
+
+			_mm_storeu_si128((__m128i*)(y_ptr1 + x), _mm_packus_epi16(_mm_packs_epi32(y1[0], y1[1]), _mm_packs_epi32(y1[2], y1[3])));
+			_mm_storeu_si128((__m128i*)(y_ptr2 + x), _mm_packus_epi16(_mm_packs_epi32(y2[0], y2[1]), _mm_packs_epi32(y2[2], y2[3])));
+			if (A)
+			{
+				_mm_storeu_si128((__m128i*)(a_ptr1 + x), _mm_packus_epi16(_mm_packs_epi32(a1[0], a1[1]), _mm_packs_epi32(a1[2], a1[3])));
+				_mm_storeu_si128((__m128i*)(a_ptr2 + x), _mm_packus_epi16(_mm_packs_epi32(a2[0], a2[1]), _mm_packs_epi32(a2[2], a2[3])));
+			}
+
+			const __m128i u16 = _mm_packs_epi32(MERGE_CHROMA_SSE(cb[0], cb[1]), MERGE_CHROMA_SSE(cb[2], cb[3]));
+			const __m128i v16 = _mm_packs_epi32(MERGE_CHROMA_SSE(cr[0], cr[1]), MERGE_CHROMA_SSE(cr[2], cr[3]));
+			_mm_storel_epi64((__m128i*)(u_ptr + x / 2), _mm_packus_epi16(u16, u16));
+			_mm_storel_epi64((__m128i*)(v_ptr + x / 2), _mm_packus_epi16(v16, v16));
+		}
+
+		rgba_yuv420_extra(x, width, rgba_ptr1, rgba_ptr2, y_ptr1, y_ptr2, u_ptr, v_ptr, a_ptr1, a_ptr2, yuv_type);
+	}
+
+	if (y < height)
+	{
+		const uint8_t* rgba_ptr = RGBA + y * RGBA_stride;
+		uint8_t* y_ptr = Y + y * Y_stride;
+		uint8_t* a_ptr = (A) ? A + y * A_stride : nullptr;
+		rgba_yuv420_extra(0, width, rgba_ptr, rgba_ptr, y_ptr, y_ptr, U + (y / 2) * U_stride, V + (y / 2) * V_stride, a_ptr, a_ptr, yuv_type);
 	}
 }
\ No newline at end of file
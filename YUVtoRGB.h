@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <intrin.h>
+#include <vector>
 
 enum YCbCrType
 {
@@ -38,7 +40,127 @@ static const YUV2RGBParam YUV2RGB[3] = {
 	YUV2RGB_PARAM(0.2126, 0.0722, 16.0, 235.0, 224.0)
 };
 
-void yuv420_rgb24_avx(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type);
-void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type);
-void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type);
-void yuv420_rgb24_extra(int w, int width, const uint8_t* y_ptr1, const uint8_t* y_ptr2, const uint8_t* u_ptr, const uint8_t* v_ptr, const uint8_t* a_ptr1, const uint8_t* a_ptr2, uint8_t* rgb_ptr1, uint8_t* rgb_ptr2, YCbCrType yuv_type);
\ No newline at end of file
+// RGBA -> YUV420 인코딩용 역변환 계수. 14비트 고정 소수점이고, 색차는 2x2 픽셀의 합에 곱하므로 16비트 내린다
+struct RGB2YUVParam
+{
+	int16_t y_r;  // [Rf*(YMax-YMin)/255]
+	int16_t y_g;  // [Gf*(YMax-YMin)/255]
+	int16_t y_b;  // [Bf*(YMax-YMin)/255]
+	int16_t cb_r; // [-Rf/(2*(1-Bf))*CbCrRange/255]
+	int16_t cb_g; // [-Gf/(2*(1-Bf))*CbCrRange/255]
+	int16_t cb_b; // [0.5*CbCrRange/255]
+	int16_t cr_r; // [0.5*CbCrRange/255]
+	int16_t cr_g; // [-Gf/(2*(1-Rf))*CbCrRange/255]
+	int16_t cr_b; // [-Bf/(2*(1-Rf))*CbCrRange/255]
+	uint8_t y_offset; // YMin
+};
+
+#define FIXED_POINT_SIGNED(value, precision) ((int16_t)(((value)*(1<<precision))+(((value) < 0) ? -0.5 : 0.5)))
+
+#define RGB2YUV_PARAM(Rf, Bf, YMin, YMax, CbCrRange) { \
+	FIXED_POINT_SIGNED(Rf * (YMax - YMin) / 255.0, 14), \
+	FIXED_POINT_SIGNED((1.0 - Rf - Bf) * (YMax - YMin) / 255.0, 14), \
+	FIXED_POINT_SIGNED(Bf * (YMax - YMin) / 255.0, 14), \
+	FIXED_POINT_SIGNED(-Rf / (2.0 * (1 - Bf)) * CbCrRange / 255.0, 14), \
+	FIXED_POINT_SIGNED(-(1.0 - Rf - Bf) / (2.0 * (1 - Bf)) * CbCrRange / 255.0, 14), \
+	FIXED_POINT_SIGNED(0.5 * CbCrRange / 255.0, 14), \
+	FIXED_POINT_SIGNED(0.5 * CbCrRange / 255.0, 14), \
+	FIXED_POINT_SIGNED(-(1.0 - Rf - Bf) / (2.0 * (1 - Rf)) * CbCrRange / 255.0, 14), \
+	FIXED_POINT_SIGNED(-Bf / (2.0 * (1 - Rf)) * CbCrRange / 255.0, 14), \
+	(uint8_t)YMin\
+}
+
+static const RGB2YUVParam RGB2YUV[3] = {
+	// ITU-T T.871 (JPEG)
+	RGB2YUV_PARAM(0.299, 0.114, 0.0, 255.0, 255.0),
+	// ITU-R BT.601-7
+	RGB2YUV_PARAM(0.299, 0.114, 16.0, 235.0, 224.0),
+	// ITU-R BT.709-6
+	RGB2YUV_PARAM(0.2126, 0.0722, 16.0, 235.0, 224.0)
+};
+
+// 알파 타일 한 변의 픽셀 수. SIMD 커널이 한 번에 32픽셀씩 처리하므로 타일 경계와 맞춘다
+#define ALPHA_TILE_SIZE 32
+
+// 커널은 타일마다 두 비트를 켜 두고 픽셀을 볼 때마다 AND하므로 둘 다 꺼지면 섞인 타일이다
+enum AlphaTileType
+{
+	ALPHA_TILE_MIXED = 0,
+	ALPHA_TILE_OPAQUE = 1,		// 모든 픽셀이 255. 블렌딩 없이 그려도 된다
+	ALPHA_TILE_TRANSPARENT = 2	// 모든 픽셀이 0. 올리거나 그리지 않아도 된다
+};
+
+// 변환하면서 같이 구하는 알파 분포. 커널에 넘기면 채우고, nullptr이면 구하지 않는다.
+// 알파 평면이 없으면 전체가 불투명으로 나온다
+struct AlphaCoverage
+{
+	// 알파가 0이 아닌 픽셀을 모두 감싸는 사각형 [left, right) x [top, bottom). 모두 투명하면 넓이가 0이다
+	uint32_t left;
+	uint32_t top;
+	uint32_t right;
+	uint32_t bottom;
+	uint32_t tiles_wide;
+	uint32_t tiles_high;
+	std::vector<uint8_t> tiles;	// 줄 순서의 AlphaTileType
+	uint32_t opaque_tiles;
+	uint32_t transparent_tiles;
+	uint32_t mixed_tiles;
+};
+
+void alpha_coverage_begin(AlphaCoverage* coverage, uint32_t width, uint32_t height, bool has_alpha);
+// (x, y), (x, y + 1)에서 시작하는 count(32 이하)픽셀 두 줄을 더한다. 픽셀들은 같은 타일 안에 있어야 한다.
+// zero1/zero2는 줄마다 알파가 0인 픽셀, opaque는 두 줄 모두 255인 픽셀의 비트 마스크(최하위 비트가 x)
+// SIMD 커널이 32픽셀마다 부르므로 함수 호출이 남지 않게 헤더에 둔다
+inline void alpha_coverage_add(AlphaCoverage* coverage, uint32_t x, uint32_t y, uint32_t count, uint32_t zero1, uint32_t zero2, uint32_t opaque)
+{
+	const uint32_t valid = (count >= 32) ? 0xFFFFFFFF : (1u << count) - 1;
+	const uint32_t visible = (~zero1 | ~zero2) & valid;
+	uint8_t& tile = coverage->tiles[(y / ALPHA_TILE_SIZE) * coverage->tiles_wide + x / ALPHA_TILE_SIZE];
+	if ((opaque & valid) != valid)
+		tile &= ~ALPHA_TILE_OPAQUE;
+	if (!visible)
+		return;
+
+	tile &= ~ALPHA_TILE_TRANSPARENT;
+	unsigned long first, last;
+	_BitScanForward(&first, visible);
+	_BitScanReverse(&last, visible);
+	const uint32_t left = x + static_cast<uint32_t>(first);
+	const uint32_t right = x + static_cast<uint32_t>(last) + 1;
+	const uint32_t top = (~zero1 & valid) ? y : y + 1;
+	const uint32_t bottom = (~zero2 & valid) ? y + 2 : y + 1;
+	coverage->left = (left < coverage->left) ? left : coverage->left;
+	coverage->right = (right > coverage->right) ? right : coverage->right;
+	coverage->top = (top < coverage->top) ? top : coverage->top;
+	coverage->bottom = (bottom > coverage->bottom) ? bottom : coverage->bottom;
+}
+void alpha_coverage_end(AlphaCoverage* coverage);
+// 한 값으로 채워진 알파 평면의 분포를 커널을 거치지 않고 채운다
+void alpha_coverage_fill(AlphaCoverage* coverage, uint32_t width, uint32_t height, uint8_t alpha);
+
+// 알파 평면 전체가 한 값이면 그 값을, 아니면 -1을 돌려준다. 줄마다 확인해서 다른 값이 나오면 바로 멈춘다
+int alpha_plane_constant_avx(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride);
+int alpha_plane_constant_sse(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride);
+int alpha_plane_constant_std(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride);
+
+// 평면을 block_size(8 또는 16) 블록으로 나눠 prev와 비교하고, 다른 블록은 dirty(줄 순서, 블록마다 1바이트)에 1을 켜고
+// prev에 새 값을 복사한다. dirty에는 다른 평면이 켠 값이 남아 있어도 된다. 이 평면에서 바뀐 블록 수를 돌려준다
+uint32_t plane_diff_blocks_avx(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride);
+uint32_t plane_diff_blocks_sse(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride);
+uint32_t plane_diff_blocks_std(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride);
+// plane_diff_blocks의 블록 줄 [top, bottom)을 마무리한다. 비교하면서 2로 표시한 블록을 prev에 복사하고 1로 바꾼다
+uint32_t plane_diff_copy_blocks(uint32_t width, uint32_t top, uint32_t bottom, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty_row);
+
+void yuv420_rgb24_avx(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage);
+void yuv420_rgb24_sse(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage);
+void yuv420_rgb24_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage);
+// 변환과 축소를 한 번에 한다. 출력 픽셀마다 원본 영역의 평균을 구해서 한 번만 변환한다
+void yuv420_rgba_scale_std(uint32_t width, uint32_t height, const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, uint8_t* RGBA, uint32_t RGBA_width, uint32_t RGBA_height, uint32_t RGBA_stride, YCbCrType yuv_type);
+void yuv420_rgb24_extra(int w, int width, const uint8_t* y_ptr1, const uint8_t* y_ptr2, const uint8_t* u_ptr, const uint8_t* v_ptr, const uint8_t* a_ptr1, const uint8_t* a_ptr2, uint8_t* rgb_ptr1, uint8_t* rgb_ptr2, YCbCrType yuv_type, uint32_t h, AlphaCoverage* coverage);
+// RGBA를 YUV420으로 바꾼다. 색차는 2x2 픽셀의 평균이고, A가 nullptr이 아니면 알파 채널을 그대로 알파 평면에 복사한다.
+// 홀수 폭과 높이는 마지막 열과 줄을 한 번 더 쓴 것처럼 평균을 낸다. SIMD 커널도 std와 바이트 단위로 같은 값을 낸다
+void rgba_yuv420_avx(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type);
+void rgba_yuv420_sse(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type);
+void rgba_yuv420_std(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type);
+// 두 줄의 x(짝수)부터 끝까지를 변환한다. 마지막 홀수 줄은 rgba_ptr2/y_ptr2/a_ptr2에 첫 줄을 다시 넘긴다
+void rgba_yuv420_extra(uint32_t x, uint32_t width, const uint8_t* rgba_ptr1, const uint8_t* rgba_ptr2, uint8_t* y_ptr1, uint8_t* y_ptr2, uint8_t* u_ptr, uint8_t* v_ptr, uint8_t* a_ptr1, uint8_t* a_ptr2, YCbCrType yuv_type);
\ No newline at end of file
@@ -46,10 +46,12 @@
 void yuv420_rgb24_avx(uint32_t width, uint32_t height,
 	const uint8_t* Y, const uint8_t* U, const uint8_t* V, const uint8_t* A,
 	uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride,
-	uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type)
+	uint8_t* RGBA, uint32_t RGBA_stride, YCbCrType yuv_type, AlphaCoverage* coverage)
 {
 	const YUV2RGBParam* const param = &(YUV2RGB[yuv_type]);
-	for (uint32_t h = 0; h < (height - 1); h += 2)
+	if (coverage)
+		alpha_coverage_begin(coverage, width, height, A != nullptr);
+	for (uint32_t h = 0; h + 1 < height; h += 2)
 	{
 		const uint8_t* y_ptr1 = Y + h * Y_stride;
 		const uint8_t* y_ptr2 = Y + (h + 1) * Y_stride;
@@ -61,16 +63,18 @@ void yuv420_rgb24_avx(uint32_t width, uint32_t height,
 		uint8_t* rgba_ptr2 = RGBA + (h + 1) * RGBA_stride;
 
 		uint32_t w = 0;
-		for (; w < (width - 31); w += 32)
+		// width가 32보다 작을 때 부호 없는 뺄셈이 넘치지 않도록 더해서 비교한다
+		for (; w + 31 < width; w += 32)
 		{
-			__m256i u = LOAD_SI256((const __m256i*)u_ptr);
-			__m256i v = LOAD_SI256((const __m256i*)v_ptr);
+			// 32픽셀에 필요한 U, V는 16바이트씩이다. u_ptr은 16바이트씩 나아가므로 256비트로 읽으면 정렬이 깨진다
+			__m128i u = _mm_load_si128((const __m128i*)u_ptr);
+			__m128i v = _mm_load_si128((const __m128i*)v_ptr);
 
-			u = _mm256_sub_epi8(u, _mm256_set1_epi8(128));
-			v = _mm256_sub_epi8(v, _mm256_set1_epi8(128));
+			u = _mm_sub_epi8(u, _mm_set1_epi8((char)128));
+			v = _mm_sub_epi8(v, _mm_set1_epi8((char)128));
 
-			__m256i u_16_1 = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(u));
-			__m256i v_16_1 = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(v));
+			__m256i u_16_1 = _mm256_cvtepi8_epi16(u);
+			__m256i v_16_1 = _mm256_cvtepi8_epi16(v);
 
 			__m256i r_tmp, g_tmp, b_tmp;
 			__m256i r_uv_16_1, g_uv_16_1, b_uv_16_1;
@@ -128,6 +132,16 @@ void yuv420_rgb24_avx(uint32_t width, uint32_t height,
 			__m256i a_8_2 = (a_ptr2) ? LOAD_SI256((const __m256i*)a_ptr2) :
 				_mm256_set1_epi8((char)255);
 
+			if (coverage && a_ptr1)
+			{
+				const __m256i zero = _mm256_setzero_si256();
+				const __m256i full = _mm256_set1_epi8((char)255);
+				const uint32_t zero1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_8_1, zero)));
+				const uint32_t zero2 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_8_2, zero)));
+				const uint32_t opaque = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(a_8_1, a_8_2), full)));
+				alpha_coverage_add(coverage, w, h, 32, zero1, zero2, opaque);
+			}
+
 			__m256i rgba1[4], rgba2[4];
 			PACK_RGBA32_32_AVX(r_8_1, g_8_1, b_8_1, a_8_1, rgba1);
 			PACK_RGBA32_32_AVX(r_8_2, g_8_2, b_8_2, a_8_2, rgba2);
@@ -147,7 +161,188 @@ void yuv420_rgb24_avx(uint32_t width, uint32_t height,
 
 		// 남은 픽셀 처리
 		yuv420_rgb24_extra(w, width, y_ptr1, y_ptr2, u_ptr, v_ptr,
-			a_ptr1, a_ptr2, rgba_ptr1, rgba_ptr2, yuv_type);
+			a_ptr1, a_ptr2, rgba_ptr1, rgba_ptr2, yuv_type, h, coverage);
+	}
+
+	_mm256_zeroupper();
+	if (coverage)
+		alpha_coverage_end(coverage);
+}
+
+int alpha_plane_constant_avx(uint32_t width, uint32_t height, const uint8_t* A, uint32_t A_stride)
+{
+	if (width == 0 || height == 0)
+		return -1;
+
+	const uint8_t value = A[0];
+	const __m256i expected = _mm256_set1_epi8(static_cast<char>(value));
+	int result = value;
+	for (uint32_t y = 0; y < height && result >= 0; ++y)
+	{
+		const uint8_t* a_ptr = A + y * A_stride;
+
+		// 한 줄의 차이를 OR로 모아서 줄 끝에서 한 번만 확인한다
+		__m256i diff = _mm256_setzero_si256();
+		uint32_t x = 0;
+		for (; x + 64 <= width; x += 64)
+		{
+			diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a_ptr + x)), expected));
+			diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a_ptr + x + 32)), expected));
+		}
+		if (!_mm256_testz_si256(diff, diff))
+			result = -1;
+
+		for (; x < width && result >= 0; ++x)
+		{
+			if (a_ptr[x] != value)
+				result = -1;
+		}
+	}
+
+	_mm256_zeroupper();
+	return result;
+}
+
+uint32_t plane_diff_blocks_avx(uint32_t width, uint32_t height, uint32_t block_size, const uint8_t* src, uint32_t src_stride, uint8_t* prev, uint32_t prev_stride, uint8_t* dirty, uint32_t dirty_stride)
+{
+	const uint32_t block_mask = (1u << block_size) - 1;
+	uint32_t changed = 0;
+	for (uint32_t top = 0; top < height; top += block_size)
+	{
+		const uint32_t bottom = (top + block_size < height) ? top + block_size : height;
+		uint8_t* dirty_row = dirty + (top / block_size) * dirty_stride;
+		for (uint32_t y = top; y < bottom; ++y)
+		{
+			const uint8_t* src_ptr = src + y * src_stride;
+			const uint8_t* prev_ptr = prev + y * prev_stride;
+			uint32_t x = 0;
+			for (; x + 32 <= width; x += 32)
+			{
+				const __m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src_ptr + x)), _mm256_loadu_si256((const __m256i*)(prev_ptr + x)));
+				uint32_t diff = ~static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+
+				// 다른 바이트가 있는 블록마다 한 번씩 표시한다. x가 32의 배수라서 블록은 x에서 시작한다
+				while (diff)
+				{
+					unsigned long index;
+					_BitScanForward(&index, diff);
+					const uint32_t bx = (x + index) / block_size;
+					dirty_row[bx] = 2;
+					diff &= ~(block_mask << (bx * block_size - x));
+				}
+			}
+
+			for (; x < width; ++x)
+			{
+				if (src_ptr[x] != prev_ptr[x])
+					dirty_row[x / block_size] = 2;
+			}
+		}
+		changed += plane_diff_copy_blocks(width, top, bottom, block_size, src, src_stride, prev, prev_stride, dirty_row);
+	}
+
+	_mm256_zeroupper();
+	return changed;
+}
+
+static inline int coef_pair_avx(int16_t lo, int16_t hi)
+{
+	return static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16) | static_cast<uint16_t>(lo));
+}
+
+// 8픽셀을 16비트 [R, B], [G, A] 쌍으로 나눈다
+#define SPLIT_RGBA_AVX(PX, RB, GA) \
+	RB = _mm256_and_si256(PX, _mm256_set1_epi16(0x00FF)); \
+	GA = _mm256_srli_epi16(PX, 8);
+
+#define RGB2YUV_AVX(RB, GA, C_RB, C_GA, BIAS, SHIFT) \
+	_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(RB, C_RB), _mm256_madd_epi16(GA, C_GA)), BIAS), SHIFT)
+
+// 32비트 값 16개를 순서대로 16바이트로 줄인다
+static inline __m128i pack_16_avx(__m256i p0, __m256i p1)
+{
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(p0, p1), _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+}
+
+// 두 8픽셀 묶음의 32비트 색차(짝수 자리)를 순서대로 8바이트로 줄인다
+static inline __m128i pack_chroma_avx(__m256i c0, __m256i c1)
+{
+	const __m256i merged = _mm256_permutevar8x32_epi32(_mm256_blend_epi32(c0, _mm256_slli_epi64(c1, 32), 0xAA),
+		_mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+	const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(merged), _mm256_extracti128_si256(merged, 1));
+	return _mm_packus_epi16(packed, packed);
+}
+
+void rgba_yuv420_avx(uint32_t width, uint32_t height, const uint8_t* RGBA, uint32_t RGBA_stride, uint8_t* Y, uint8_t* U, uint8_t* V, uint8_t* A, uint32_t Y_stride, uint32_t U_stride, uint32_t V_stride, uint32_t A_stride, YCbCrType yuv_type)
+{
+	const RGB2YUVParam* const param = &(RGB2YUV[yuv_type]);
+	const __m256i y_rb = _mm256_set1_epi32(coef_pair_avx(param->y_r, param->y_b));
+	const __m256i y_ga = _mm256_set1_epi32(coef_pair_avx(param->y_g, 0));
+	const __m256i cb_rb = _mm256_set1_epi32(coef_pair_avx(param->cb_r, param->cb_b));
+	const __m256i cb_ga = _mm256_set1_epi32(coef_pair_avx(param->cb_g, 0));
+	const __m256i cr_rb = _mm256_set1_epi32(coef_pair_avx(param->cr_r, param->cr_b));
+	const __m256i cr_ga = _mm256_set1_epi32(coef_pair_avx(param->cr_g, 0));
+	const __m256i y_bias = _mm256_set1_epi32((param->y_offset << 14) + (1 << 13));
+	const __m256i c_bias = _mm256_set1_epi32((128 << 16) + (1 << 15));
+
+	uint32_t y = 0;
+	for (; y + 1 < height; y += 2)
+	{
+		const uint8_t* rgba_ptr1 = RGBA + y * RGBA_stride;
+		const uint8_t* rgba_ptr2 = RGBA + (y + 1) * RGBA_stride;
+		uint8_t* y_ptr1 = Y + y * Y_stride;
+		uint8_t* y_ptr2 = Y + (y + 1) * Y_stride;
+		uint8_t* u_ptr = U + (y / 2) * U_stride;
+		uint8_t* v_ptr = V + (y / 2) * V_stride;
+		uint8_t* a_ptr1 = (A) ? A + y * A_stride : nullptr;
+		uint8_t* a_ptr2 = (A) ? A + (y + 1) * A_stride : nullptr;
+
+		uint32_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m256i y1[2], y2[2], a1[2], a2[2], cb[2], cr[2];
+			for (int i = 0; i < 2; ++i)
+			{
+				const __m256i px1 = _mm256_loadu_si256((const __m256i*)(rgba_ptr1 + (x + i * 8) * 4));
+				const __m256i px2 = _mm256_loadu_si256((const __m256i*)(rgba_ptr2 + (x + i * 8) * 4));
+				__m256i rb1, ga1, rb2, ga2;
+				SPLIT_RGBA_AVX(px1, rb1, ga1)
+				SPLIT_RGBA_AVX(px2, rb2, ga2)
+				y1[i] = RGB2YUV_AVX(rb1, ga1, y_rb, y_ga, y_bias, 14);
+				y2[i] = RGB2YUV_AVX(rb2, ga2, y_rb, y_ga, y_bias, 14);
+				a1[i] = _mm256_srli_epi32(px1, 24);
+				a2[i] = _mm256_srli_epi32(px2, 24);
+
+				// 위아래를 더하고 옆 픽셀을 더하면 짝수 번째 32비트 자리에 2x2 합이 남는다
+				__m256i rb = _mm256_add_epi16(rb1, rb2);
+				__m256i ga = _mm256_add_epi16(ga1, ga2);
+				rb = _mm256_add_epi16(rb, _mm256_srli_epi64(rb, 32));
+				ga = _mm256_add_epi16(ga, _mm256_srli_epi64(ga, 32));
+				cb[i] = RGB2YUV_AVX(rb, ga, cb_rb, cb_ga, c_bias, 16);
+				cr[i] = RGB2YUV_AVX(rb, ga, cr_rb, cr_ga, c_bias, 16);
+			}
+
+			_mm_storeu_si128((__m128i*)(y_ptr1 + x), pack_16_avx(y1[0], y1[1]));
+			_mm_storeu_si128((__m128i*)(y_ptr2 + x), pack_16_avx(y2[0], y2[1]));
+			if (A)
+			{
+				_mm_storeu_si128((__m128i*)(a_ptr1 + x), pack_16_avx(a1[0], a1[1]));
+				_mm_storeu_si128((__m128i*)(a_ptr2 + x), pack_16_avx(a2[0], a2[1]));
+			}
+			_mm_storel_epi64((__m128i*)(u_ptr + x / 2), pack_chroma_avx(cb[0], cb[1]));
+			_mm_storel_epi64((__m128i*)(v_ptr + x / 2), pack_chroma_avx(cr[0], cr[1]));
+		}
+
+		rgba_yuv420_extra(x, width, rgba_ptr1, rgba_ptr2, y_ptr1, y_ptr2, u_ptr, v_ptr, a_ptr1, a_ptr2, yuv_type);
+	}
+
+	if (y < height)
+	{
+		const uint8_t* rgba_ptr = RGBA + y * RGBA_stride;
+		uint8_t* y_ptr = Y + y * Y_stride;
+		uint8_t* a_ptr = (A) ? A + y * A_stride : nullptr;
+		rgba_yuv420_extra(0, width, rgba_ptr, rgba_ptr, y_ptr, y_ptr, U + (y / 2) * U_stride, V + (y / 2) * V_stride, a_ptr, a_ptr, yuv_type);
 	}
 
 	_mm256_zeroupper();
@@ -0,0 +1,185 @@
+#include "BenchTable.h"
+#include "CorpusGenerator.h"
+#include "EncodeBench.h"
+#include "KernelBench.h"
+#include "KernelVerify.h"
+#include "PipelineBench.h"
+#include "TextureBench.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void print_usage()
+{
+	std::cout << "usage: WebmBench [kernels|verify|corpus|e2e|switch|texture|encode] [options]" << std::endl;
+	std::cout << "  kernels             YUV -> RGBA kernel benchmark (default)" << std::endl;
+	std::cout << "  verify              compare every kernel with std byte for byte, exits with 1 on mismatch" << std::endl;
+	std::cout << "  corpus              generate the synthetic WebM corpus (VP8/VP9, alpha, resolutions, bitrates)" << std::endl;
+	std::cout << "  e2e                 decode-only, convert-only, full pipeline and paced playback fps per clip" << std::endl;
+	std::cout << "  switch              clip switch latency and pool reuse across resolutions" << std::endl;
+	std::cout << "  texture             RGBA -> BC3/BC7 block compression fps, single thread and thread pool" << std::endl;
+	std::cout << "  encode              RGBA -> VP8/VP9 alpha WebM encode fps, color and alpha encoders in parallel" << std::endl;
+	std::cout << "options:" << std::endl;
+	std::cout << "  --kernel <name>     run only this kernel (std is always run as the baseline), or bc3/bc7 for texture, vp8/vp9 for encode" << std::endl;
+	std::cout << "  --res <name>        run only this resolution (240p, 360p, 480p, 720p, 1080p, 1440p, 4K, 8K)" << std::endl;
+	std::cout << "  --min-time <ms>     minimum time per case (default 200)" << std::endl;
+	std::cout << "  --quick             fewer runs per case" << std::endl;
+	std::cout << "  --cases <n>         random verify cases (default 3000)" << std::endl;
+	std::cout << "  --seed <n>          random verify seed (default 1)" << std::endl;
+	std::cout << "  --replay <file>     verify real frames from this clip (default ..\\dancer1.webm)" << std::endl;
+	std::cout << "  --no-replay         verify random cases only" << std::endl;
+	std::cout << "  --strict            verify 601/709 outside the nominal range too" << std::endl;
+	std::cout << "  --corpus <dir>      corpus directory (default corpus)" << std::endl;
+	std::cout << "  --clip <filter>     use only clips whose name contains this (e.g. vp9_1080p)" << std::endl;
+	std::cout << "  --force             regenerate existing corpus clips" << std::endl;
+	std::cout << "  --csv <file>        write results as CSV" << std::endl;
+	std::cout << "  --json <file>       write results as JSON" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string mode = "kernels";
+	std::string csvPath;
+	std::string jsonPath;
+	KernelBenchOptions kernelOptions;
+	kernelOptions.min_time_ms = 200.0;
+	kernelOptions.min_runs = 5;
+	kernelOptions.max_runs = 1000;
+	PipelineBenchOptions pipelineOptions;
+	pipelineOptions.corpus_dir = "corpus";
+	pipelineOptions.min_time_ms = 1000.0;
+	pipelineOptions.min_runs = 3;
+	pipelineOptions.max_runs = 50;
+	bool force = false;
+	KernelVerifyOptions verifyOptions;
+	verifyOptions.replay_file = "..\\dancer1.webm";
+	verifyOptions.cases = 3000;
+	verifyOptions.seed = 1;
+	verifyOptions.strict = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--kernel" && hasValue)
+		{
+			kernelOptions.kernel_filter = argv[++i];
+			verifyOptions.kernel_filter = kernelOptions.kernel_filter;
+		}
+		else if (arg == "--res" && hasValue)
+			kernelOptions.resolution_filter = argv[++i];
+		else if (arg == "--min-time" && hasValue)
+		{
+			kernelOptions.min_time_ms = atof(argv[++i]);
+			pipelineOptions.min_time_ms = kernelOptions.min_time_ms;
+		}
+		else if (arg == "--quick")
+		{
+			kernelOptions.min_time_ms = 20.0;
+			kernelOptions.min_runs = 3;
+			pipelineOptions.min_time_ms = 0.0;
+			pipelineOptions.min_runs = 1;
+		}
+		else if (arg == "--cases" && hasValue)
+			verifyOptions.cases = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (arg == "--seed" && hasValue)
+			verifyOptions.seed = static_cast<uint32_t>(atoi(argv[++i]));
+		else if (arg == "--replay" && hasValue)
+			verifyOptions.replay_file = argv[++i];
+		else if (arg == "--no-replay")
+			verifyOptions.replay_file.clear();
+		else if (arg == "--strict")
+			verifyOptions.strict = true;
+		else if (arg == "--corpus" && hasValue)
+			pipelineOptions.corpus_dir = argv[++i];
+		else if (arg == "--clip" && hasValue)
+			pipelineOptions.clip_filter = argv[++i];
+		else if (arg == "--force")
+			force = true;
+		else if (arg == "--csv" && hasValue)
+			csvPath = argv[++i];
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg[0] != '-' && i == 1)
+			mode = arg;
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (mode == "corpus")
+	{
+		const std::vector<CorpusClip> clips = GetCorpusClips(pipelineOptions.clip_filter);
+		if (clips.empty())
+		{
+			std::cout << "no clip matched the filter" << std::endl;
+			return 1;
+		}
+		return GenerateCorpus(pipelineOptions.corpus_dir, clips, force) ? 0 : 1;
+	}
+
+	if (mode == "verify")
+	{
+		BenchTable table(GetKernelVerifyColumns());
+		const bool passed = RunKernelVerify(verifyOptions, table);
+		table.Print();
+		if (!csvPath.empty())
+			table.WriteCsv(csvPath);
+		if (!jsonPath.empty())
+			table.WriteJson(jsonPath);
+		return (passed) ? 0 : 1;
+	}
+
+	std::vector<std::string> columns;
+	if (mode == "kernels")
+		columns = GetKernelBenchColumns();
+	else if (mode == "e2e")
+		columns = GetPipelineBenchColumns();
+	else if (mode == "switch")
+		columns = GetSwitchBenchColumns();
+	else if (mode == "texture")
+		columns = GetTextureBenchColumns();
+	else if (mode == "encode")
+		columns = GetEncodeBenchColumns();
+	else
+	{
+		print_usage();
+		return 1;
+	}
+
+	BenchTable table(columns);
+	bool ran = false;
+	if (mode == "kernels")
+		ran = RunKernelBench(kernelOptions, table);
+	else if (mode == "e2e")
+		ran = RunPipelineBench(pipelineOptions, table);
+	else if (mode == "texture")
+		ran = RunTextureBench(kernelOptions, table);
+	else if (mode == "encode")
+		ran = RunEncodeBench(kernelOptions, table);
+	else
+		ran = RunSwitchBench(pipelineOptions, table);
+
+	if (!ran)
+	{
+		std::cout << "no benchmark matched the filters" << std::endl;
+		return 1;
+	}
+	table.Print();
+
+	if (!csvPath.empty() && !table.WriteCsv(csvPath))
+	{
+		std::cout << "failed to write " << csvPath << std::endl;
+		return 1;
+	}
+	if (!jsonPath.empty() && !table.WriteJson(jsonPath))
+	{
+		std::cout << "failed to write " << jsonPath << std::endl;
+		return 1;
+	}
+	return 0;
+}
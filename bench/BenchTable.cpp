@@ -0,0 +1,131 @@
+#include "BenchTable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+static std::string json_escape(const std::string &text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+BenchTable::BenchTable(const std::vector<std::string> &columns) : mColumns(columns)
+{
+}
+
+void BenchTable::AddRow()
+{
+	mRows.emplace_back();
+}
+
+void BenchTable::Add(const std::string &text)
+{
+	mRows.back().push_back({ text, false });
+}
+
+void BenchTable::Add(const char *text)
+{
+	Add(std::string(text));
+}
+
+void BenchTable::Add(double number, int precision /*= 3*/)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.*f", precision, number);
+	mRows.back().push_back({ buffer, true });
+}
+
+void BenchTable::Add(uint64_t number)
+{
+	mRows.back().push_back({ std::to_string(number), true });
+}
+
+void BenchTable::Print() const
+{
+	std::vector<size_t> widths(mColumns.size());
+	for (size_t i = 0; i < mColumns.size(); ++i)
+		widths[i] = mColumns[i].size();
+	for (const std::vector<Cell> &row : mRows)
+	{
+		for (size_t i = 0; i < row.size() && i < widths.size(); ++i)
+			widths[i] = std::max(widths[i], row[i].text.size());
+	}
+
+	auto printRow = [&widths](const std::vector<std::string> &cells) {
+		std::string line;
+		for (size_t i = 0; i < cells.size(); ++i)
+		{
+			line += cells[i];
+			line.append(widths[i] - cells[i].size() + 2, ' ');
+		}
+		std::cout << line << std::endl;
+	};
+
+	printRow(mColumns);
+	for (const std::vector<Cell> &row : mRows)
+	{
+		std::vector<std::string> cells;
+		for (const Cell &cell : row)
+			cells.push_back(cell.text);
+		cells.resize(mColumns.size());
+		printRow(cells);
+	}
+}
+
+bool BenchTable::WriteCsv(const std::string &fileName) const
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, fileName.c_str(), "wb"))
+		return false;
+
+	for (size_t i = 0; i < mColumns.size(); ++i)
+		fprintf(file, "%s%s", (i > 0) ? "," : "", mColumns[i].c_str());
+	fprintf(file, "\n");
+
+	for (const std::vector<Cell> &row : mRows)
+	{
+		for (size_t i = 0; i < row.size(); ++i)
+			fprintf(file, "%s%s", (i > 0) ? "," : "", row[i].text.c_str());
+		fprintf(file, "\n");
+	}
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+bool BenchTable::WriteJson(const std::string &fileName) const
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, fileName.c_str(), "wb"))
+		return false;
+
+	fprintf(file, "{\n\"columns\": [");
+	for (size_t i = 0; i < mColumns.size(); ++i)
+		fprintf(file, "%s\"%s\"", (i > 0) ? ", " : "", json_escape(mColumns[i]).c_str());
+	fprintf(file, "],\n\"rows\": [\n");
+
+	for (size_t r = 0; r < mRows.size(); ++r)
+	{
+		const std::vector<Cell> &row = mRows[r];
+		fprintf(file, "{");
+		for (size_t i = 0; i < row.size() && i < mColumns.size(); ++i)
+		{
+			const std::string value = (row[i].is_number) ? row[i].text : "\"" + json_escape(row[i].text) + "\"";
+			fprintf(file, "%s\"%s\": %s", (i > 0) ? ", " : "", json_escape(mColumns[i]).c_str(), value.c_str());
+		}
+		fprintf(file, "}%s\n", (r + 1 < mRows.size()) ? "," : "");
+	}
+	fprintf(file, "]\n}\n");
+
+	const bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
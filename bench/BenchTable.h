@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 벤치마크 결과 표. 화면 출력과 회귀 추적용 CSV/JSON을 같은 데이터로 만든다
+class BenchTable
+{
+public:
+	explicit BenchTable(const std::vector<std::string> &columns);
+
+public:
+	void AddRow();
+	// 현재 행의 다음 칸을 채운다
+	void Add(const std::string &text);
+	void Add(const char *text);
+	void Add(double number, int precision = 3);
+	void Add(uint64_t number);
+
+	size_t GetRowCount() const { return mRows.size(); }
+	void Print() const;
+	bool WriteCsv(const std::string &fileName) const;
+	// {"columns": [...], "rows": [{column: value, ...}, ...]}
+	bool WriteJson(const std::string &fileName) const;
+
+private:
+	struct Cell
+	{
+		std::string text;
+		bool is_number;
+	};
+
+private:
+	std::vector<std::string> mColumns;
+	std::vector<std::vector<Cell>> mRows;
+};
@@ -0,0 +1,453 @@
+#include "CorpusGenerator.h"
+#include "../WebmDecoder.h"
+#include "../WebmEncoder.h"
+
+#include <mkvmuxer.h>
+#include <vpx_encoder.h>
+#include <vp8cx.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <windows.h>
+
+#define CORPUS_FRAME_COUNT 90
+#define CORPUS_FRAMERATE 30
+// 역재생, 탐색, 배속 재생이 GOP 경계를 만나도록 1초마다 키 프레임을 넣는다
+#define CORPUS_KEY_FRAME_INTERVAL 30
+#define CORPUS_CPU_USED 8
+#define CORPUS_MAX_THREADS 8
+#define ALPHA_BLOCK_ADDITIONAL_ID 1
+// 해상도를 바꾸는 클립. 720p -> 360p -> 720p -> 360p로 가면서 출력 버퍼가 작아졌다가 다시 커진다.
+// VP9는 참조 프레임을 절반까지만 줄여서 예측할 수 있으므로 두 해상도는 2배 차이다
+#define CORPUS_RESIZE_BITRATE 2500
+
+struct corpus_resolution
+{
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bitrate_kbps;	// 기본 비트레이트. 높은 비트레이트 클립은 이것의 4배
+};
+
+static const corpus_resolution RESOLUTIONS[] = {
+	{ "360p", 640, 360, 800 },
+	{ "720p", 1280, 720, 2500 },
+	{ "1080p", 1920, 1080, 5000 },
+	{ "4K", 3840, 2160, 16000 },
+};
+
+struct encoded_packet
+{
+	std::vector<uint8_t> data;
+	int64_t pts;
+	bool is_key;
+};
+
+std::vector<CorpusClip> GetCorpusClips(const std::string &filter)
+{
+	std::vector<CorpusClip> clips;
+	for (uint32_t fourcc : { VP8_FOURCC, VP9_FOURCC })
+	{
+		for (const corpus_resolution &resolution : RESOLUTIONS)
+		{
+			for (bool alpha : { false, true })
+			{
+				for (uint32_t scale : { 1, 4 })
+				{
+					CorpusClip clip;
+					clip.resolution = resolution.name;
+					clip.fourcc = fourcc;
+					clip.width = resolution.width;
+					clip.height = resolution.height;
+					clip.bitrate_kbps = resolution.bitrate_kbps * scale;
+					clip.frame_count = CORPUS_FRAME_COUNT;
+					clip.framerate = CORPUS_FRAMERATE;
+					clip.has_alpha = alpha;
+					clip.name = std::string((fourcc == VP9_FOURCC) ? "vp9_" : "vp8_") + resolution.name +
+						((alpha) ? "_alpha_" : "_") + std::to_string(clip.bitrate_kbps) + "k";
+
+					clip.resize_width = 0;
+					clip.resize_height = 0;
+					if (filter.empty() || clip.name.find(filter) != std::string::npos)
+						clips.push_back(clip);
+				}
+			}
+		}
+
+		for (bool alpha : { false, true })
+		{
+			CorpusClip clip;
+			clip.resolution = "720p-360p";
+			clip.fourcc = fourcc;
+			clip.width = RESOLUTIONS[1].width;
+			clip.height = RESOLUTIONS[1].height;
+			clip.bitrate_kbps = CORPUS_RESIZE_BITRATE;
+			clip.frame_count = CORPUS_FRAME_COUNT;
+			clip.framerate = CORPUS_FRAMERATE;
+			clip.has_alpha = alpha;
+			clip.resize_width = RESOLUTIONS[0].width;
+			clip.resize_height = RESOLUTIONS[0].height;
+			clip.name = std::string((fourcc == VP9_FOURCC) ? "vp9_resize_720p_360p" : "vp8_resize_720p_360p") +
+				((alpha) ? "_alpha_" : "_") + std::to_string(clip.bitrate_kbps) + "k";
+
+			if (filter.empty() || clip.name.find(filter) != std::string::npos)
+				clips.push_back(clip);
+		}
+	}
+	return clips;
+}
+
+void GetCorpusFrameSize(const CorpusClip &clip, uint32_t frame, uint32_t &width, uint32_t &height)
+{
+	// 키 프레임 사이에서 바꿔서 크기가 바뀐 첫 프레임이 인터 프레임이 되게 한다
+	const bool resized = clip.resize_width != 0 && ((frame + CORPUS_KEY_FRAME_INTERVAL / 2) / CORPUS_KEY_FRAME_INTERVAL) % 2 == 1;
+	width = (resized) ? clip.resize_width : clip.width;
+	height = (resized) ? clip.resize_height : clip.height;
+}
+
+std::string GetCorpusPath(const std::string &directory, const CorpusClip &clip)
+{
+	return directory + "\\" + clip.name + ".webm";
+}
+
+static void fill_frame(vpx_image_t *img, vpx_image_t *imgAlpha, uint32_t frame)
+{
+	const uint32_t width = img->d_w;
+	const uint32_t height = img->d_h;
+
+	// 가로세로로 흐르는 XOR 무늬. 고주파 성분이 있어서 비트레이트에 따라 디코딩 비용이 달라진다
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t *row = img->planes[VPX_PLANE_Y] + y * img->stride[VPX_PLANE_Y];
+		for (uint32_t x = 0; x < width; ++x)
+			row[x] = static_cast<uint8_t>((x + frame * 3) ^ (y + frame));
+	}
+
+	for (uint32_t y = 0; y < (height + 1) / 2; ++y)
+	{
+		uint8_t *rowU = img->planes[VPX_PLANE_U] + y * img->stride[VPX_PLANE_U];
+		uint8_t *rowV = img->planes[VPX_PLANE_V] + y * img->stride[VPX_PLANE_V];
+		for (uint32_t x = 0; x < (width + 1) / 2; ++x)
+		{
+			rowU[x] = static_cast<uint8_t>(64 + ((x + frame) & 127));
+			rowV[x] = static_cast<uint8_t>(64 + ((y + frame * 2) & 127));
+		}
+	}
+
+	if (!imgAlpha)
+		return;
+
+	// 완전 투명, 반투명, 불투명 구간이 모두 생기도록 가로로 움직이는 경사
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t *row = imgAlpha->planes[VPX_PLANE_Y] + y * imgAlpha->stride[VPX_PLANE_Y];
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint32_t position = (x + frame * 8) % width;
+			row[x] = static_cast<uint8_t>(std::min<uint32_t>(position * 512 / width, 255));
+		}
+	}
+}
+
+static void fill_neutral_chroma(vpx_image_t *img)
+{
+	for (int plane : { VPX_PLANE_U, VPX_PLANE_V })
+	{
+		for (uint32_t y = 0; y < (img->d_h + 1) / 2; ++y)
+			memset(img->planes[plane] + y * img->stride[plane], 128, (img->d_w + 1) / 2);
+	}
+}
+
+static bool init_encoder(vpx_codec_ctx_t *codec, vpx_codec_enc_cfg_t &cfg, const CorpusClip &clip, uint32_t bitrateKbps)
+{
+	vpx_codec_iface_t *iface = (clip.fourcc == VP9_FOURCC) ? vpx_codec_vp9_cx() : vpx_codec_vp8_cx();
+	if (vpx_codec_enc_config_default(iface, &cfg, 0))
+		return false;
+
+	cfg.g_w = clip.width;
+	cfg.g_h = clip.height;
+	cfg.g_timebase.num = 1;
+	cfg.g_timebase.den = clip.framerate;
+	cfg.g_threads = std::min<uint32_t>(std::max<uint32_t>(std::thread::hardware_concurrency(), 1), CORPUS_MAX_THREADS);
+	// 프레임마다 패킷 하나가 바로 나오게 해서 색상과 알파 패킷을 같은 블록으로 묶는다. 돌고 있는 인코더의 크기를 바꿀 때도 필요하다
+	cfg.g_lag_in_frames = 0;
+	cfg.g_pass = VPX_RC_ONE_PASS;
+	cfg.rc_end_usage = VPX_VBR;
+	cfg.rc_target_bitrate = bitrateKbps;
+	cfg.rc_dropframe_thresh = 0;
+	// 키 프레임은 색상과 알파가 같은 위치에 오도록 직접 넣는다
+	cfg.kf_mode = VPX_KF_DISABLED;
+
+	if (vpx_codec_enc_init(codec, iface, &cfg, 0))
+		return false;
+
+	vpx_codec_control(codec, VP8E_SET_CPUUSED, CORPUS_CPU_USED);
+	return true;
+}
+
+static bool encode_frame(vpx_codec_ctx_t *codec, vpx_image_t *img, int64_t pts, vpx_enc_frame_flags_t flags,
+	std::vector<encoded_packet> &packets)
+{
+	if (vpx_codec_encode(codec, img, pts, 1, flags, VPX_DL_REALTIME))
+	{
+		std::cout << "encode failed: " << vpx_codec_error(codec) << std::endl;
+		return false;
+	}
+
+	vpx_codec_iter_t iter = nullptr;
+	const vpx_codec_cx_pkt_t *pkt = nullptr;
+	while ((pkt = vpx_codec_get_cx_data(codec, &iter)) != nullptr)
+	{
+		if (pkt->kind != VPX_CODEC_CX_FRAME_PKT)
+			continue;
+
+		const uint8_t *data = static_cast<const uint8_t*>(pkt->data.frame.buf);
+		encoded_packet packet;
+		packet.data.assign(data, data + pkt->data.frame.sz);
+		packet.pts = pkt->data.frame.pts;
+		packet.is_key = (pkt->data.frame.flags & VPX_FRAME_IS_KEY) != 0;
+		packets.push_back(std::move(packet));
+	}
+	return true;
+}
+
+static bool write_packets(mkvmuxer::Segment &segment, uint64_t track, const CorpusClip &clip,
+	std::vector<encoded_packet> &packets, std::vector<encoded_packet> &packetsAlpha)
+{
+	size_t count = packets.size();
+	if (clip.has_alpha)
+		count = std::min(count, packetsAlpha.size());
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const encoded_packet &packet = packets[i];
+		const uint64_t timestamp = static_cast<uint64_t>(packet.pts) * 1000000000ull / clip.framerate;
+		bool ok = false;
+		if (clip.has_alpha)
+		{
+			const encoded_packet &packetAlpha = packetsAlpha[i];
+			ok = segment.AddFrameWithAdditional(&packet.data[0], packet.data.size(),
+				&packetAlpha.data[0], packetAlpha.data.size(), ALPHA_BLOCK_ADDITIONAL_ID,
+				track, timestamp, packet.is_key);
+		}
+		else
+		{
+			ok = segment.AddFrame(&packet.data[0], packet.data.size(), track, timestamp, packet.is_key);
+		}
+
+		if (!ok)
+			return false;
+	}
+
+	packets.erase(packets.begin(), packets.begin() + count);
+	if (clip.has_alpha)
+		packetsAlpha.erase(packetsAlpha.begin(), packetsAlpha.begin() + count);
+	return true;
+}
+
+// 색상, 알파 인코더와 지금 해상도의 입력 이미지
+struct corpus_encoders
+{
+	vpx_codec_ctx_t codec;
+	vpx_codec_ctx_t codec_alpha;
+	vpx_codec_enc_cfg_t cfg;
+	vpx_codec_enc_cfg_t cfg_alpha;
+	vpx_image_t img;
+	vpx_image_t img_alpha;
+	bool has_img;
+	bool has_img_alpha;
+	uint32_t width;
+	uint32_t height;
+};
+
+static void free_images(corpus_encoders &encoders)
+{
+	if (encoders.has_img)
+		vpx_img_free(&encoders.img);
+	if (encoders.has_img_alpha)
+		vpx_img_free(&encoders.img_alpha);
+
+	encoders.has_img = false;
+	encoders.has_img_alpha = false;
+	encoders.width = 0;
+	encoders.height = 0;
+}
+
+static bool alloc_images(corpus_encoders &encoders, const CorpusClip &clip, uint32_t width, uint32_t height)
+{
+	free_images(encoders);
+	encoders.width = width;
+	encoders.height = height;
+	encoders.has_img = vpx_img_alloc(&encoders.img, VPX_IMG_FMT_I420, width, height, 32) != nullptr;
+	if (!encoders.has_img || !clip.has_alpha)
+		return encoders.has_img;
+
+	encoders.has_img_alpha = vpx_img_alloc(&encoders.img_alpha, VPX_IMG_FMT_I420, width, height, 32) != nullptr;
+	if (encoders.has_img_alpha)
+		fill_neutral_chroma(&encoders.img_alpha);
+	return encoders.has_img_alpha;
+}
+
+static void close_encoders(corpus_encoders &encoders)
+{
+	if (encoders.codec.iface)
+		vpx_codec_destroy(&encoders.codec);
+	if (encoders.codec_alpha.iface)
+		vpx_codec_destroy(&encoders.codec_alpha);
+
+	encoders.codec.iface = nullptr;
+	encoders.codec_alpha.iface = nullptr;
+	free_images(encoders);
+}
+
+static bool open_encoders(corpus_encoders &encoders, const CorpusClip &clip)
+{
+	// 알파 채널은 같은 코덱의 휘도 평면으로 인코딩한다. 색상보다 단순하므로 비트레이트는 절반만 준다
+	return alloc_images(encoders, clip, clip.width, clip.height) &&
+		init_encoder(&encoders.codec, encoders.cfg, clip, clip.bitrate_kbps) &&
+		(!clip.has_alpha || init_encoder(&encoders.codec_alpha, encoders.cfg_alpha, clip, clip.bitrate_kbps / 2));
+}
+
+// 인코더를 다시 만들지 않고 크기만 바꾼다. VP9는 다음 프레임을 크기가 다른 참조 프레임에서 예측하고, VP8은 스스로 키 프레임을 넣는다
+static bool resize_encoders(corpus_encoders &encoders, const CorpusClip &clip, uint32_t width, uint32_t height)
+{
+	if (!alloc_images(encoders, clip, width, height))
+		return false;
+
+	encoders.cfg.g_w = width;
+	encoders.cfg.g_h = height;
+	encoders.cfg_alpha.g_w = width;
+	encoders.cfg_alpha.g_h = height;
+	for (vpx_codec_ctx_t *codec : { &encoders.codec, &encoders.codec_alpha })
+	{
+		if (!codec->iface)
+			continue;
+		if (vpx_codec_enc_config_set(codec, (codec == &encoders.codec) ? &encoders.cfg : &encoders.cfg_alpha))
+		{
+			std::cout << "resize failed: " << vpx_codec_error(codec) << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// 인코더에 남은 패킷을 비운다
+static bool flush_encoders(corpus_encoders &encoders, mkvmuxer::Segment &segment, uint64_t track, const CorpusClip &clip,
+	std::vector<encoded_packet> &packets, std::vector<encoded_packet> &packetsAlpha)
+{
+	return encode_frame(&encoders.codec, nullptr, -1, 0, packets) &&
+		(!clip.has_alpha || encode_frame(&encoders.codec_alpha, nullptr, -1, 0, packetsAlpha)) &&
+		write_packets(segment, track, clip, packets, packetsAlpha);
+}
+
+bool GenerateCorpusClip(const CorpusClip &clip, const std::string &fileName)
+{
+	corpus_encoders encoders;
+	encoders.codec.iface = nullptr;
+	encoders.codec_alpha.iface = nullptr;
+	encoders.has_img = false;
+	encoders.has_img_alpha = false;
+	bool ok = open_encoders(encoders, clip);
+
+	WebmFileWriter writer;
+	mkvmuxer::Segment segment;
+	uint64_t track = 0;
+	if (ok)
+		ok = writer.Open(fileName) && segment.Init(&writer);
+
+	if (ok)
+	{
+		segment.set_mode(mkvmuxer::Segment::kFile);
+		segment.OutputCues(true);
+		segment.GetSegmentInfo()->set_writing_app("WebmBench");
+
+		// 해상도가 바뀌는 클립도 트랙 크기는 처음 해상도로 둔다. 디코더는 비트스트림의 크기를 따른다
+		track = segment.AddVideoTrack(clip.width, clip.height, 0);
+		mkvmuxer::VideoTrack *video = static_cast<mkvmuxer::VideoTrack*>(segment.GetTrackByNumber(track));
+		ok = video != nullptr;
+		if (ok)
+		{
+			video->set_codec_id((clip.fourcc == VP9_FOURCC) ? mkvmuxer::Tracks::kVp9CodecId : mkvmuxer::Tracks::kVp8CodecId);
+			video->set_frame_rate(clip.framerate);
+			video->set_default_duration(1000000000ull / clip.framerate);
+			if (clip.has_alpha)
+			{
+				video->SetAlphaMode(mkvmuxer::VideoTrack::kAlpha);
+				video->set_max_block_additional_id(ALPHA_BLOCK_ADDITIONAL_ID);
+			}
+			ok = segment.CuesTrack(track);
+		}
+	}
+
+	std::vector<encoded_packet> packets;
+	std::vector<encoded_packet> packetsAlpha;
+	for (uint32_t i = 0; ok && i < clip.frame_count; ++i)
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		GetCorpusFrameSize(clip, i, width, height);
+		if (width != encoders.width || height != encoders.height)
+		{
+			ok = resize_encoders(encoders, clip, width, height);
+			if (!ok)
+				break;
+		}
+
+		fill_frame(&encoders.img, (clip.has_alpha) ? &encoders.img_alpha : nullptr, i);
+
+		const vpx_enc_frame_flags_t flags = (i % CORPUS_KEY_FRAME_INTERVAL == 0) ? VPX_EFLAG_FORCE_KF : 0;
+		ok = encode_frame(&encoders.codec, &encoders.img, i, flags, packets) &&
+			(!clip.has_alpha || encode_frame(&encoders.codec_alpha, &encoders.img_alpha, i, flags, packetsAlpha)) &&
+			write_packets(segment, track, clip, packets, packetsAlpha);
+	}
+
+	if (ok)
+		ok = flush_encoders(encoders, segment, track, clip, packets, packetsAlpha);
+	if (ok)
+		ok = segment.Finalize();
+	writer.Close();
+	close_encoders(encoders);
+
+	if (!ok)
+		remove(fileName.c_str());
+	return ok;
+}
+
+static bool file_exists(const std::string &fileName)
+{
+	FILE *file = nullptr;
+	if (fopen_s(&file, fileName.c_str(), "rb"))
+		return false;
+	fclose(file);
+	return true;
+}
+
+bool GenerateCorpus(const std::string &directory, const std::vector<CorpusClip> &clips, bool force)
+{
+	if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		std::cout << "failed to create " << directory << std::endl;
+		return false;
+	}
+
+	for (const CorpusClip &clip : clips)
+	{
+		const std::string fileName = GetCorpusPath(directory, clip);
+		if (!force && file_exists(fileName))
+			continue;
+
+		const auto begin = std::chrono::steady_clock::now();
+		if (!GenerateCorpusClip(clip, fileName))
+		{
+			std::cout << "failed to generate " << fileName << std::endl;
+			return false;
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+		std::cout << "generated " << fileName << " (" << elapsed.count() << " ms)" << std::endl;
+	}
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 벤치마크용 합성 클립. 같은 설정이면 항상 같은 영상을 인코딩하므로 성능 변경 전후를 같은 입력으로 비교할 수 있다
+struct CorpusClip
+{
+	std::string name;	// 예: vp9_1080p_alpha_5000k
+	std::string resolution;	// 예: 1080p
+	uint32_t fourcc;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bitrate_kbps;
+	uint32_t frame_count;
+	uint32_t framerate;
+	bool has_alpha;
+	// 0이 아니면 키 프레임 사이에서 width x height와 이 해상도를 오간다. 돌고 있는 인코더의 크기만 바꾸므로
+	// VP9는 키 프레임 없이 크기가 다른 참조 프레임을 늘리거나 줄여서 예측한다. width x height 이하, 그 절반 이상이어야 한다
+	uint32_t resize_width;
+	uint32_t resize_height;
+};
+
+// VP8/VP9 x 해상도 x 알파 유무 x 비트레이트 조합과, 코덱 x 알파 유무마다 중간에 해상도가 작아졌다 커지는 클립. filter가 비어 있지 않으면 이름에 filter가 들어간 클립만 돌려준다
+std::vector<CorpusClip> GetCorpusClips(const std::string &filter);
+// 해상도를 바꾸는 클립에서 frame 번째 프레임의 크기
+void GetCorpusFrameSize(const CorpusClip &clip, uint32_t frame, uint32_t &width, uint32_t &height);
+std::string GetCorpusPath(const std::string &directory, const CorpusClip &clip);
+// 움직이는 패턴을 libvpx로 인코딩해서 mkvmuxer로 쓴다. 알파는 별도 인코더로 만들어 BlockAdditional에 넣는다
+bool GenerateCorpusClip(const CorpusClip &clip, const std::string &fileName);
+// directory에 없는 클립만 만든다. force면 있는 클립도 다시 만든다
+bool GenerateCorpus(const std::string &directory, const std::vector<CorpusClip> &clips, bool force);
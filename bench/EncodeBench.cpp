@@ -0,0 +1,127 @@
+#include "EncodeBench.h"
+#include "../WebmDecoder.h"
+#include "../WebmEncoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#define ENCODE_FRAME_COUNT 60
+#define ENCODE_FRAMERATE 30
+#define ENCODE_FILE_NAME "encode_bench.webm"
+
+struct encode_resolution
+{
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bitrate_kbps;
+};
+
+static const encode_resolution RESOLUTIONS[] = {
+	{ "360p", 640, 360, 800 },
+	{ "720p", 1280, 720, 2500 },
+	{ "1080p", 1920, 1080, 5000 },
+};
+
+struct encode_codec
+{
+	const char *name;
+	uint32_t fourcc;
+};
+
+static const encode_codec CODECS[] = {
+	{ "vp8", VP8_FOURCC },
+	{ "vp9", VP9_FOURCC },
+};
+
+// 코퍼스와 같은 XOR 무늬와 가로로 움직이는 알파 경사
+static void fill_frame(std::vector<uint8_t> &rgba, uint32_t width, uint32_t height, uint32_t frame)
+{
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t *row = &rgba[static_cast<size_t>(y) * width * 4];
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint32_t position = (x + frame * 8) % width;
+			row[x * 4 + 0] = static_cast<uint8_t>((x + frame * 3) ^ (y + frame));
+			row[x * 4 + 1] = static_cast<uint8_t>(64 + ((x + frame) & 127));
+			row[x * 4 + 2] = static_cast<uint8_t>(64 + ((y + frame * 2) & 127));
+			row[x * 4 + 3] = static_cast<uint8_t>(std::min<uint32_t>(position * 512 / width, 255));
+		}
+	}
+}
+
+std::vector<std::string> GetEncodeBenchColumns()
+{
+	return { "codec", "resolution", "width", "height", "alpha", "threads", "frames",
+		"fps", "convert_ms", "encode_ms", "encode_alpha_ms", "kbytes", "alpha_kbytes" };
+}
+
+bool RunEncodeBench(const KernelBenchOptions &options, BenchTable &table)
+{
+	bool ran = false;
+	for (const encode_codec &codec : CODECS)
+	{
+		if (!options.kernel_filter.empty() && options.kernel_filter != codec.name)
+			continue;
+
+		for (const encode_resolution &resolution : RESOLUTIONS)
+		{
+			if (!options.resolution_filter.empty() && options.resolution_filter != resolution.name)
+				continue;
+
+			std::vector<uint8_t> rgba(static_cast<size_t>(resolution.width) * resolution.height * 4);
+			for (int alpha = 0; alpha < 2; ++alpha)
+			{
+				// 1이면 libvpx 멀티스레딩 없이 색상과 알파 인코더를 나눠 돌린 효과만 남는다
+				for (uint32_t threads : { 1u, 0u })
+				{
+					WebmEncoder encoder;
+					encoder.SetCodec(codec.fourcc);
+					encoder.SetBitrate(resolution.bitrate_kbps, 0);
+					encoder.SetFrameRate(ENCODE_FRAMERATE, 1);
+					encoder.SetKeyFrameInterval(ENCODE_FRAMERATE);
+					encoder.SetThreads(threads);
+					if (!encoder.Open(ENCODE_FILE_NAME, resolution.width, resolution.height, alpha != 0))
+						return false;
+
+					uint64_t ns = 0;
+					bool ok = true;
+					for (uint32_t i = 0; ok && i < ENCODE_FRAME_COUNT; ++i)
+					{
+						fill_frame(rgba, resolution.width, resolution.height, i);
+						const auto begin = std::chrono::steady_clock::now();
+						ok = encoder.AddFrame(&rgba[0], resolution.width * 4);
+						ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+					}
+					const auto begin = std::chrono::steady_clock::now();
+					ok = encoder.Close() && ok;
+					ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+					remove(ENCODE_FILE_NAME);
+					if (!ok)
+						return false;
+
+					const WebmEncoder::EncodeStats &stats = encoder.GetStats();
+					const double frames = static_cast<double>(std::max<uint64_t>(stats.frames, 1));
+					table.AddRow();
+					table.Add(codec.name);
+					table.Add(resolution.name);
+					table.Add(static_cast<uint64_t>(resolution.width));
+					table.Add(static_cast<uint64_t>(resolution.height));
+					table.Add(static_cast<uint64_t>(alpha));
+					table.Add((threads) ? std::to_string(threads) : std::string("auto"));
+					table.Add(stats.frames);
+					table.Add(stats.frames / (std::max<uint64_t>(ns, 1) / 1000000000.0), 1);
+					table.Add(stats.convert_ns / frames / 1000000.0);
+					table.Add(stats.encode_ns / frames / 1000000.0);
+					table.Add(stats.encode_alpha_ns / frames / 1000000.0);
+					table.Add(stats.bytes / 1024);
+					table.Add(stats.alpha_bytes / 1024);
+					ran = true;
+				}
+			}
+		}
+	}
+	return ran;
+}
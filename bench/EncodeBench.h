@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchTable.h"
+#include "KernelBench.h"
+
+// 움직이는 RGBA 패턴을 WebmEncoder로 인코딩하는 속도를 코덱 x 해상도 x 알파 유무 x libvpx 스레드(1개, 자동)마다 잰다.
+// fps는 AddFrame과 Close에 걸린 시간만 센다. options의 kernel_filter는 vp8/vp9로 쓴다
+bool RunEncodeBench(const KernelBenchOptions &options, BenchTable &table);
+std::vector<std::string> GetEncodeBenchColumns();
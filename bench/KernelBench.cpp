@@ -0,0 +1,241 @@
+#include "KernelBench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <intrin.h>
+#include <iostream>
+#include <malloc.h>
+
+#define IMAGE_ALIGNMENT 32
+// 마지막 단계 캐시보다 충분히 크게 잡는다
+#define CACHE_FLUSH_SIZE (64 * 1024 * 1024)
+
+struct bench_resolution
+{
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+};
+
+static const bench_resolution RESOLUTIONS[] = {
+	{ "240p", 426, 240 },
+	{ "360p", 640, 360 },
+	{ "480p", 854, 480 },
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "1440p", 2560, 1440 },
+	{ "4K", 3840, 2160 },
+	{ "8K", 7680, 4320 },
+};
+
+static const char *YCBCR_NAMES[] = { "jpeg", "601", "709" };
+
+static bool has_sse2()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	return ((cpuInfo[3] >> 26) & 1) != 0;
+}
+
+static bool has_avx2()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 7);
+	return (cpuInfo[1] & (1 << 5)) != 0;
+}
+
+static bool always_supported()
+{
+	return true;
+}
+
+const std::vector<Kernel> &GetKernels()
+{
+	static const std::vector<Kernel> kernels = {
+		{ "std", yuv420_rgb24_std, alpha_plane_constant_std, plane_diff_blocks_std, rgba_yuv420_std, always_supported },
+		{ "sse", yuv420_rgb24_sse, alpha_plane_constant_sse, plane_diff_blocks_sse, rgba_yuv420_sse, has_sse2 },
+		{ "avx", yuv420_rgb24_avx, alpha_plane_constant_avx, plane_diff_blocks_avx, rgba_yuv420_avx, has_avx2 },
+	};
+	return kernels;
+}
+
+static uint8_t *alloc_plane(size_t size)
+{
+	return static_cast<uint8_t*>(_aligned_malloc(std::max<size_t>(size, 1), IMAGE_ALIGNMENT));
+}
+
+static void fill_plane(uint8_t *plane, size_t size, uint32_t &state)
+{
+	// xorshift32. 값이 데이터에 따라 분기하지 않는 커널이지만 실제 영상처럼 고르게 채운다
+	for (size_t i = 0; i < size; ++i)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		plane[i] = static_cast<uint8_t>(state);
+	}
+}
+
+KernelImage::KernelImage(uint32_t w, uint32_t h, bool alpha, uint32_t seed) :
+	width(w), height(h), a(nullptr)
+{
+	// libvpx처럼 줄 간격을 32바이트 단위로 맞춘다
+	y_stride = (width + 31) & ~31u;
+	uv_stride = (((width + 1) / 2) + 31) & ~31u;
+	rgba_stride = width * 4;
+
+	const size_t uvHeight = (height + 1) / 2;
+	uint32_t state = (seed) ? seed : 1;
+	y = alloc_plane(static_cast<size_t>(y_stride) * height);
+	u = alloc_plane(uv_stride * uvHeight);
+	v = alloc_plane(uv_stride * uvHeight);
+	fill_plane(y, static_cast<size_t>(y_stride) * height, state);
+	fill_plane(u, uv_stride * uvHeight, state);
+	fill_plane(v, uv_stride * uvHeight, state);
+	if (alpha)
+	{
+		a = alloc_plane(static_cast<size_t>(y_stride) * height);
+		fill_plane(a, static_cast<size_t>(y_stride) * height, state);
+	}
+	rgba = alloc_plane(static_cast<size_t>(rgba_stride) * height);
+	memset(rgba, 0, static_cast<size_t>(rgba_stride) * height);
+}
+
+KernelImage::~KernelImage()
+{
+	_aligned_free(y);
+	_aligned_free(u);
+	_aligned_free(v);
+	if (a)
+		_aligned_free(a);
+	_aligned_free(rgba);
+}
+
+void KernelImage::Run(const Kernel &kernel, YCbCrType type)
+{
+	kernel.func(width, height, y, u, v, a, y_stride, uv_stride, uv_stride, (a) ? y_stride : 0, rgba, rgba_stride, type, nullptr);
+}
+
+uint64_t KernelImage::GetBytes() const
+{
+	const uint64_t pixels = static_cast<uint64_t>(width) * height;
+	const uint64_t chroma = static_cast<uint64_t>((width + 1) / 2) * ((height + 1) / 2) * 2;
+	return pixels + chroma + ((a) ? pixels : 0) + pixels * 4;
+}
+
+static void flush_cache(std::vector<uint8_t> &scratch)
+{
+	// 입력과 출력을 캐시에서 밀어내도록 큰 버퍼를 한 번 쓰고 읽는다
+	volatile uint8_t sink = 0;
+	for (size_t i = 0; i < scratch.size(); i += 64)
+	{
+		scratch[i]++;
+		sink += scratch[i];
+	}
+}
+
+struct bench_sample
+{
+	uint64_t cycles;
+	uint64_t ns;
+};
+
+static bench_sample measure(KernelImage &image, const Kernel &kernel, YCbCrType type, bool cold,
+	const KernelBenchOptions &options, std::vector<uint8_t> &scratch, uint32_t &runs)
+{
+	if (!cold)
+		image.Run(kernel, type);
+
+	std::vector<bench_sample> samples;
+	double total_ms = 0.0;
+	while (samples.size() < options.max_runs && (samples.size() < options.min_runs || total_ms < options.min_time_ms))
+	{
+		if (cold)
+			flush_cache(scratch);
+
+		const auto begin = std::chrono::steady_clock::now();
+		const uint64_t beginCycles = __rdtsc();
+		image.Run(kernel, type);
+		const uint64_t cycles = __rdtsc() - beginCycles;
+		const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+		samples.push_back({ cycles, ns });
+		total_ms += ns / 1000000.0;
+	}
+
+	// 중앙값을 쓴다. 인터럽트나 주파수 변화로 튄 값에 덜 흔들린다
+	std::sort(samples.begin(), samples.end(), [](const bench_sample &lhs, const bench_sample &rhs) { return lhs.ns < rhs.ns; });
+	runs = static_cast<uint32_t>(samples.size());
+	return samples[samples.size() / 2];
+}
+
+std::vector<std::string> GetKernelBenchColumns()
+{
+	return { "kernel", "resolution", "width", "height", "alpha", "ycbcr", "cache", "runs",
+		"median_ns", "cycles", "pixels_per_cycle", "gb_per_s", "speedup_vs_std" };
+}
+
+bool RunKernelBench(const KernelBenchOptions &options, BenchTable &table)
+{
+	std::vector<uint8_t> scratch(CACHE_FLUSH_SIZE);
+	bool ran = false;
+
+	for (const bench_resolution &resolution : RESOLUTIONS)
+	{
+		if (!options.resolution_filter.empty() && options.resolution_filter != resolution.name)
+			continue;
+
+		for (int alpha = 0; alpha < 2; ++alpha)
+		{
+			KernelImage image(resolution.width, resolution.height, alpha != 0, resolution.width * 31 + resolution.height);
+			const uint64_t pixels = static_cast<uint64_t>(resolution.width) * resolution.height;
+
+			for (int type = YCBCR_JPEG; type <= YCBCR_709; ++type)
+			{
+				for (int cold = 0; cold < 2; ++cold)
+				{
+					uint64_t stdNs = 0;
+					for (const Kernel &kernel : GetKernels())
+					{
+						if (!options.kernel_filter.empty() && options.kernel_filter != kernel.name && strcmp(kernel.name, "std") != 0)
+							continue;
+						if (!kernel.is_supported())
+						{
+							std::cout << "skip " << kernel.name << ": not supported by this CPU" << std::endl;
+							continue;
+						}
+
+						uint32_t runs = 0;
+						const bench_sample sample = measure(image, kernel, static_cast<YCbCrType>(type), cold != 0, options, scratch, runs);
+						if (strcmp(kernel.name, "std") == 0)
+						{
+							stdNs = sample.ns;
+							// 기준으로만 돌린 std는 결과에 넣지 않는다
+							if (!options.kernel_filter.empty() && options.kernel_filter != "std")
+								continue;
+						}
+
+						const double seconds = sample.ns / 1000000000.0;
+						table.AddRow();
+						table.Add(kernel.name);
+						table.Add(resolution.name);
+						table.Add(static_cast<uint64_t>(resolution.width));
+						table.Add(static_cast<uint64_t>(resolution.height));
+						table.Add(static_cast<uint64_t>(alpha));
+						table.Add(YCBCR_NAMES[type]);
+						table.Add((cold) ? "cold" : "hot");
+						table.Add(static_cast<uint64_t>(runs));
+						table.Add(sample.ns);
+						table.Add(sample.cycles);
+						table.Add(static_cast<double>(pixels) / std::max<uint64_t>(sample.cycles, 1), 4);
+						table.Add(image.GetBytes() / std::max(seconds, 1e-9) / 1e9);
+						table.Add((stdNs > 0) ? static_cast<double>(stdNs) / std::max<uint64_t>(sample.ns, 1) : 0.0, 2);
+						ran = true;
+					}
+				}
+			}
+		}
+	}
+	return ran;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../YUVtoRGB.h"
+#include "BenchTable.h"
+
+// 벤치마크와 검증에서 같이 쓰는 YUV -> RGBA 커널 목록. 새 커널은 GetKernels에 추가한다
+struct Kernel
+{
+	using Func_t = void(*)(uint32_t, uint32_t,
+		const uint8_t*, const uint8_t*, const uint8_t*, const uint8_t*,
+		uint32_t, uint32_t, uint32_t, uint32_t,
+		uint8_t*, uint32_t, YCbCrType, AlphaCoverage*);
+	using AlphaConstantFunc_t = int(*)(uint32_t, uint32_t, const uint8_t*, uint32_t);
+	using PlaneDiffFunc_t = uint32_t(*)(uint32_t, uint32_t, uint32_t, const uint8_t*, uint32_t, uint8_t*, uint32_t, uint8_t*, uint32_t);
+	using RgbaYuvFunc_t = void(*)(uint32_t, uint32_t, const uint8_t*, uint32_t,
+		uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint32_t, uint32_t, uint32_t, uint32_t, YCbCrType);
+
+	const char *name;
+	Func_t func;
+	AlphaConstantFunc_t alpha_constant;	// 같은 명령어 집합으로 알파 평면이 한 값인지 확인한다
+	PlaneDiffFunc_t plane_diff;	// 같은 명령어 집합으로 두 평면을 블록 단위로 비교한다
+	RgbaYuvFunc_t rgba_yuv;	// 같은 명령어 집합으로 인코딩할 RGBA를 YUV420으로 되돌린다
+	bool (*is_supported)();
+};
+
+const std::vector<Kernel> &GetKernels();
+
+// 32바이트 정렬된 YUV(A) 입력과 RGBA 출력
+class KernelImage
+{
+public:
+	KernelImage(uint32_t width, uint32_t height, bool alpha, uint32_t seed);
+	~KernelImage();
+	KernelImage(const KernelImage&) = delete;
+	KernelImage &operator=(const KernelImage&) = delete;
+
+public:
+	void Run(const Kernel &kernel, YCbCrType type);
+	// 한 번 변환할 때 읽고 쓰는 바이트
+	uint64_t GetBytes() const;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t y_stride;
+	uint32_t uv_stride;
+	uint32_t rgba_stride;
+	uint8_t *y;
+	uint8_t *u;
+	uint8_t *v;
+	uint8_t *a;	// 알파가 없으면 nullptr
+	uint8_t *rgba;
+};
+
+struct KernelBenchOptions
+{
+	std::string kernel_filter;	// 비어 있으면 모든 커널
+	std::string resolution_filter;	// 예: "1080p"
+	double min_time_ms;
+	uint32_t min_runs;
+	uint32_t max_runs;
+};
+
+// 해상도(240p~8K) x 알파 유무 x YCbCrType x 캐시(hot/cold) 조합마다 커널을 돌린다
+bool RunKernelBench(const KernelBenchOptions &options, BenchTable &table);
+std::vector<std::string> GetKernelBenchColumns();
@@ -0,0 +1,462 @@
+#include "KernelVerify.h"
+#include "KernelBench.h"
+#include "PipelineBench.h"
+#include "../WebmDecoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <malloc.h>
+
+#define PLANE_ALIGNMENT 32
+// SIMD 커널은 한 번에 32바이트씩 읽으므로 마지막 줄 끝을 넘어 읽어도 되게 여유를 둔다
+#define PLANE_SLACK 64
+// 출력 버퍼 뒤에 붙이는 가드. 커널이 범위 밖에 쓰면 std와 달라진다
+#define GUARD_SIZE 64
+#define GUARD_VALUE 0xCD
+#define MAX_RANDOM_WIDTH 2048
+#define MAX_RANDOM_HEIGHT 64
+// 32픽셀 단위 루프와 나머지 처리의 경계를 자주 밟도록 일부 케이스는 좁은 폭을 쓴다
+#define NARROW_WIDTH 64
+
+static const char *YCBCR_NAMES[] = { "jpeg", "601", "709" };
+static const char *CHANNEL_NAMES = "RGBA";
+
+struct verify_result
+{
+	uint64_t cases;
+	uint64_t mismatches;
+	std::string first_mismatch;
+};
+
+// 한 케이스의 입력. 평면마다 줄 간격이 다를 수 있다
+struct verify_input
+{
+	uint32_t width;
+	uint32_t height;
+	const uint8_t *y;
+	const uint8_t *u;
+	const uint8_t *v;
+	const uint8_t *a;
+	uint32_t y_stride;
+	uint32_t u_stride;
+	uint32_t v_stride;
+	uint32_t a_stride;
+	uint32_t rgba_stride;
+};
+
+static uint32_t next_random(uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static uint32_t align_stride(uint32_t size)
+{
+	return (size + PLANE_ALIGNMENT - 1) & ~(PLANE_ALIGNMENT - 1);
+}
+
+static uint8_t *alloc_plane(size_t size)
+{
+	return static_cast<uint8_t*>(_aligned_malloc(size + PLANE_SLACK, PLANE_ALIGNMENT));
+}
+
+static void fill_plane(uint8_t *plane, size_t size, uint32_t low, uint32_t high, uint32_t &state)
+{
+	for (size_t i = 0; i < size + PLANE_SLACK; ++i)
+		plane[i] = static_cast<uint8_t>(low + next_random(state) % (high - low + 1));
+}
+
+// 알파 사각형과 타일 분류를 확인할 수 있도록 투명한 바탕에 불투명한 사각형을 놓고 가장자리만 무작위 값으로 채운다
+static void fill_alpha_shape(uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, uint32_t &state)
+{
+	const uint32_t left = next_random(state) % width;
+	const uint32_t top = next_random(state) % height;
+	const uint32_t right = left + 1 + next_random(state) % (width - left);
+	const uint32_t bottom = top + 1 + next_random(state) % (height - top);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t value = 0;
+			if (x >= left && x < right && y >= top && y < bottom)
+			{
+				const bool edge = x == left || x + 1 == right || y == top || y + 1 == bottom;
+				value = (edge) ? static_cast<uint8_t>(next_random(state)) : 255;
+			}
+			plane[y * stride + x] = value;
+		}
+	}
+}
+
+// 페이드 구간처럼 알파 평면을 0이나 255 한 값으로 채운다. 절반은 한 픽셀만 다르게 두고, 줄 끝 여백은 그대로 둔다
+static void fill_constant_alpha(uint8_t *plane, uint32_t stride, uint32_t width, uint32_t height, uint32_t &state)
+{
+	const uint8_t value = (next_random(state) & 1) ? 255 : 0;
+	for (uint32_t y = 0; y < height; ++y)
+		memset(plane + y * stride, value, width);
+
+	if (next_random(state) & 1)
+	{
+		const uint32_t x = next_random(state) % width;
+		const uint32_t y = next_random(state) % height;
+		plane[y * stride + x] ^= 1;
+	}
+}
+
+static void run_kernel(const Kernel &kernel, const verify_input &input, YCbCrType type, std::vector<uint8_t> &output,
+	AlphaCoverage &coverage)
+{
+	output.assign(static_cast<size_t>(input.rgba_stride) * input.height + GUARD_SIZE, GUARD_VALUE);
+	kernel.func(input.width, input.height, input.y, input.u, input.v, input.a,
+		input.y_stride, input.u_stride, input.v_stride, input.a_stride,
+		&output[0], input.rgba_stride, type, &coverage);
+}
+
+// 픽셀이 같아도 커널이 같이 구하는 알파 사각형과 타일 분류가 std와 다르면 틀린 것으로 본다
+static bool describe_coverage_mismatch(const AlphaCoverage &expected, const AlphaCoverage &actual, std::string &text)
+{
+	char buffer[160];
+	if (expected.left != actual.left || expected.top != actual.top || expected.right != actual.right || expected.bottom != actual.bottom)
+	{
+		snprintf(buffer, sizeof(buffer), "alpha bbox expected %u,%u-%u,%u got %u,%u-%u,%u",
+			expected.left, expected.top, expected.right, expected.bottom, actual.left, actual.top, actual.right, actual.bottom);
+		text = buffer;
+		return true;
+	}
+
+	const auto diff = std::mismatch(expected.tiles.begin(), expected.tiles.end(), actual.tiles.begin());
+	if (diff.first == expected.tiles.end())
+		return false;
+
+	const uint32_t index = static_cast<uint32_t>(diff.first - expected.tiles.begin());
+	snprintf(buffer, sizeof(buffer), "alpha tile %u,%u expected %u got %u",
+		index % expected.tiles_wide, index / expected.tiles_wide, *diff.first, *diff.second);
+	text = buffer;
+	return true;
+}
+
+static bool describe_constant_mismatch(int expected, const Kernel &kernel, const verify_input &input, std::string &text)
+{
+	const int actual = (input.a) ? kernel.alpha_constant(input.width, input.height, input.a, input.a_stride) : -1;
+	if (expected == actual)
+		return false;
+
+	text = "alpha constant expected " + std::to_string(expected) + " got " + std::to_string(actual);
+	return true;
+}
+
+// 평면 하나를 블록 단위로 prev와 비교한다. prev는 세 줄마다 한 바이트를 바꾼 복사본이다
+static void run_plane_diff(Kernel::PlaneDiffFunc_t func, uint32_t width, uint32_t height, uint32_t blockSize,
+	const uint8_t *plane, uint32_t stride, std::vector<uint8_t> &prev, std::vector<uint8_t> &dirty, uint32_t &changed)
+{
+	const uint32_t blocksWide = (width + blockSize - 1) / blockSize;
+	const uint32_t blocksHigh = (height + blockSize - 1) / blockSize;
+	prev.assign(plane, plane + static_cast<size_t>(stride) * height);
+	for (uint32_t y = 0; y < height; y += 3)
+		prev[y * stride + (y * 37 + 11) % width] ^= 0x80;
+	dirty.assign(static_cast<size_t>(blocksWide) * blocksHigh, 0);
+	changed = func(width, height, blockSize, plane, stride, &prev[0], stride, &dirty[0], blocksWide);
+}
+
+static bool describe_diff_mismatch(const Kernel &kernel, const verify_input &input, std::string &text)
+{
+	// 더티 영역과 같이 Y는 16x16, 색차는 8x8 블록으로 비교한다
+	const uint32_t uvWidth = (input.width + 1) / 2;
+	const uint32_t uvHeight = (input.height + 1) / 2;
+	const uint8_t *planes[] = { input.y, input.u };
+	const uint32_t widths[] = { input.width, uvWidth };
+	const uint32_t heights[] = { input.height, uvHeight };
+	const uint32_t strides[] = { input.y_stride, input.u_stride };
+	const uint32_t blockSizes[] = { 16, 8 };
+	for (int i = 0; i < 2; ++i)
+	{
+		std::vector<uint8_t> expectedPrev, actualPrev, expectedDirty, actualDirty;
+		uint32_t expectedChanged = 0, actualChanged = 0;
+		run_plane_diff(GetKernels().front().plane_diff, widths[i], heights[i], blockSizes[i], planes[i], strides[i],
+			expectedPrev, expectedDirty, expectedChanged);
+		run_plane_diff(kernel.plane_diff, widths[i], heights[i], blockSizes[i], planes[i], strides[i],
+			actualPrev, actualDirty, actualChanged);
+		if (expectedChanged == actualChanged && expectedDirty == actualDirty && expectedPrev == actualPrev)
+			continue;
+
+		char buffer[160];
+		snprintf(buffer, sizeof(buffer), "%s plane diff expected %u blocks got %u", (i == 0) ? "y" : "u", expectedChanged, actualChanged);
+		text = buffer;
+		return true;
+	}
+	return false;
+}
+
+// 변환 결과를 인코더 경로로 다시 YUV420으로 되돌린다. Y, U, V, A 평면을 한 버퍼에 이어 두고 뒤에 가드를 붙인다
+static void run_rgba_yuv(Kernel::RgbaYuvFunc_t func, const verify_input &input, const std::vector<uint8_t> &rgba, YCbCrType type,
+	std::vector<uint8_t> &output, size_t sizes[4])
+{
+	const uint32_t uvHeight = (input.height + 1) / 2;
+	sizes[0] = static_cast<size_t>(input.y_stride) * input.height;
+	sizes[1] = static_cast<size_t>(input.u_stride) * uvHeight;
+	sizes[2] = static_cast<size_t>(input.v_stride) * uvHeight;
+	sizes[3] = (input.a) ? static_cast<size_t>(input.a_stride) * input.height : 0;
+	output.assign(sizes[0] + sizes[1] + sizes[2] + sizes[3] + GUARD_SIZE, GUARD_VALUE);
+
+	uint8_t *y = &output[0];
+	uint8_t *u = y + sizes[0];
+	uint8_t *v = u + sizes[1];
+	uint8_t *a = (input.a) ? v + sizes[2] : nullptr;
+	func(input.width, input.height, &rgba[0], input.rgba_stride, y, u, v, a,
+		input.y_stride, input.u_stride, input.v_stride, input.a_stride, type);
+}
+
+static bool describe_rgba_yuv_mismatch(const Kernel &kernel, const verify_input &input, const std::vector<uint8_t> &rgba,
+	YCbCrType type, std::string &text)
+{
+	std::vector<uint8_t> expected;
+	std::vector<uint8_t> actual;
+	size_t sizes[4];
+	run_rgba_yuv(GetKernels().front().rgba_yuv, input, rgba, type, expected, sizes);
+	run_rgba_yuv(kernel.rgba_yuv, input, rgba, type, actual, sizes);
+	const auto diff = std::mismatch(expected.begin(), expected.end(), actual.begin());
+	if (diff.first == expected.end())
+		return false;
+
+	size_t offset = diff.first - expected.begin();
+	const uint32_t strides[] = { input.y_stride, input.u_stride, input.v_stride, input.a_stride };
+	char buffer[160];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (offset >= sizes[i])
+		{
+			offset -= sizes[i];
+			continue;
+		}
+		snprintf(buffer, sizeof(buffer), "rgba->yuv %c x=%u y=%u expected %u got %u", "YUVA"[i],
+			static_cast<uint32_t>(offset % strides[i]), static_cast<uint32_t>(offset / strides[i]), *diff.first, *diff.second);
+		text = buffer;
+		return true;
+	}
+
+	snprintf(buffer, sizeof(buffer), "rgba->yuv guard +%u expected %u got %u", static_cast<uint32_t>(offset), *diff.first, *diff.second);
+	text = buffer;
+	return true;
+}
+
+static std::string describe_mismatch(const verify_input &input, const std::vector<uint8_t> &expected,
+	const std::vector<uint8_t> &actual, size_t offset)
+{
+	char text[160];
+	const size_t rgbaSize = static_cast<size_t>(input.rgba_stride) * input.height;
+	if (offset >= rgbaSize)
+	{
+		snprintf(text, sizeof(text), "guard +%u expected %u got %u",
+			static_cast<uint32_t>(offset - rgbaSize), expected[offset], actual[offset]);
+		return text;
+	}
+
+	const uint32_t y = static_cast<uint32_t>(offset / input.rgba_stride);
+	const uint32_t x = static_cast<uint32_t>(offset % input.rgba_stride) / 4;
+	if (x >= input.width)
+	{
+		snprintf(text, sizeof(text), "row %u padding byte %u expected %u got %u",
+			y, static_cast<uint32_t>(offset % input.rgba_stride) - input.width * 4, expected[offset], actual[offset]);
+		return text;
+	}
+
+	snprintf(text, sizeof(text), "x=%u y=%u %c expected %u got %u",
+		x, y, CHANNEL_NAMES[offset % 4], expected[offset], actual[offset]);
+	return text;
+}
+
+static void verify_case(const std::vector<const Kernel*> &kernels, const verify_input &input, YCbCrType type,
+	const std::string &label, std::vector<verify_result> &results)
+{
+	std::vector<uint8_t> expected;
+	std::vector<uint8_t> actual;
+	AlphaCoverage expectedCoverage;
+	AlphaCoverage actualCoverage;
+	const Kernel &reference = GetKernels().front();
+	run_kernel(reference, input, type, expected, expectedCoverage);
+	const int expectedConstant = (input.a) ? reference.alpha_constant(input.width, input.height, input.a, input.a_stride) : -1;
+
+	for (size_t i = 0; i < kernels.size(); ++i)
+	{
+		verify_result &result = results[i];
+		result.cases++;
+		run_kernel(*kernels[i], input, type, actual, actualCoverage);
+
+		std::string text;
+		const auto diff = std::mismatch(expected.begin(), expected.end(), actual.begin());
+		if (diff.first != expected.end())
+			text = describe_mismatch(input, expected, actual, diff.first - expected.begin());
+		else if (!describe_coverage_mismatch(expectedCoverage, actualCoverage, text) &&
+			!describe_constant_mismatch(expectedConstant, *kernels[i], input, text) &&
+			!describe_diff_mismatch(*kernels[i], input, text) &&
+			!describe_rgba_yuv_mismatch(*kernels[i], input, expected, type, text))
+			continue;
+
+		if (result.mismatches++ == 0)
+		{
+			char prefix[160];
+			snprintf(prefix, sizeof(prefix), "%s %ux%u %s%s strides %u/%u/%u/%u: ",
+				label.c_str(), input.width, input.height, YCBCR_NAMES[type], (input.a) ? " alpha" : "",
+				input.y_stride, input.u_stride, input.a_stride, input.rgba_stride);
+			result.first_mismatch = prefix + text;
+		}
+	}
+}
+
+static void verify_random(const KernelVerifyOptions &options, const std::vector<const Kernel*> &kernels,
+	std::vector<verify_result> &results)
+{
+	uint32_t state = (options.seed) ? options.seed : 1;
+	for (uint32_t i = 0; i < options.cases; ++i)
+	{
+		const YCbCrType type = static_cast<YCbCrType>(i % 3);
+		const bool alpha = (next_random(state) & 1) != 0;
+		const uint32_t width = 1 + next_random(state) % ((i % 4 == 0) ? NARROW_WIDTH : MAX_RANDOM_WIDTH);
+		const uint32_t height = 1 + next_random(state) % MAX_RANDOM_HEIGHT;
+		const uint32_t uvWidth = (width + 1) / 2;
+		const uint32_t uvHeight = (height + 1) / 2;
+
+		verify_input input;
+		input.width = width;
+		input.height = height;
+		// libvpx처럼 줄 간격은 32바이트 단위지만 평면마다 여백을 다르게 준다
+		input.y_stride = align_stride(width) + PLANE_ALIGNMENT * (next_random(state) % 3);
+		input.u_stride = align_stride(uvWidth) + PLANE_ALIGNMENT * (next_random(state) % 3);
+		input.v_stride = input.u_stride;
+		input.a_stride = (alpha) ? align_stride(width) + PLANE_ALIGNMENT * (next_random(state) % 3) : 0;
+		input.rgba_stride = width * 4 + 4 * (next_random(state) % 4);
+
+		// 601/709는 공칭 범위(Y 16~235, CbCr 16~240) 안에서만 std와 같게 나오도록 만들어져 있다
+		const bool nominal = type != YCBCR_JPEG && !options.strict;
+		const size_t ySize = static_cast<size_t>(input.y_stride) * height;
+		const size_t uvSize = static_cast<size_t>(input.u_stride) * uvHeight;
+		const size_t aSize = static_cast<size_t>(input.a_stride) * height;
+		uint8_t *y = alloc_plane(ySize);
+		uint8_t *u = alloc_plane(uvSize);
+		uint8_t *v = alloc_plane(uvSize);
+		uint8_t *a = (alpha) ? alloc_plane(aSize) : nullptr;
+		fill_plane(y, ySize, (nominal) ? 16 : 0, (nominal) ? 235 : 255, state);
+		fill_plane(u, uvSize, (nominal) ? 16 : 0, (nominal) ? 240 : 255, state);
+		fill_plane(v, uvSize, (nominal) ? 16 : 0, (nominal) ? 240 : 255, state);
+		if (a)
+		{
+			fill_plane(a, aSize, 0, 255, state);
+			const uint32_t shape = next_random(state) % 4;
+			if (shape == 1 || shape == 2)
+				fill_alpha_shape(a, input.a_stride, width, height, state);
+			else if (shape == 3)
+				fill_constant_alpha(a, input.a_stride, width, height, state);
+		}
+
+		input.y = y;
+		input.u = u;
+		input.v = v;
+		input.a = a;
+		verify_case(kernels, input, type, "case " + std::to_string(i), results);
+
+		_aligned_free(y);
+		_aligned_free(u);
+		_aligned_free(v);
+		if (a)
+			_aligned_free(a);
+	}
+}
+
+static bool verify_replay(const KernelVerifyOptions &options, const std::vector<const Kernel*> &kernels,
+	std::vector<verify_result> &results)
+{
+	WebmDecoder::MediaInfo info;
+	if (!WebmDecoder::Probe(options.replay_file, info))
+	{
+		std::cout << "failed to open " << options.replay_file << std::endl;
+		return false;
+	}
+
+	// 디코더는 항상 JPEG 계수로 변환한다. 실제 영상은 공칭 범위를 벗어나기도 하므로 601/709는 strict에서만 본다
+	const int lastType = (options.strict) ? YCBCR_709 : YCBCR_JPEG;
+	uint64_t frames = 0;
+	const bool decoded = DecodeClip(options.replay_file, info.fourcc, frames, [&](const vpx_image_t *img, const vpx_image_t *imgAlpha) {
+		verify_input input;
+		input.width = img->d_w;
+		input.height = img->d_h;
+		input.y = img->planes[VPX_PLANE_Y];
+		input.u = img->planes[VPX_PLANE_U];
+		input.v = img->planes[VPX_PLANE_V];
+		input.a = (imgAlpha) ? imgAlpha->planes[VPX_PLANE_Y] : nullptr;
+		input.y_stride = img->stride[VPX_PLANE_Y];
+		input.u_stride = img->stride[VPX_PLANE_U];
+		input.v_stride = img->stride[VPX_PLANE_V];
+		input.a_stride = (imgAlpha) ? imgAlpha->stride[VPX_PLANE_Y] : 0;
+		input.rgba_stride = img->d_w * 4;
+
+		for (int type = YCBCR_JPEG; type <= lastType; ++type)
+			verify_case(kernels, input, static_cast<YCbCrType>(type), "frame " + std::to_string(frames - 1), results);
+	});
+
+	if (!decoded)
+	{
+		std::cout << "failed to decode " << options.replay_file << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::vector<std::string> GetKernelVerifyColumns()
+{
+	return { "kernel", "source", "cases", "mismatches", "first_mismatch" };
+}
+
+static void add_verify_rows(BenchTable &table, const std::vector<const Kernel*> &kernels, const char *source,
+	const std::vector<verify_result> &results, bool &passed)
+{
+	for (size_t i = 0; i < kernels.size(); ++i)
+	{
+		table.AddRow();
+		table.Add(kernels[i]->name);
+		table.Add(source);
+		table.Add(results[i].cases);
+		table.Add(results[i].mismatches);
+		table.Add((results[i].mismatches) ? results[i].first_mismatch : "-");
+		passed = passed && results[i].mismatches == 0;
+	}
+}
+
+bool RunKernelVerify(const KernelVerifyOptions &options, BenchTable &table)
+{
+	std::vector<const Kernel*> kernels;
+	for (const Kernel &kernel : GetKernels())
+	{
+		if (strcmp(kernel.name, "std") == 0)
+			continue;
+		if (!options.kernel_filter.empty() && options.kernel_filter != kernel.name)
+			continue;
+		if (!kernel.is_supported())
+		{
+			std::cout << "skip " << kernel.name << ": not supported by this CPU" << std::endl;
+			continue;
+		}
+		kernels.push_back(&kernel);
+	}
+	if (kernels.empty())
+	{
+		std::cout << "no kernel matched the filter" << std::endl;
+		return false;
+	}
+
+	bool passed = true;
+	std::vector<verify_result> results(kernels.size(), { 0, 0, std::string() });
+	verify_random(options, kernels, results);
+	add_verify_rows(table, kernels, "random", results, passed);
+
+	if (!options.replay_file.empty())
+	{
+		std::vector<verify_result> replayResults(kernels.size(), { 0, 0, std::string() });
+		passed = verify_replay(options, kernels, replayResults) && passed;
+		add_verify_rows(table, kernels, "replay", replayResults, passed);
+	}
+	return passed;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BenchTable.h"
+
+struct KernelVerifyOptions
+{
+	std::string kernel_filter;	// 비어 있으면 std를 뺀 모든 커널
+	std::string replay_file;	// 비어 있지 않으면 이 파일의 실제 프레임도 비교한다
+	uint32_t cases;
+	uint32_t seed;
+	// 601/709도 공칭 범위 밖의 입력으로 비교한다. SIMD 커널은 16비트 곱셈이 넘쳐서 std와 다르게 나온다
+	bool strict;
+};
+
+// 커널마다 std와 출력 버퍼 전체(줄 끝 여백과 버퍼 뒤 가드 포함)를 바이트 단위로 비교하고, 같이 구하는 AlphaCoverage와
+// 알파 평면이 한 값인지 확인한 결과, 평면을 블록 단위로 비교한 결과, 출력을 다시 YUV420으로 되돌린 평면도 비교한다.
+// 무작위 평면, 줄 간격, 해상도(홀수와 32 미만 포함), 알파 유무, YCbCrType 조합과 replay_file의 프레임을 쓰고,
+// 커널마다 첫 번째로 다른 픽셀을 표에 남긴다. 모두 같으면 true
+bool RunKernelVerify(const KernelVerifyOptions &options, BenchTable &table);
+std::vector<std::string> GetKernelVerifyColumns();
@@ -0,0 +1,505 @@
+#include "PipelineBench.h"
+#include "CorpusGenerator.h"
+#include "KernelBench.h"
+#include "../WebmDecoder.h"
+
+#include <vp8dx.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+// 60Hz 화면 갱신 간격
+#define VSYNC_INTERVAL_NS 16666667ull
+// 디코더가 END를 내지 않을 때 벤치마크가 멈추지 않도록 한다
+#define MAX_PLAYBACK_STEPS 100000
+#define SWITCH_ROUNDS 5
+
+static const float PLAYBACK_RATES[] = { 1.0f, 2.0f, 4.0f, 8.0f };
+
+static uint64_t elapsed_ns(const std::chrono::steady_clock::time_point &begin)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static uint64_t percentile(std::vector<uint64_t> values, double p)
+{
+	if (values.empty())
+		return 0;
+
+	std::sort(values.begin(), values.end());
+	const size_t index = std::min(static_cast<size_t>(p * values.size()), values.size() - 1);
+	return values[index];
+}
+
+// min_time_ms와 min_runs를 모두 채울 때까지 run을 반복하고 중앙값을 돌려준다. run이 실패하면 0
+static uint64_t measure(const PipelineBenchOptions &options, const std::function<bool(uint64_t&)> &run, uint32_t &runs)
+{
+	std::vector<uint64_t> samples;
+	double total_ms = 0.0;
+	while (samples.size() < options.max_runs && (samples.size() < options.min_runs || total_ms < options.min_time_ms))
+	{
+		uint64_t ns = 0;
+		if (!run(ns))
+			return 0;
+
+		samples.push_back(ns);
+		total_ms += ns / 1000000.0;
+	}
+
+	runs = static_cast<uint32_t>(samples.size());
+	return percentile(samples, 0.5);
+}
+
+bool DecodeClip(const std::string &fileName, uint32_t fourcc, uint64_t &frames, const DecodeClipCallback_t &onFrame)
+{
+	mkvparser::MkvReader reader;
+	if (reader.Open(fileName.c_str()))
+		return false;
+
+	mkvparser::EBMLHeader ebmlHeader;
+	long long pos = 0;
+	mkvparser::Segment *segment = nullptr;
+	if (ebmlHeader.Parse(&reader, pos) < 0 || mkvparser::Segment::CreateInstance(&reader, pos, segment) || !segment)
+		return false;
+	std::unique_ptr<mkvparser::Segment> segmentHolder(segment);
+	if (segment->Load() < 0)
+		return false;
+
+	long long videoTrack = -1;
+	const mkvparser::Tracks *tracks = segment->GetTracks();
+	for (unsigned long i = 0; tracks && i < tracks->GetTracksCount(); ++i)
+	{
+		const mkvparser::Track *track = tracks->GetTrackByIndex(i);
+		if (track && track->GetType() == mkvparser::Track::kVideo)
+		{
+			videoTrack = track->GetNumber();
+			break;
+		}
+	}
+	if (videoTrack < 0)
+		return false;
+
+	vpx_codec_iface_t *iface = (fourcc == VP9_FOURCC) ? vpx_codec_vp9_dx() : vpx_codec_vp8_dx();
+	vpx_codec_ctx_t decoder;
+	vpx_codec_ctx_t decoderAlpha;
+	if (vpx_codec_dec_init(&decoder, iface, nullptr, 0))
+		return false;
+	if (vpx_codec_dec_init(&decoderAlpha, iface, nullptr, 0))
+	{
+		vpx_codec_destroy(&decoder);
+		return false;
+	}
+
+	std::vector<uint8_t> buffer(1024 * 256);
+	std::vector<uint8_t> bufferAlpha(1024 * 256);
+	bool ok = true;
+	frames = 0;
+	for (const mkvparser::Cluster *cluster = segment->GetFirst(); ok && cluster && !cluster->EOS(); cluster = segment->GetNext(cluster))
+	{
+		const mkvparser::BlockEntry *entry = nullptr;
+		ok = cluster->GetFirst(entry) == 0;
+		while (ok && entry && !entry->EOS())
+		{
+			const mkvparser::Block *block = entry->GetBlock();
+			for (int i = 0; ok && block->GetTrackNumber() == videoTrack && i < block->GetFrameCount(); ++i)
+			{
+				const mkvparser::Block::Frame &frame = block->GetFrame(i);
+				if (frame.len > static_cast<long>(buffer.size()))
+					buffer.resize(frame.len * 2);
+				ok = frame.Read(&reader, &buffer[0]) == 0 &&
+					vpx_codec_decode(&decoder, &buffer[0], frame.len, nullptr, 0) == VPX_CODEC_OK;
+
+				vpx_codec_iter_t iter = nullptr;
+				const vpx_image_t *img = (ok) ? vpx_codec_get_frame(&decoder, &iter) : nullptr;
+				const vpx_image_t *imgAlpha = nullptr;
+				if (ok && block->GetFrameAdditionCount() > 0)
+				{
+					const mkvparser::Block::Frame &frameAddition = block->GetFrameAddition(0);
+					if (frameAddition.len > static_cast<long>(bufferAlpha.size()))
+						bufferAlpha.resize(frameAddition.len * 2);
+					ok = frameAddition.Read(&reader, &bufferAlpha[0]) == 0 &&
+						vpx_codec_decode(&decoderAlpha, &bufferAlpha[0], frameAddition.len, nullptr, 0) == VPX_CODEC_OK;
+
+					vpx_codec_iter_t iterAlpha = nullptr;
+					imgAlpha = (ok) ? vpx_codec_get_frame(&decoderAlpha, &iterAlpha) : nullptr;
+				}
+
+				if (img)
+				{
+					frames++;
+					if (onFrame)
+						onFrame(img, imgAlpha);
+				}
+			}
+			if (ok)
+				ok = cluster->GetNext(entry, entry) == 0;
+		}
+	}
+
+	vpx_codec_destroy(&decoder);
+	vpx_codec_destroy(&decoderAlpha);
+	return ok && frames > 0;
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dstStride, const uint8_t *src, int srcStride, uint32_t width, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(dst + y * dstStride, src + y * srcStride, width);
+}
+
+static const Kernel &get_fastest_kernel()
+{
+	// GetKernels는 느린 커널부터 나열한다
+	const std::vector<Kernel> &kernels = GetKernels();
+	for (auto it = kernels.rbegin(); it != kernels.rend(); ++it)
+	{
+		if (it->is_supported())
+			return *it;
+	}
+	return kernels.front();
+}
+
+struct playback_result
+{
+	uint64_t ns;
+	uint64_t frames;	// 새로 화면에 나간 프레임 수
+	uint64_t dropped_frames;
+};
+
+// 시계를 멈춰두고 DecodeFrame만 부르면 모든 프레임을 디코딩하고 변환한다.
+// paced면 Update마다 시계를 한 화면 갱신만큼 움직여서 배속 재생의 건너뛰기까지 포함한다
+static bool run_playback(const std::string &fileName, float rate, bool paced, playback_result &result)
+{
+	ManualClock clock;
+	WebmDecoder decoder;
+	decoder.SetClock(&clock);
+	if (!decoder.Load(fileName, false, rate))
+		return false;
+
+	int64_t lastFrameIndex = -1;
+	WebmDecoder::WEBM_STATE state = WebmDecoder::WEBM_STATE::PLAYING;
+	result.frames = 0;
+	const auto begin = std::chrono::steady_clock::now();
+	for (int step = 0; state == WebmDecoder::WEBM_STATE::PLAYING && step < MAX_PLAYBACK_STEPS; ++step)
+	{
+		if (paced)
+		{
+			clock.Advance(VSYNC_INTERVAL_NS);
+			state = decoder.Update();
+		}
+		else
+		{
+			state = decoder.DecodeFrame();
+		}
+
+		const int64_t frameIndex = decoder.GetFrameDesc().frame_index;
+		if (frameIndex != lastFrameIndex)
+		{
+			result.frames++;
+			lastFrameIndex = frameIndex;
+		}
+	}
+	result.ns = elapsed_ns(begin);
+	result.dropped_frames = decoder.GetPlaybackStats().dropped_frames;
+	return state == WebmDecoder::WEBM_STATE::END;
+}
+
+// 해상도가 바뀌는 클립을 libvpx만으로 디코딩하면서 WebmDecoder를 한 프레임씩 같이 재생한다.
+// 프레임마다 크기, geometry_version이 크기가 바뀔 때만 바뀌는지, RGBA가 libvpx 이미지를 표준 커널로 변환한 결과와 바이트 단위로 같은지 본다.
+// sse/avx 커널은 verify에서 std와 같은 결과를 내는지 확인하므로 디코더는 원래 고르는 커널을 그대로 쓴다
+static bool verify_resize(const std::string &fileName, const CorpusClip &clip, uint64_t &frames)
+{
+	ManualClock clock;
+	WebmDecoder decoder;
+	decoder.SetClock(&clock);
+	if (!decoder.Load(fileName, false, 1.0f))
+		return false;
+
+	uint32_t lastWidth = 0;
+	uint32_t lastHeight = 0;
+	uint32_t lastGeometryVersion = 0;
+	uint32_t resizes = 0;
+	int64_t frameIndex = 0;
+	int step = 0;
+	bool ok = true;
+	std::vector<uint8_t> expected;
+	WebmDecoder::WEBM_STATE state = WebmDecoder::WEBM_STATE::PLAYING;
+	const bool decoded = DecodeClip(fileName, clip.fourcc, frames, [&](const vpx_image_t *img, const vpx_image_t *imgAlpha) {
+		const int64_t index = frameIndex++;
+		if (!ok)
+			return;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		GetCorpusFrameSize(clip, static_cast<uint32_t>(index), width, height);
+		if (img->d_w != width || img->d_h != height)
+		{
+			std::cout << "frame " << index << " of " << fileName << " was not encoded at " << width << "x" << height << std::endl;
+			ok = false;
+			return;
+		}
+
+		// 시계를 멈춰두면 DecodeFrame마다 다음 프레임이 나온다
+		while (decoder.GetFrameDesc().frame_index < index && state == WebmDecoder::WEBM_STATE::PLAYING && step++ < MAX_PLAYBACK_STEPS)
+			state = decoder.DecodeFrame();
+
+		const WebmDecoder::FrameDesc desc = decoder.GetFrameDesc();
+		if (desc.frame_index != index)
+		{
+			std::cout << fileName << " played frame " << desc.frame_index << " instead of " << index << std::endl;
+			ok = false;
+			return;
+		}
+		if (desc.width != width || desc.height != height || desc.stride < width * 4 || !desc.pixels)
+		{
+			std::cout << "frame " << index << " of " << fileName << " is " << desc.width << "x" << desc.height
+				<< ", expected " << width << "x" << height << std::endl;
+			ok = false;
+			return;
+		}
+
+		const bool resized = width != lastWidth || height != lastHeight;
+		if (resized != (desc.geometry_version != lastGeometryVersion))
+		{
+			std::cout << "frame " << index << " of " << fileName << " has geometry_version " << desc.geometry_version
+				<< " after " << lastGeometryVersion << std::endl;
+			ok = false;
+			return;
+		}
+		if (resized && lastWidth)
+			resizes++;
+		lastWidth = width;
+		lastHeight = height;
+		lastGeometryVersion = desc.geometry_version;
+
+		// 디코더처럼 알파가 전부 255면 알파 없이, 전부 0이면 0으로 채운다
+		const uint8_t *alpha = (imgAlpha) ? imgAlpha->planes[VPX_PLANE_Y] : nullptr;
+		const int constantAlpha = (alpha) ? alpha_plane_constant_std(width, height, alpha, imgAlpha->stride[VPX_PLANE_Y]) : 255;
+		expected.assign(static_cast<size_t>(width) * height * 4, 0);
+		if (constantAlpha != 0)
+		{
+			yuv420_rgb24_std(width, height, img->planes[VPX_PLANE_Y], img->planes[VPX_PLANE_U], img->planes[VPX_PLANE_V],
+				(constantAlpha == 255) ? nullptr : alpha, img->stride[VPX_PLANE_Y], img->stride[VPX_PLANE_U], img->stride[VPX_PLANE_V],
+				(alpha) ? imgAlpha->stride[VPX_PLANE_Y] : 0, &expected[0], width * 4, YCBCR_JPEG, nullptr);
+		}
+
+		for (uint32_t y = 0; y < height && ok; ++y)
+		{
+			const uint8_t *row = desc.pixels + static_cast<size_t>(y) * desc.stride;
+			const uint8_t *rowExpected = &expected[static_cast<size_t>(y) * width * 4];
+			if (memcmp(row, rowExpected, width * 4) == 0)
+				continue;
+
+			uint32_t x = 0;
+			while (row[x] == rowExpected[x])
+				x++;
+			std::cout << "frame " << index << " of " << fileName << " differs at (" << x / 4 << ", " << y << ")" << std::endl;
+			ok = false;
+		}
+	});
+	if (!decoded || !ok)
+		return false;
+
+	// 디코더도 같은 프레임에서 끝나야 한다
+	while (state == WebmDecoder::WEBM_STATE::PLAYING && step++ < MAX_PLAYBACK_STEPS)
+		state = decoder.DecodeFrame();
+
+	// 큰 크기 -> 작은 크기 -> 큰 크기를 모두 거쳐야 버퍼를 줄이고 다시 늘리는 경우를 다 본 것이다
+	const int64_t lastFrameIndex = decoder.GetFrameDesc().frame_index;
+	if (state != WebmDecoder::WEBM_STATE::END || lastFrameIndex + 1 != frameIndex || resizes < 2)
+	{
+		std::cout << fileName << " played " << lastFrameIndex + 1 << " of " << frameIndex << " frames with " << resizes << " resizes" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::vector<std::string> GetPipelineBenchColumns()
+{
+	return { "clip", "codec", "resolution", "alpha", "kbps", "stage", "rate", "runs",
+		"frames", "median_ms", "fps", "dropped" };
+}
+
+static void add_pipeline_row(BenchTable &table, const CorpusClip &clip, const std::string &stage, float rate,
+	uint32_t runs, uint64_t frames, uint64_t ns, uint64_t dropped)
+{
+	table.AddRow();
+	table.Add(clip.name);
+	table.Add((clip.fourcc == VP9_FOURCC) ? "vp9" : "vp8");
+	table.Add(clip.resolution);
+	table.Add(static_cast<uint64_t>(clip.has_alpha));
+	table.Add(static_cast<uint64_t>(clip.bitrate_kbps));
+	table.Add(stage);
+	table.Add(rate, 1);
+	table.Add(static_cast<uint64_t>(runs));
+	table.Add(frames);
+	table.Add(ns / 1000000.0);
+	table.Add(frames / std::max(ns / 1000000000.0, 1e-9), 1);
+	table.Add(dropped);
+}
+
+bool RunPipelineBench(const PipelineBenchOptions &options, BenchTable &table)
+{
+	const std::vector<CorpusClip> clips = GetCorpusClips(options.clip_filter);
+	if (clips.empty() || !GenerateCorpus(options.corpus_dir, clips, false))
+		return false;
+
+	const Kernel &kernel = get_fastest_kernel();
+	for (const CorpusClip &clip : clips)
+	{
+		const std::string fileName = GetCorpusPath(options.corpus_dir, clip);
+
+		uint32_t runs = 0;
+		uint64_t frames = 0;
+		uint64_t ns = measure(options, [&](uint64_t &sample) {
+			const auto begin = std::chrono::steady_clock::now();
+			const bool ok = DecodeClip(fileName, clip.fourcc, frames, nullptr);
+			sample = elapsed_ns(begin);
+			return ok;
+		}, runs);
+		if (!ns)
+		{
+			std::cout << "failed to decode " << fileName << std::endl;
+			return false;
+		}
+		add_pipeline_row(table, clip, "decode", 1.0f, runs, frames, ns, 0);
+
+		// 실제 디코딩된 첫 프레임을 커널 입력으로 옮겨서 클립의 프레임 수만큼 변환한다
+		KernelImage image(clip.width, clip.height, clip.has_alpha, 1);
+		bool captured = false;
+		DecodeClip(fileName, clip.fourcc, frames, [&](const vpx_image_t *img, const vpx_image_t *imgAlpha) {
+			if (captured || img->d_w != clip.width || img->d_h != clip.height)
+				return;
+			copy_plane(image.y, image.y_stride, img->planes[VPX_PLANE_Y], img->stride[VPX_PLANE_Y], img->d_w, img->d_h);
+			copy_plane(image.u, image.uv_stride, img->planes[VPX_PLANE_U], img->stride[VPX_PLANE_U], (img->d_w + 1) / 2, (img->d_h + 1) / 2);
+			copy_plane(image.v, image.uv_stride, img->planes[VPX_PLANE_V], img->stride[VPX_PLANE_V], (img->d_w + 1) / 2, (img->d_h + 1) / 2);
+			if (image.a && imgAlpha)
+				copy_plane(image.a, image.y_stride, imgAlpha->planes[VPX_PLANE_Y], imgAlpha->stride[VPX_PLANE_Y], img->d_w, img->d_h);
+			captured = true;
+		});
+
+		ns = measure(options, [&](uint64_t &sample) {
+			const auto begin = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < clip.frame_count; ++i)
+				image.Run(kernel, YCBCR_JPEG);
+			sample = elapsed_ns(begin);
+			return true;
+		}, runs);
+		add_pipeline_row(table, clip, std::string("convert_") + kernel.name, 1.0f, runs, clip.frame_count, ns, 0);
+
+		playback_result result;
+		ns = measure(options, [&](uint64_t &sample) {
+			const bool ok = run_playback(fileName, 1.0f, false, result);
+			sample = result.ns;
+			return ok;
+		}, runs);
+		if (!ns)
+		{
+			std::cout << "failed to play " << fileName << std::endl;
+			return false;
+		}
+		add_pipeline_row(table, clip, "pipeline", 1.0f, runs, result.frames, ns, result.dropped_frames);
+
+		for (float rate : PLAYBACK_RATES)
+		{
+			ns = measure(options, [&](uint64_t &sample) {
+				const bool ok = run_playback(fileName, rate, true, result);
+				sample = result.ns;
+				return ok;
+			}, runs);
+			if (!ns)
+			{
+				std::cout << "failed to play " << fileName << " at " << rate << "x" << std::endl;
+				return false;
+			}
+			add_pipeline_row(table, clip, "playback", rate, runs, result.frames, ns, result.dropped_frames);
+		}
+
+		if (clip.resize_width)
+		{
+			const auto begin = std::chrono::steady_clock::now();
+			if (!verify_resize(fileName, clip, frames))
+			{
+				std::cout << "resize check failed for " << fileName << std::endl;
+				return false;
+			}
+			add_pipeline_row(table, clip, "resize_verify", 1.0f, 1, frames, elapsed_ns(begin), 0);
+		}
+	}
+	return true;
+}
+
+std::vector<std::string> GetSwitchBenchColumns()
+{
+	return { "clip", "resolution", "loads", "cold_load_us", "warm_load_p50_us", "warm_load_max_us",
+		"warm_first_frame_p50_us", "decoder_reuse", "buffer_allocs" };
+}
+
+bool RunSwitchBench(const PipelineBenchOptions &options, BenchTable &table)
+{
+	const std::vector<CorpusClip> clips = GetCorpusClips(options.clip_filter);
+	if (clips.empty() || !GenerateCorpus(options.corpus_dir, clips, false))
+		return false;
+
+	struct switch_samples
+	{
+		std::vector<uint64_t> load_ns;
+		std::vector<uint64_t> first_frame_ns;
+		uint64_t decoder_hits;
+		uint64_t buffer_misses;
+	};
+	std::vector<switch_samples> samples(clips.size(), { {}, {}, 0, 0 });
+
+	// 모든 클립의 디코더가 풀에 남도록 해서 두 번째 바퀴부터는 초기화 없이 다시 쓰는지 본다
+	DecoderPool decoderPool(static_cast<uint32_t>(clips.size()));
+	BufferPool bufferPool;
+	WebmDecoder decoder;
+	decoder.SetDecoderPool(&decoderPool);
+	decoder.SetBufferPool(&bufferPool);
+
+	for (uint32_t round = 0; round < SWITCH_ROUNDS; ++round)
+	{
+		for (size_t i = 0; i < clips.size(); ++i)
+		{
+			const std::string fileName = GetCorpusPath(options.corpus_dir, clips[i]);
+			const DecoderPool::Stats decoderStats = decoderPool.GetStats();
+			const BufferPool::Stats bufferStats = bufferPool.GetStats();
+
+			const auto begin = std::chrono::steady_clock::now();
+			if (!decoder.Load(fileName, false) || decoder.DecodeFrame() != WebmDecoder::WEBM_STATE::PLAYING)
+			{
+				std::cout << "failed to play " << fileName << std::endl;
+				return false;
+			}
+
+			switch_samples &sample = samples[i];
+			sample.first_frame_ns.push_back(elapsed_ns(begin));
+			sample.load_ns.push_back(decoder.GetPlaybackStats().load_ns);
+			sample.decoder_hits += decoderPool.GetStats().hits - decoderStats.hits;
+			sample.buffer_misses += bufferPool.GetStats().misses - bufferStats.misses;
+		}
+	}
+
+	for (size_t i = 0; i < clips.size(); ++i)
+	{
+		// 첫 바퀴는 디코더와 버퍼를 새로 만드는 비용이라 따로 보여준다
+		const switch_samples &sample = samples[i];
+		const std::vector<uint64_t> warmLoad(sample.load_ns.begin() + 1, sample.load_ns.end());
+		const std::vector<uint64_t> warmFirstFrame(sample.first_frame_ns.begin() + 1, sample.first_frame_ns.end());
+
+		table.AddRow();
+		table.Add(clips[i].name);
+		table.Add(clips[i].resolution);
+		table.Add(static_cast<uint64_t>(sample.load_ns.size()));
+		table.Add(sample.load_ns[0] / 1000.0, 1);
+		table.Add(percentile(warmLoad, 0.5) / 1000.0, 1);
+		table.Add(percentile(warmLoad, 1.0) / 1000.0, 1);
+		table.Add(percentile(warmFirstFrame, 0.5) / 1000.0, 1);
+		table.Add(static_cast<double>(sample.decoder_hits) / sample.load_ns.size(), 2);
+		table.Add(sample.buffer_misses);
+	}
+	return true;
+}
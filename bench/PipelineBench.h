@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vpx_image.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "BenchTable.h"
+
+struct PipelineBenchOptions
+{
+	std::string corpus_dir;
+	std::string clip_filter;	// 비어 있으면 모든 클립. 예: "vp9_1080p"
+	double min_time_ms;
+	uint32_t min_runs;
+	uint32_t max_runs;
+};
+
+// 코퍼스 클립마다 단계별 초당 프레임 수를 잰다.
+// decode: 파서와 libvpx만, convert: 가장 빠른 커널로 RGBA 변환만, pipeline: WebmDecoder::DecodeFrame 전체,
+// playback: 60Hz로 Update를 부르는 재생(배속 1, 2, 4, 8).
+// 해상도가 바뀌는 클립은 resize_verify에서 프레임 크기, geometry_version과 표준 커널로 변환한 RGBA를 비교하고, 틀리면 실패한다. 없는 클립은 먼저 만든다
+bool RunPipelineBench(const PipelineBenchOptions &options, BenchTable &table);
+std::vector<std::string> GetPipelineBenchColumns();
+
+using DecodeClipCallback_t = std::function<void(const vpx_image_t*, const vpx_image_t*)>;
+
+// WebmDecoder를 거치지 않고 파서와 libvpx만으로 클립 전체를 디코딩한다.
+// onFrame이 있으면 디코딩한 프레임마다 색상과 알파(없으면 nullptr) 이미지를 넘긴다
+bool DecodeClip(const std::string &fileName, uint32_t fourcc, uint64_t &frames, const DecodeClipCallback_t &onFrame);
+
+// 디코더 하나로 해상도와 코덱이 다른 클립을 번갈아 열면서 Load와 첫 프레임까지의 지연, DecoderPool과 BufferPool 재사용을 잰다
+bool RunSwitchBench(const PipelineBenchOptions &options, BenchTable &table);
+std::vector<std::string> GetSwitchBenchColumns();
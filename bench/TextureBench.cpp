@@ -0,0 +1,113 @@
+#include "TextureBench.h"
+#include "../TextureCompress.h"
+#include "../ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+struct texture_resolution
+{
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+};
+
+static const texture_resolution RESOLUTIONS[] = {
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "1440p", 2560, 1440 },
+	{ "4K", 3840, 2160 },
+};
+
+struct texture_format
+{
+	const char *name;
+	TextureFormat format;
+};
+
+static const texture_format FORMATS[] = {
+	{ "bc3", TEXTURE_BC3 },
+	{ "bc7", TEXTURE_BC7 },
+};
+
+static uint64_t measure(ThreadPool *pool, TextureFormat format, const KernelImage &image, std::vector<uint8_t> &blocks,
+	const KernelBenchOptions &options, uint32_t &runs)
+{
+	compress_texture(pool, format, image.width, image.height, image.rgba, image.rgba_stride, &blocks[0]);
+
+	std::vector<uint64_t> samples;
+	double total_ms = 0.0;
+	while (samples.size() < options.max_runs && (samples.size() < options.min_runs || total_ms < options.min_time_ms))
+	{
+		const auto begin = std::chrono::steady_clock::now();
+		compress_texture(pool, format, image.width, image.height, image.rgba, image.rgba_stride, &blocks[0]);
+		const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+		samples.push_back(ns);
+		total_ms += ns / 1000000.0;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	runs = static_cast<uint32_t>(samples.size());
+	return samples[samples.size() / 2];
+}
+
+std::vector<std::string> GetTextureBenchColumns()
+{
+	return { "format", "resolution", "width", "height", "alpha", "threads", "runs",
+		"median_ms", "fps", "mpixels_per_s", "upload_bytes", "upload_ratio" };
+}
+
+bool RunTextureBench(const KernelBenchOptions &options, BenchTable &table)
+{
+	// 압축기는 데이터에 따라 끝점 방향만 바뀌므로 실제 변환 결과를 입력으로 쓴다
+	const Kernel &kernel = GetKernels().front();
+	ThreadPool pool;
+	bool ran = false;
+
+	for (const texture_resolution &resolution : RESOLUTIONS)
+	{
+		if (!options.resolution_filter.empty() && options.resolution_filter != resolution.name)
+			continue;
+
+		for (int alpha = 0; alpha < 2; ++alpha)
+		{
+			KernelImage image(resolution.width, resolution.height, alpha != 0, resolution.width * 31 + resolution.height);
+			image.Run(kernel, YCBCR_JPEG);
+			const uint64_t pixels = static_cast<uint64_t>(resolution.width) * resolution.height;
+			const uint64_t rgbaBytes = texture_compressed_size(TEXTURE_RGBA, resolution.width, resolution.height);
+
+			for (const texture_format &format : FORMATS)
+			{
+				if (!options.kernel_filter.empty() && options.kernel_filter != format.name)
+					continue;
+
+				const uint64_t blockBytes = texture_compressed_size(format.format, resolution.width, resolution.height);
+				std::vector<uint8_t> blocks(blockBytes);
+				for (int threaded = 0; threaded < 2; ++threaded)
+				{
+					ThreadPool *runPool = (threaded) ? &pool : nullptr;
+					uint32_t runs = 0;
+					const uint64_t ns = measure(runPool, format.format, image, blocks, options, runs);
+					const double seconds = std::max<uint64_t>(ns, 1) / 1000000000.0;
+
+					table.AddRow();
+					table.Add(format.name);
+					table.Add(resolution.name);
+					table.Add(static_cast<uint64_t>(resolution.width));
+					table.Add(static_cast<uint64_t>(resolution.height));
+					table.Add(static_cast<uint64_t>(alpha));
+					// Wait()를 부른 스레드도 타일을 처리한다
+					table.Add(static_cast<uint64_t>((threaded) ? pool.GetThreadCount() + 1 : 1));
+					table.Add(static_cast<uint64_t>(runs));
+					table.Add(ns / 1000000.0);
+					table.Add(1.0 / seconds, 1);
+					table.Add(pixels / seconds / 1000000.0, 1);
+					table.Add(blockBytes);
+					table.Add(static_cast<double>(rgbaBytes) / blockBytes, 2);
+					ran = true;
+				}
+			}
+		}
+	}
+	return ran;
+}
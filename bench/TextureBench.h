@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchTable.h"
+#include "KernelBench.h"
+
+// 변환한 RGBA 프레임을 BC3/BC7 블록으로 압축하는 속도를 해상도 x 알파 유무 x 스레드(1개, 풀)마다 잰다.
+// fps가 60을 넘으면 그 해상도는 재생 중에 매 프레임 압축해서 올릴 수 있다. options의 kernel_filter는 bc3/bc7로 쓴다
+bool RunTextureBench(const KernelBenchOptions &options, BenchTable &table);
+std::vector<std::string> GetTextureBenchColumns();
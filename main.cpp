@@ -1,4 +1,7 @@
 #include "WebmDecoder.h"
+#include "TextureCompress.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
 #include <glew/glew.h>
 #include <glfw/glfw3.h>
@@ -12,9 +15,11 @@
 #include <cmath>
 #include <memory>
 #include <tchar.h>
+#include <vector>
 
 #define ScreenWidth 800
 #define ScreenHeight 600
+#define MAX_PATH_LENGTH 260
 
 void OnError(int errorCode, const char* msg) {
 	throw std::runtime_error(msg);
@@ -29,6 +34,18 @@ public:
 	}
 
 public:
+	// InitApp 전에 호출한다. 드라이버가 포맷을 지원하지 않으면 RGBA로 올린다
+	void SetTextureFormat(TextureFormat format)
+	{
+		mTextureFormat = format;
+	}
+
+	// LoadWebm 전에 호출한다. RGBA 텍스처면 디코더가 찾은 바뀐 영역만 glTexSubImage2D로 올린다
+	void SetDirtyUpload(bool enable)
+	{
+		mDirtyUpload = enable;
+	}
+
 	bool InitApp(const std::string &vertex, const std::string &fragment)
 	{
 		if (!_CreateWindow())
@@ -72,6 +89,18 @@ public:
 
 		glBindVertexArray(0);
 
+		if (mTextureFormat != TEXTURE_RGBA)
+		{
+			const bool supported = (mTextureFormat == TEXTURE_BC3) ? GLEW_EXT_texture_compression_s3tc : GLEW_ARB_texture_compression_bptc;
+			if (supported)
+				mCompressPool = std::make_unique<ThreadPool>();
+			else
+			{
+				std::cout << "Texture compression is not supported, falling back to RGBA" << std::endl;
+				mTextureFormat = TEXTURE_RGBA;
+			}
+		}
+
 		glGenTextures(1, &textureID);
 		rgba = new unsigned char[ScreenWidth * ScreenHeight * 4];
 		for (int i = 0; i < 800 * 600 * 4; i += 4)
@@ -87,6 +116,7 @@ public:
 	bool LoadWebm(const std::string &webmPath, bool loop)
 	{
 		mWebmDecoder = std::make_unique<WebmDecoder>();
+		mWebmDecoder->SetDirtyTracking(mDirtyUpload && mTextureFormat == TEXTURE_RGBA);
 		return mWebmDecoder->Load(webmPath, loop);
 	}
 
@@ -103,6 +133,7 @@ public:
 		}
 
 		glfwTerminate();
+		mCompressPool = nullptr;
 		delete[] rgba;
 		rgba = nullptr;
 		mWebmDecoder = nullptr;
@@ -148,6 +179,7 @@ private:
 		uint8_t *pixels = nullptr;
 
 		std::tie(width, height, pixels) = mWebmDecoder->GetRGBA();
+		const int64_t frameIndex = mWebmDecoder->GetFrameDesc().frame_index;
 
 		glClearColor(0, 0, 1, 1);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -161,7 +193,10 @@ private:
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		if (mTextureFormat == TEXTURE_RGBA)
+			_UploadRGBA(width, height, pixels, frameIndex);
+		else
+			_UploadCompressed(width, height, pixels, frameIndex);
 
 		mProgram->setUniform("tex", 0);
 		glBindVertexArray(mVAO);
@@ -173,6 +208,58 @@ private:
 		glfwSwapBuffers(mWindow);
 	}
 
+	// 바뀐 영역을 쓰면 새 프레임일 때만 올리고, 텍스처에 바뀐 영역의 기준 프레임이 들어 있으면 바뀐 사각형만 올린다
+	void _UploadRGBA(int width, int height, const uint8_t *pixels, int64_t frameIndex)
+	{
+		WEBM_TRACE_SCOPE("upload", 0, frameIndex);
+		if (!mDirtyUpload || !pixels)
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			return;
+		}
+		if (frameIndex == mUploadedFrame)
+			return;
+
+		const WebmDecoder::DirtyRegion &region = mWebmDecoder->GetDirtyRegion();
+		const uint32_t geometryVersion = mWebmDecoder->GetFrameDesc().geometry_version;
+		if (region.base_frame_index < 0 || region.base_frame_index != mUploadedFrame || geometryVersion != mUploadedGeometry)
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+		else
+		{
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+			for (const DirtyTracker::Rect &rect : region.rects)
+			{
+				glTexSubImage2D(GL_TEXTURE_2D, 0, rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top,
+					GL_RGBA, GL_UNSIGNED_BYTE, pixels + (static_cast<size_t>(rect.top) * width + rect.left) * 4);
+			}
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+		mUploadedFrame = frameIndex;
+		mUploadedGeometry = geometryVersion;
+	}
+
+	// 새 프레임일 때만 블록으로 압축해서 올린다. 같은 프레임이면 텍스처에 이미 들어 있다
+	void _UploadCompressed(int width, int height, const uint8_t *pixels, int64_t frameIndex)
+	{
+		if (!pixels || frameIndex == mUploadedFrame)
+			return;
+
+		const uint32_t stride = mWebmDecoder->GetFrameDesc().stride;
+		mBlocks.resize(texture_compressed_size(mTextureFormat, width, height));
+		{
+			WEBM_TRACE_SCOPE("compress", 0, frameIndex);
+			compress_texture(mCompressPool.get(), mTextureFormat, width, height, pixels, stride, mBlocks.data());
+		}
+		{
+			WEBM_TRACE_SCOPE("upload", 0, frameIndex);
+			const GLenum internalFormat = (mTextureFormat == TEXTURE_BC3) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+			glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, static_cast<GLsizei>(mBlocks.size()), mBlocks.data());
+		}
+		mUploadedFrame = frameIndex;
+	}
+
 private:
 	const glm::vec2 SCREEN_SIZE;
 	GLFWwindow* mWindow = nullptr;
@@ -182,12 +269,51 @@ private:
 	GLuint mVBO = 0;
 	GLuint textureID = 0;
 	unsigned char *rgba = nullptr;
+	TextureFormat mTextureFormat = TEXTURE_RGBA;
+	std::unique_ptr<ThreadPool> mCompressPool;
+	std::vector<uint8_t> mBlocks;
+	int64_t mUploadedFrame = -1;
+	uint32_t mUploadedGeometry = 0;
+	bool mDirtyUpload = false;
 };
 
 
 int _tmain(int argc, _TCHAR* argv[])
 {
+	// --trace <file>: 디코딩 단계와 업로드를 Chrome trace JSON으로 남긴다
+	// --texture <bc3|bc7>: 프레임을 CPU에서 블록 압축해서 압축 텍스처로 올린다. 업로드 크기가 1/4이 된다
+	// --dirty: 이전 프레임에서 바뀐 영역만 변환해서 올린다
+	std::string tracePath;
+	TextureFormat textureFormat = TEXTURE_RGBA;
+	bool dirtyUpload = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (_tcscmp(argv[i], _T("--dirty")) == 0)
+			dirtyUpload = true;
+		if (i + 1 == argc)
+			break;
+
+		if (_tcscmp(argv[i], _T("--texture")) == 0)
+		{
+			if (_tcscmp(argv[i + 1], _T("bc3")) == 0)
+				textureFormat = TEXTURE_BC3;
+			else if (_tcscmp(argv[i + 1], _T("bc7")) == 0)
+				textureFormat = TEXTURE_BC7;
+		}
+
+		if (_tcscmp(argv[i], _T("--trace")) == 0)
+		{
+			char path[MAX_PATH_LENGTH];
+			size_t converted = 0;
+			wcstombs_s(&converted, path, sizeof(path), argv[i + 1], _TRUNCATE);
+			tracePath = path;
+			Trace::Enable(true);
+		}
+	}
+
 	OpenglApp app;
+	app.SetTextureFormat(textureFormat);
+	app.SetDirtyUpload(dirtyUpload);
 	if (!app.InitApp("shader-vertex.txt", "shader-fragment.txt"))
 		return 0;
 
@@ -195,6 +321,12 @@ int _tmain(int argc, _TCHAR* argv[])
 		return 0;
 
 	app.Run();
+	if (!tracePath.empty())
+	{
+		Trace::Enable(false);
+		if (Trace::Dump(tracePath))
+			std::cout << "Trace: " << tracePath << std::endl;
+	}
 	system("pause");
 	return 0;
 }
\ No newline at end of file